@@ -35,6 +35,8 @@
 typedef struct sdecomp_info_t_ sdecomp_info_t;
 // opaque struct storing pencil transpose plan
 typedef struct sdecomp_transpose_plan_t_ sdecomp_transpose_plan_t;
+// opaque struct storing on-going (non-blocking) pencil transpose
+typedef struct sdecomp_transpose_request_t_ sdecomp_transpose_request_t;
 
 // spatial directions
 typedef uint_fast8_t sdecomp_dir_t;
@@ -51,6 +53,59 @@ extern const sdecomp_pencil_t SDECOMP_X2PENCIL; // 3
 extern const sdecomp_pencil_t SDECOMP_Y2PENCIL; // 4
 extern const sdecomp_pencil_t SDECOMP_Z2PENCIL; // 5
 
+// engines to perform pencil rotations
+typedef uint_fast8_t sdecomp_transpose_engine_t;
+extern const sdecomp_transpose_engine_t SDECOMP_TRANSPOSE_ENGINE_ALLTOALLW;    // 0, derived data types
+extern const sdecomp_transpose_engine_t SDECOMP_TRANSPOSE_ENGINE_ALLTOALLV;    // 1, explicit pack / unpack
+extern const sdecomp_transpose_engine_t SDECOMP_TRANSPOSE_ENGINE_PAIRWISE;     // 2, pairwise exchange, large messages
+extern const sdecomp_transpose_engine_t SDECOMP_TRANSPOSE_ENGINE_BRUCK;        // 3, Bruck algorithm, small messages
+extern const sdecomp_transpose_engine_t SDECOMP_TRANSPOSE_ENGINE_SHM;          // 4, shared memory within nodes
+extern const sdecomp_transpose_engine_t SDECOMP_TRANSPOSE_ENGINE_HIERARCHICAL; // 5, aggregated by node leaders
+extern const sdecomp_transpose_engine_t SDECOMP_TRANSPOSE_ENGINE_RMA;          // 6, one-sided puts
+extern const sdecomp_transpose_engine_t SDECOMP_TRANSPOSE_ENGINE_NEIGHBOR;     // 7, neighbourhood collective
+
+// element types on the wire, to which the elements are narrowed when packed
+//   NOTE: the elements are considered as double (8 bytes) or double complex (16 bytes)
+typedef uint_fast8_t sdecomp_transpose_wire_t;
+extern const sdecomp_transpose_wire_t SDECOMP_TRANSPOSE_WIRE_NATIVE; // 0, as they are
+extern const sdecomp_transpose_wire_t SDECOMP_TRANSPOSE_WIRE_FP32;   // 1, single precision
+extern const sdecomp_transpose_wire_t SDECOMP_TRANSPOSE_WIRE_BF16;   // 2, bfloat16
+
+// options of transpose plans
+// NOTE: copy SDECOMP_TRANSPOSE_DEFAULT_OPTIONS and modify the members of interest
+typedef struct {
+  // how to perform the rotation
+  sdecomp_transpose_engine_t engine;
+  // create persistent collective
+  //   ALLTOALLW: bound to the following buffers,
+  //              which is used when a rotation is requested for the same pair
+  //   ALLTOALLV: bound to the internal buffers, the following are not used
+  //   RMA:       window over the receive buffer below
+  //   NOTE: rejected for the other engines
+  bool persistent;
+  const void * sendbuf;
+  void * recvbuf;
+  // pipelined rotation, number of slabs along the dimension unchanged by the rotation
+  //   1: not pipelined
+  //   NOTE: only sdecomp.transpose.execute of 3D plans is pipelined,
+  //         and it cannot be combined with the persistent collective
+  //   NOTE: only for ALLTOALLW and ALLTOALLV
+  size_t nslabs;
+  // measure candidates (engines with and without pipelining) on the spot
+  //   and adopt the fastest one, i.e. engine and nslabs above are overwritten
+  //   NOTE: the results are kept by sdecomp_info_t and re-used,
+  //         which can be exported to / imported from a file (wisdom)
+  bool autotune;
+  // reduced-precision elements on the wire
+  //   NOTE: only for the engines packing chunks explicitly
+  //         (ALLTOALLV, PAIRWISE, BRUCK, SHM and HIERARCHICAL)
+  sdecomp_transpose_wire_t wire;
+  // lossless compression of each chunk (byte shuffle and LZ77)
+  //   NOTE: only for ALLTOALLV, which cannot be persistent nor pipelined
+  bool compress;
+} sdecomp_transpose_options_t;
+extern const sdecomp_transpose_options_t SDECOMP_TRANSPOSE_DEFAULT_OPTIONS;
+
 /* APIs of sdecomp_transpose_t */
 // accessed by sdecomp.transpose.xxx
 typedef struct {
@@ -63,18 +118,104 @@ typedef struct {
       const size_t size_of_element,
       sdecomp_transpose_plan_t ** plan // out
   );
+  // constructor of sdecomp_transpose_plan_t with options
+  int (* const construct_with_options)(
+      const sdecomp_info_t * info,
+      const sdecomp_pencil_t pencil_bef,
+      const sdecomp_pencil_t pencil_aft,
+      const size_t * glsizes,
+      const size_t size_of_element,
+      const sdecomp_transpose_options_t * options,
+      sdecomp_transpose_plan_t ** plan // out
+  );
+  // constructor of resized sdecomp_transpose_plan_t, global and element sizes differ before and after rotated
+  int (* const construct_resized)(
+      const sdecomp_info_t * info,
+      const sdecomp_pencil_t pencil_bef,
+      const sdecomp_pencil_t pencil_aft,
+      const size_t * glsizes_bef,
+      const size_t * glsizes_aft,
+      const size_t size_of_element_bef,
+      const size_t size_of_element_aft,
+      const sdecomp_transpose_options_t * options,
+      sdecomp_transpose_plan_t ** plan // out
+  );
   // transpose runner
   int (* const execute)(
       sdecomp_transpose_plan_t * restrict plan,
       const void * restrict sendbuf,
       void * restrict recvbuf
   );
+  // in-place transpose runner, one buffer holding the pencils before and after
+  //   NOTE: the buffer should be large enough to store both pencils
+  int (* const execute_inplace)(
+      sdecomp_transpose_plan_t * plan,
+      void * buf
+  );
+  // transpose runner for several fields sharing a plan, in one collective
+  int (* const execute_batch)(
+      sdecomp_transpose_plan_t * restrict plan,
+      const size_t nfields,
+      const void * const * sendbufs,
+      void * const * recvbufs
+  );
+  // non-blocking transpose initiator
+  int (* const start)(
+      sdecomp_transpose_plan_t * restrict plan,
+      const void * restrict sendbuf,
+      void * restrict recvbuf,
+      sdecomp_transpose_request_t ** request // out
+  );
+  // non-blocking transpose checker
+  int (* const test)(
+      sdecomp_transpose_request_t * request,
+      bool * flag // out
+  );
+  // non-blocking transpose finaliser
+  int (* const wait)(
+      sdecomp_transpose_request_t * request
+  );
   // destructor of sdecomp_transpose_plan_t
   int (* const destruct)(
       sdecomp_transpose_plan_t * plan
   );
+  // save results of autotuning to a file
+  int (* const export_wisdom)(
+      const sdecomp_info_t * info,
+      const char filename[]
+  );
+  // load results of autotuning from a file
+  int (* const import_wisdom)(
+      const sdecomp_info_t * info,
+      const char filename[]
+  );
 } sdecomp_transpose_t;
 
+// options of sdecomp_info_t
+// NOTE: copy SDECOMP_DEFAULT_OPTIONS and modify the members of interest
+typedef struct {
+  // lay out the processes such that the ones aligned in y direction of x1 pencil
+  //   share a node, i.e. the rotations x1 <-> y1, z1 <-> x2 and y2 <-> z2 are within nodes
+  //   NOTE: only for three-dimensional domains,
+  //         ignored when the numbers of processes differ among nodes
+  //         or the given dims[1] does not divide them
+  bool node_aware;
+  // measure candidate process grids (dims[1] and dims[2]) on the spot
+  //   by rotating a domain of the following global sizes
+  //   (x1 -> y1 -> z1 -> y1 -> x1, double),
+  //   and adopt the fastest one
+  //   NOTE: only for three-dimensional domains whose dims are all zero
+  bool autotune;
+  const size_t * glsizes;
+  // non-uniform decomposition balancing the sums of weights instead of the numbers of grid points
+  //   weights[dir] (nweights[dir] positive values) are regarded as a piecewise-constant density
+  //   over the whole domain in the direction, so that any glsize can be decomposed
+  //   NOTE: NULL gives the uniform decomposition in the direction
+  const double * weights[3];
+  size_t nweights[3];
+} sdecomp_options_t;
+extern const sdecomp_options_t SDECOMP_DEFAULT_OPTIONS;
+
 /* APIs of sdecomp_t */
 // accessed by sdecomp.xxx
 typedef struct {
@@ -86,6 +227,15 @@ typedef struct {
       const bool * periods,
       sdecomp_info_t ** info // out
   );
+  // constructor of sdecomp_info_t with options
+  int (* const construct_with_options)(
+      const MPI_Comm comm_default,
+      const size_t ndims,
+      const size_t * dims,
+      const bool * periods,
+      const sdecomp_options_t * options,
+      sdecomp_info_t ** info // out
+  );
   // destructor of sdecomp_info_t
   int (* const destruct)(
       sdecomp_info_t * sdecomp
@@ -142,6 +292,14 @@ typedef struct {
       const size_t glsize,
       size_t * offset // out
   );
+  // getter, local sizes and offsets of my pencil in all directions
+  int (* const get_pencil_layout)(
+      const sdecomp_info_t * info,
+      const sdecomp_pencil_t pencil,
+      const size_t * glsizes,
+      size_t * mysizes, // out
+      size_t * offsets  // out
+  );
   // getter, default communicator
   int (* const get_comm_cart)(
       const sdecomp_info_t * info,
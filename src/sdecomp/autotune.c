@@ -0,0 +1,179 @@
+/*
+ * Copyright 2022 Naoki Hori
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// https://github.com/NaokiHori/SimpleDecomp
+
+// autotuning of the process grid, i.e. dims[1] and dims[2] of comm_cart
+//   for three-dimensional domains
+
+#include <stdbool.h>
+#include <mpi.h>
+#include "sdecomp.h"
+#define SDECOMP_INTERNAL
+#include "internal.h"
+
+// number of sequences of rotations to measure each candidate
+#define SDECOMP_INTERNAL_NITERS 4
+
+// number of rotations in a sequence
+#define SDECOMP_INTERNAL_NROTATIONS 4
+
+// a representative sequence of rotations, which is used by e.g. Poisson solvers
+//   x1 -> y1 -> z1 -> y1 -> x1
+static const sdecomp_pencil_t pencils[SDECOMP_INTERNAL_NROTATIONS + 1] = {0, 1, 2, 1, 0};
+
+// each direction should have no fewer grid points than processes for all pencils involved
+static bool is_feasible(
+    const size_t * glsizes,
+    const int nprocs_y,
+    const int nprocs_z
+){
+  // x1: y and z directions are decomposed by nprocs_y and nprocs_z
+  // y1: x and z directions are decomposed by nprocs_y and nprocs_z
+  // z1: x and y directions are decomposed by nprocs_y and nprocs_z
+  if(glsizes[0] < (size_t)nprocs_y) return false;
+  if(glsizes[1] < (size_t)nprocs_y) return false;
+  if(glsizes[1] < (size_t)nprocs_z) return false;
+  if(glsizes[2] < (size_t)nprocs_z) return false;
+  return true;
+}
+
+static int get_nitems(
+    const sdecomp_info_t * info,
+    const sdecomp_pencil_t pencil,
+    const size_t * glsizes,
+    size_t * nitems
+){
+  size_t mysizes[3] = {0};
+  size_t offsets[3] = {0};
+  if(0 != sdecomp_internal_get_pencil_layout(info, pencil, glsizes, mysizes, offsets)) return 1;
+  *nitems = mysizes[0] * mysizes[1] * mysizes[2];
+  return 0;
+}
+
+// the slowest process decides the elapsed time, which is shared by all processes
+static int measure(
+    const char error_label[],
+    const sdecomp_info_t * info,
+    const size_t * glsizes,
+    double * elapsed
+){
+  const size_t size_of_element = sizeof(double);
+  // buffers large enough to store all pencils
+  size_t nitems = 0;
+  for(size_t n = 0; n < SDECOMP_INTERNAL_NROTATIONS; n++){
+    size_t nitems_ = 0;
+    if(0 != get_nitems(info, pencils[n], glsizes, &nitems_)) return 1;
+    nitems = nitems < nitems_ ? nitems_ : nitems;
+  }
+  void * buf0 = sdecomp_internal_calloc(error_label, nitems, size_of_element);
+  void * buf1 = sdecomp_internal_calloc(error_label, nitems, size_of_element);
+  if(NULL == buf0) return 1;
+  if(NULL == buf1) return 1;
+  sdecomp_transpose_plan_t * plans[SDECOMP_INTERNAL_NROTATIONS] = {NULL};
+  for(size_t n = 0; n < SDECOMP_INTERNAL_NROTATIONS; n++){
+    if(0 != sdecomp_internal_transpose_construct(info, pencils[n], pencils[n + 1], glsizes, size_of_element, plans + n)) return 1;
+  }
+  // warm-up
+  for(size_t n = 0; n < SDECOMP_INTERNAL_NROTATIONS; n++){
+    if(0 != sdecomp_internal_transpose_execute(plans[n], n % 2 ? buf1 : buf0, n % 2 ? buf0 : buf1)) return 1;
+  }
+  MPI_Barrier(info->comm_cart);
+  const double tic = MPI_Wtime();
+  for(size_t iter = 0; iter < SDECOMP_INTERNAL_NITERS; iter++){
+    for(size_t n = 0; n < SDECOMP_INTERNAL_NROTATIONS; n++){
+      if(0 != sdecomp_internal_transpose_execute(plans[n], n % 2 ? buf1 : buf0, n % 2 ? buf0 : buf1)) return 1;
+    }
+  }
+  const double toc = MPI_Wtime();
+  *elapsed = toc - tic;
+  MPI_Allreduce(MPI_IN_PLACE, elapsed, 1, MPI_DOUBLE, MPI_MAX, info->comm_cart);
+  for(size_t n = 0; n < SDECOMP_INTERNAL_NROTATIONS; n++){
+    if(0 != sdecomp_internal_transpose_destruct(plans[n])) return 1;
+  }
+  sdecomp_internal_free(buf0);
+  sdecomp_internal_free(buf1);
+  return 0;
+}
+
+/**
+ * @brief find the fastest process grid for the given domain
+ * @param[in]  error_label  : label of the caller
+ * @param[in]  comm_default : MPI communicator which contains all processes
+ * @param[in]  periods      : periodicities in each dimension
+ * @param[in]  options      : options given by the user, glsizes are used
+ * @param[out] dims         : (success) number of processes in each dimension
+ *                            (failure) undefined
+ * @return                  : (success) 0
+ *                            (failure) non-zero value
+ */
+int sdecomp_internal_autotune_dims(
+    const char error_label[],
+    const MPI_Comm comm_default,
+    const bool * periods,
+    const sdecomp_options_t * options,
+    size_t * dims
+){
+  const size_t ndims = 3;
+  const size_t * glsizes = options->glsizes;
+  if(0 != sdecomp_internal_sanitise_null(error_label, "options->glsizes", glsizes)) return 1;
+  for(size_t dim = 0; dim < ndims; dim++){
+    if(0 != sdecomp_internal_sanitise_glsize(error_label, glsizes[dim])) return 1;
+  }
+  int nprocs = 0;
+  MPI_Comm_size(comm_default, &nprocs);
+  // candidates are constructed with the other options, without recursion
+  sdecomp_options_t candidate = *options;
+  candidate.autotune = false;
+  double elapsed_min = 0.;
+  bool is_measured = false;
+  for(int nprocs_y = 1; nprocs_y <= nprocs; nprocs_y++){
+    if(0 != nprocs % nprocs_y) continue;
+    const int nprocs_z = nprocs / nprocs_y;
+    // all processes make the same decision
+    if(!is_feasible(glsizes, nprocs_y, nprocs_z)) continue;
+    const size_t dims_[3] = {1, (size_t)nprocs_y, (size_t)nprocs_z};
+    sdecomp_info_t * info = NULL;
+    if(0 != sdecomp.construct_with_options(comm_default, ndims, dims_, periods, &candidate, &info)) return 1;
+    double elapsed = 0.;
+    if(0 != measure(error_label, info, glsizes, &elapsed)) return 1;
+    if(0 != sdecomp.destruct(info)) return 1;
+    // elapsed is shared by all processes, so that they adopt the same one
+    if(!is_measured || elapsed < elapsed_min){
+      elapsed_min = elapsed;
+      dims[0] = dims_[0];
+      dims[1] = dims_[1];
+      dims[2] = dims_[2];
+      is_measured = true;
+    }
+  }
+  if(!is_measured){
+    SDECOMP_ERROR(
+        "no process grid can decompose glsizes (%zu, %zu, %zu) with %d processes\n",
+        error_label, glsizes[0], glsizes[1], glsizes[2], nprocs
+    );
+    return 1;
+  }
+  return 0;
+}
+
+#undef SDECOMP_INTERNAL_NROTATIONS
+#undef SDECOMP_INTERNAL_NITERS
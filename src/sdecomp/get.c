@@ -67,20 +67,68 @@ static int get_process_config(
   // sanitise
   if(0 != sdecomp_internal_sanitise_pencil(error_label, info->ndims, pencil)) return 1;
   if(0 != sdecomp_internal_sanitise_dir   (error_label, info->ndims,    dir)) return 1;
+  // computed by sdecomp_internal_init_pencil_configs in advance
+  const sdecomp_internal_pencil_config_t * config = info->pencil_configs + pencil;
+  *data = TYPE_NPROCS == type ? config->nprocs[dir] : config->myrank[dir];
+  return 0;
+}
+
+/**
+ * @brief compute and store configurations of all pencils
+ * @param[in]     error_label : label to be attached to error messages
+ * @param[in,out] info        : struct containing information of process distribution,
+ *                                comm_cart and ndims are already set
+ * @return                    : (success) 0
+ *                              (failure) non-zero value
+ */
+int sdecomp_internal_init_pencil_configs(
+    const char error_label[],
+    sdecomp_info_t * info
+){
+  if(0 != sdecomp_internal_sanitise_null(error_label, "info", info)) return 1;
+  if(0 != sdecomp_internal_sanitise_ndims(error_label, info->ndims)) return 1;
+  const size_t ndims = info->ndims;
   // fetch x1pencil
   int buffers[3][3] = {0};
   MPI_Cart_get(
       info->comm_cart,
-      info->ndims,
+      (int)ndims,
       buffers[0],
       buffers[1],
       buffers[2]
   );
-  // convert it to the desired pencil
-  if(2 == info->ndims){
-    *data = buffers[TYPE_NPROCS == type ? 0 : 2][check_table_2d(pencil, dir)];
-  }else{
-    *data = buffers[TYPE_NPROCS == type ? 0 : 2][check_table_3d(pencil, dir)];
+  // always interested in one-process away
+  const int disp = 1;
+  int neighbours[3][2] = {{MPI_PROC_NULL, MPI_PROC_NULL}, {MPI_PROC_NULL, MPI_PROC_NULL}, {MPI_PROC_NULL, MPI_PROC_NULL}};
+  for(size_t dim = 0; dim < ndims; dim++){
+    MPI_Cart_shift(
+        info->comm_cart,
+        (int)dim,
+        disp,
+        neighbours[dim] + 0,
+        neighbours[dim] + 1
+    );
+  }
+  // convert them to all pencils
+  // NOTE: see figure to see the correspondence
+  const size_t npencils = 2 == ndims ? 2 : 6;
+  for(size_t pencil = 0; pencil < npencils; pencil++){
+    sdecomp_internal_pencil_config_t * config = info->pencil_configs + pencil;
+    for(size_t dir = 0; dir < 3; dir++){
+      config->nprocs[dir] = 1;
+      config->myrank[dir] = 0;
+      config->neighbours[dir][0] = MPI_PROC_NULL;
+      config->neighbours[dir][1] = MPI_PROC_NULL;
+    }
+    for(size_t dir = 0; dir < ndims; dir++){
+      const sdecomp_dir_t direction = 2 == ndims
+        ? check_table_2d((sdecomp_pencil_t)pencil, (sdecomp_dir_t)dir)
+        : check_table_3d((sdecomp_pencil_t)pencil, (sdecomp_dir_t)dir);
+      config->nprocs[dir] = buffers[0][direction];
+      config->myrank[dir] = buffers[2][direction];
+      config->neighbours[dir][0] = neighbours[direction][0];
+      config->neighbours[dir][1] = neighbours[direction][1];
+    }
   }
   return 0;
 }
@@ -157,28 +205,10 @@ int sdecomp_internal_get_neighbours(
   // reject all invalid pencils and directions to simplify the following conditions
   if(0 != sdecomp_internal_sanitise_pencil(error_label, info->ndims, pencil)) return 1;
   if(0 != sdecomp_internal_sanitise_dir   (error_label, info->ndims,    dir)) return 1;
-  // initialise with "no neighbour"
-  neighbours[0] = MPI_PROC_NULL;
-  neighbours[1] = MPI_PROC_NULL;
-  // check direction, I need direction w.r.t. comm_cart (x1 pencil)
-  // NOTE: see figure to see the correspondence
-  int direction = -1;
-  if(2 == info->ndims){
-    direction = check_table_2d(pencil, dir);
-  }else{
-    direction = check_table_3d(pencil, dir);
-  }
-  MPI_Comm comm_cart = MPI_COMM_NULL;
-  sdecomp.get_comm_cart(info, &comm_cart);
-  // always interested in one-process away
-  const int disp = 1;
-  MPI_Cart_shift(
-      comm_cart,
-      direction,
-      disp,
-      neighbours + 0,
-      neighbours + 1
-  );
+  // computed by sdecomp_internal_init_pencil_configs in advance
+  const sdecomp_internal_pencil_config_t * config = info->pencil_configs + pencil;
+  neighbours[0] = config->neighbours[dir][0];
+  neighbours[1] = config->neighbours[dir][1];
   return 0;
 }
 
@@ -190,6 +220,7 @@ static int get_pencil_config(
     const size_t glsize,
     int (* const kernel)(
       const char error_label[],
+      const sdecomp_internal_weights_t * weights,
       const size_t glsize,
       const int nprocs,
       const int myrank,
@@ -201,13 +232,11 @@ static int get_pencil_config(
   // sanitise
   if(0 != sdecomp_internal_sanitise_pencil(error_label, info->ndims, pencil)) return 1;
   if(0 != sdecomp_internal_sanitise_dir   (error_label, info->ndims,    dir)) return 1;
-  // compute number of process and my location in the given direction
-  int nprocs = 0;
-  int myrank = 0;
-  if(0 != sdecomp_internal_get_nprocs(info, pencil, dir, &nprocs)) return 1;
-  if(0 != sdecomp_internal_get_myrank(info, pencil, dir, &myrank)) return 1;
+  // number of process and my location in the given direction
+  const int nprocs = info->pencil_configs[pencil].nprocs[dir];
+  const int myrank = info->pencil_configs[pencil].myrank[dir];
   // call one of "number of grid calculator" or "offset calculator"
-  if(0 != kernel(error_label, glsize, nprocs, myrank, result)) return 1;
+  if(0 != kernel(error_label, info->weights + dir, glsize, nprocs, myrank, result)) return 1;
   return 0;
 }
 
@@ -265,3 +294,40 @@ int sdecomp_internal_get_pencil_offset(
   return 0;
 }
 
+/**
+ * @brief get local sizes and offsets of the given pencil in all directions at once
+ * @param[in]  info    : struct containing information of process distribution
+ * @param[in]  pencil  : type of pencil (e.g., SDECOMP_X1PENCIL)
+ * @param[in]  glsizes : number of global grid points in all directions
+ * @param[out] mysizes : (success) number of local grid points in all directions
+ *                       (failure) undefined
+ * @param[out] offsets : (success) offsets in all directions
+ *                       (failure) undefined
+ * @return             : (success) 0
+ *                       (failure) non-zero value
+ */
+int sdecomp_internal_get_pencil_layout(
+    const sdecomp_info_t * info,
+    const sdecomp_pencil_t pencil,
+    const size_t * glsizes,
+    size_t * mysizes,
+    size_t * offsets
+){
+  const char error_label[] = {"sdecomp.get_pencil_layout"};
+  // NULL check
+  if(0 != sdecomp_internal_sanitise_null(error_label,    "info",    info)) return 1;
+  if(0 != sdecomp_internal_sanitise_null(error_label, "glsizes", glsizes)) return 1;
+  if(0 != sdecomp_internal_sanitise_null(error_label, "mysizes", mysizes)) return 1;
+  if(0 != sdecomp_internal_sanitise_null(error_label, "offsets", offsets)) return 1;
+  if(0 != sdecomp_internal_sanitise_pencil(error_label, info->ndims, pencil)) return 1;
+  // main
+  const sdecomp_internal_pencil_config_t * config = info->pencil_configs + pencil;
+  for(size_t dir = 0; dir < info->ndims; dir++){
+    const int nprocs = config->nprocs[dir];
+    const int myrank = config->myrank[dir];
+    const sdecomp_internal_weights_t * weights = info->weights + dir;
+    if(0 != sdecomp_internal_kernel_get_mysize(error_label, weights, glsizes[dir], nprocs, myrank, mysizes + dir)) return 1;
+    if(0 != sdecomp_internal_kernel_get_offset(error_label, weights, glsizes[dir], nprocs, myrank, offsets + dir)) return 1;
+  }
+  return 0;
+}
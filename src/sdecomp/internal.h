@@ -40,9 +40,64 @@
   fflush(stream); \
 }
 
+// tuned way to perform a pencil rotation
+//   key: process grid (and whether it is laid out following the node topology),
+//        hash of the weights of the decomposition (zero if uniform),
+//        pencil pair, global sizes (before and after rotated),
+//        element size, wire format and persistent or not
+//   value: engine and number of slabs
+// NOTE: missing dimensions (2D) are zero
+typedef struct {
+  size_t ndims;
+  int dims[3];
+  bool is_laid_out_by_nodes;
+  unsigned long long weights_hash;
+  sdecomp_pencil_t pencil_bef;
+  sdecomp_pencil_t pencil_aft;
+  size_t glsizes_bef[3];
+  size_t glsizes_aft[3];
+  size_t size_of_element;
+  sdecomp_transpose_wire_t wire;
+  bool persistent;
+  sdecomp_transpose_engine_t engine;
+  size_t nslabs;
+} sdecomp_internal_wisdom_entry_t;
+
+// collection of tuned results
+typedef struct {
+  size_t nentries;
+  sdecomp_internal_wisdom_entry_t * entries;
+} sdecomp_internal_wisdom_t;
+
+// process configuration of one pencil, converted from comm_cart (x1 pencil)
+//   so that the getters are array reads without calling MPI functions
+// NOTE: indices are sdecomp_dir_t, missing dimension (2D) is unused
+typedef struct {
+  int nprocs[3];
+  int myrank[3];
+  int neighbours[3][2];
+} sdecomp_internal_pencil_config_t;
+
+// weights of the non-uniform decomposition in one direction,
+//   which are regarded as a piecewise-constant density over the whole domain
+// NOTE: cumsums is NULL for the uniform decomposition
+typedef struct {
+  size_t nweights;
+  // cumulative sums of the weights, nweights + 1 items starting from 0
+  double * cumsums;
+} sdecomp_internal_weights_t;
+
 struct sdecomp_info_t_ {
   MPI_Comm comm_cart;
   size_t ndims;
+  // processes are laid out following the node topology (see sdecomp_options_t)
+  bool is_laid_out_by_nodes;
+  // configurations of all pencils, indices are sdecomp_pencil_t
+  sdecomp_internal_pencil_config_t pencil_configs[6];
+  // weights of the decomposition in each direction, indices are sdecomp_dir_t
+  sdecomp_internal_weights_t weights[3];
+  // tuned results of transpose plans, which are updated by the constructors
+  sdecomp_internal_wisdom_t * wisdom;
 };
 
 // general-purpose memory allocator
@@ -60,6 +115,7 @@ extern void sdecomp_internal_free(
 // kernel function to decide local size of pencils
 extern int sdecomp_internal_kernel_get_mysize(
     const char error_label[],
+    const sdecomp_internal_weights_t * weights,
     const size_t glsize,
     const int nprocs,
     const int myrank,
@@ -69,6 +125,7 @@ extern int sdecomp_internal_kernel_get_mysize(
 // kernel function to decide local offset of pencils
 extern int sdecomp_internal_kernel_get_offset(
     const char error_label[],
+    const sdecomp_internal_weights_t * weights,
     const size_t glsize,
     const int nprocs,
     const int myrank,
@@ -117,6 +174,30 @@ extern int sdecomp_internal_get_pencil_offset(
     size_t * offset
 );
 
+// local sizes and offsets of the given pencil in all directions
+extern int sdecomp_internal_get_pencil_layout(
+    const sdecomp_info_t * info,
+    const sdecomp_pencil_t pencil,
+    const size_t * glsizes,
+    size_t * mysizes,
+    size_t * offsets
+);
+
+// find the fastest process grid for three-dimensional domains
+extern int sdecomp_internal_autotune_dims(
+    const char error_label[],
+    const MPI_Comm comm_default,
+    const bool * periods,
+    const sdecomp_options_t * options,
+    size_t * dims
+);
+
+// compute and store configurations of all pencils from comm_cart
+extern int sdecomp_internal_init_pencil_configs(
+    const char error_label[],
+    sdecomp_info_t * info
+);
+
 // constructor of sdecomp_transpose_plan_t
 extern int sdecomp_internal_transpose_construct(
     const sdecomp_info_t * info,
@@ -127,6 +208,30 @@ extern int sdecomp_internal_transpose_construct(
     sdecomp_transpose_plan_t ** plan
 );
 
+// constructor of sdecomp_transpose_plan_t with options
+extern int sdecomp_internal_transpose_construct_with_options(
+    const sdecomp_info_t * info,
+    const sdecomp_pencil_t pencil_bef,
+    const sdecomp_pencil_t pencil_aft,
+    const size_t * glsizes,
+    const size_t size_of_element,
+    const sdecomp_transpose_options_t * options,
+    sdecomp_transpose_plan_t ** plan
+);
+
+// constructor of sdecomp_transpose_plan_t, global and element sizes differ before and after rotated
+extern int sdecomp_internal_transpose_construct_resized(
+    const sdecomp_info_t * info,
+    const sdecomp_pencil_t pencil_bef,
+    const sdecomp_pencil_t pencil_aft,
+    const size_t * glsizes_bef,
+    const size_t * glsizes_aft,
+    const size_t size_of_element_bef,
+    const size_t size_of_element_aft,
+    const sdecomp_transpose_options_t * options,
+    sdecomp_transpose_plan_t ** plan
+);
+
 // perform pencil rotation
 extern int sdecomp_internal_transpose_execute(
     sdecomp_transpose_plan_t * plan,
@@ -134,6 +239,64 @@ extern int sdecomp_internal_transpose_execute(
     void * restrict recvbuf
 );
 
+// perform pencil rotation in place
+extern int sdecomp_internal_transpose_execute_inplace(
+    sdecomp_transpose_plan_t * plan,
+    void * buf
+);
+
+// perform pencil rotations of several fields at once
+extern int sdecomp_internal_transpose_execute_batch(
+    sdecomp_transpose_plan_t * restrict plan,
+    const size_t nfields,
+    const void * const * sendbufs,
+    void * const * recvbufs
+);
+
+// find the fastest way to perform a pencil rotation
+extern int sdecomp_internal_transpose_autotune(
+    const char error_label[],
+    const sdecomp_info_t * info,
+    const sdecomp_pencil_t pencil_bef,
+    const sdecomp_pencil_t pencil_aft,
+    const size_t * glsizes_bef,
+    const size_t * glsizes_aft,
+    const size_t size_of_element,
+    const sdecomp_transpose_options_t * options,
+    sdecomp_transpose_options_t * tuned
+);
+
+// write tuned results to a file
+extern int sdecomp_internal_transpose_export_wisdom(
+    const sdecomp_info_t * info,
+    const char filename[]
+);
+
+// read tuned results from a file
+extern int sdecomp_internal_transpose_import_wisdom(
+    const sdecomp_info_t * info,
+    const char filename[]
+);
+
+// initiate non-blocking pencil rotation
+extern int sdecomp_internal_transpose_start(
+    sdecomp_transpose_plan_t * plan,
+    const void * restrict sendbuf,
+    void * restrict recvbuf,
+    sdecomp_transpose_request_t ** request
+);
+
+// check completion of non-blocking pencil rotation
+extern int sdecomp_internal_transpose_test(
+    sdecomp_transpose_request_t * request,
+    bool * flag
+);
+
+// complete non-blocking pencil rotation
+extern int sdecomp_internal_transpose_wait(
+    sdecomp_transpose_request_t * request
+);
+
 // destructor of sdecomp_transpose_plan_t
 extern int sdecomp_internal_transpose_destruct(
     sdecomp_transpose_plan_t * plan
@@ -187,6 +350,51 @@ extern int sdecomp_internal_sanitise_size_of_element(
     const size_t size_of_element
 );
 
+extern int sdecomp_internal_sanitise_engine(
+    const char error_label[],
+    const sdecomp_transpose_engine_t engine
+);
+
+extern int sdecomp_internal_sanitise_nslabs(
+    const char error_label[],
+    const size_t nslabs,
+    const bool persistent
+);
+
+extern int sdecomp_internal_sanitise_wire(
+    const char error_label[],
+    const sdecomp_transpose_wire_t wire,
+    const sdecomp_transpose_engine_t engine,
+    const size_t size_of_element
+);
+
+extern int sdecomp_internal_sanitise_compress(
+    const char error_label[],
+    const bool compress,
+    const sdecomp_transpose_engine_t engine,
+    const size_t nslabs,
+    const bool persistent
+);
+
+extern bool sdecomp_internal_is_packing_engine(
+    const sdecomp_transpose_engine_t engine
+);
+
+extern bool sdecomp_internal_is_persistent_engine(
+    const sdecomp_transpose_engine_t engine
+);
+
+extern bool sdecomp_internal_is_pipelined_engine(
+    const sdecomp_transpose_engine_t engine
+);
+
+extern int sdecomp_internal_sanitise_engine_features(
+    const char error_label[],
+    const sdecomp_transpose_engine_t engine,
+    const size_t nslabs,
+    const bool persistent
+);
+
 extern int sdecomp_internal_sanitise_pencil_pair_2d(
     const char error_label[],
     const sdecomp_pencil_t pencil_bef,
@@ -200,4 +408,19 @@ extern int sdecomp_internal_sanitise_pencil_pair_3d(
     bool * is_forward
 );
 
+extern int sdecomp_internal_sanitise_glsizes_pair(
+    const char error_label[],
+    const size_t ndims,
+    const sdecomp_pencil_t pencil_bef,
+    const sdecomp_pencil_t pencil_aft,
+    const size_t * glsizes_bef,
+    const size_t * glsizes_aft
+);
+
+extern int sdecomp_internal_sanitise_weights(
+    const char error_label[],
+    const size_t nweights,
+    const double * weights
+);
+
 #endif // SDECOMP_INTERNAL_H
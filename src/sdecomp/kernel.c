@@ -67,9 +67,85 @@ static int compare_nprocs_and_myrank(
   return 0;
 }
 
+// cumulative weight from the beginning of the domain to the index-th grid point
+// NOTE: weights are a piecewise-constant density over the whole domain,
+//   so that the same weights can be used for any glsize
+static double get_cumsum(
+    const sdecomp_internal_weights_t * weights,
+    const size_t glsize,
+    const size_t index
+){
+  const size_t nweights = weights->nweights;
+  const double * cumsums = weights->cumsums;
+  // position in terms of the weights: index * nweights / glsize
+  const size_t quotient = index * nweights / glsize;
+  const size_t remainder = index * nweights % glsize;
+  if(nweights <= quotient) return cumsums[nweights];
+  const double fraction = 1. * remainder / glsize;
+  return cumsums[quotient] + fraction * (cumsums[quotient + 1] - cumsums[quotient]);
+}
+
+// the border of the n-th process from the beginning of the domain,
+//   such that the sums of weights taken care of by the processes are balanced
+static size_t get_border(
+    const sdecomp_internal_weights_t * weights,
+    const size_t glsize,
+    const int nprocs,
+    const int n
+){
+  if(0 == n) return 0;
+  if(nprocs == n) return glsize;
+  const double target = weights->cumsums[weights->nweights] * n / nprocs;
+  // the first grid point whose cumulative weight reaches the target
+  size_t lower = 0;
+  size_t upper = glsize;
+  while(lower < upper){
+    const size_t middle = lower + (upper - lower) / 2;
+    if(get_cumsum(weights, glsize, middle) < target){
+      lower = middle + 1;
+    }else{
+      upper = middle;
+    }
+  }
+  // choose the nearer one of the two grid points sandwiching the target
+  if(0 < lower){
+    const double below = target - get_cumsum(weights, glsize, lower - 1);
+    const double above = get_cumsum(weights, glsize, lower) - target;
+    if(below <= above) lower -= 1;
+  }
+  return lower;
+}
+
+// non-uniform decomposition, which is used when weights are given
+static int get_range_weighted(
+    const char error_label[],
+    const sdecomp_internal_weights_t * weights,
+    const size_t glsize,
+    const int nprocs,
+    const int myrank,
+    size_t * mysize,
+    size_t * offset
+){
+  const size_t lower = get_border(weights, glsize, nprocs, myrank    );
+  const size_t upper = get_border(weights, glsize, nprocs, myrank + 1);
+  // too skewed weights may leave processes having no grid point
+  if(upper <= lower){
+    SDECOMP_ERROR(
+        "weights are too skewed to give the process (%d out of %d) grid points (glsize: %zu)\n",
+        error_label, myrank, nprocs, glsize
+    );
+    return 1;
+  }
+  *mysize = upper - lower;
+  *offset = lower;
+  return 0;
+}
+
 // compute number of grid points taken care of by the process
+// NOTE: weights can be NULL or have no weight, giving the uniform decomposition
 int sdecomp_internal_kernel_get_mysize(
     const char error_label[],
+    const sdecomp_internal_weights_t * weights,
     const size_t glsize,
     const int nprocs,
     const int myrank,
@@ -81,6 +157,10 @@ int sdecomp_internal_kernel_get_mysize(
   if(0 != sdecomp_internal_sanitise_glsize(error_label, glsize)) return 1;
   if(0 != compare_glsize_and_nprocs(error_label, glsize, nprocs)) return 1;
   if(0 != compare_nprocs_and_myrank(error_label, nprocs, myrank)) return 1;
+  if(NULL != weights && NULL != weights->cumsums){
+    size_t offset = 0;
+    return get_range_weighted(error_label, weights, glsize, nprocs, myrank, mysize, &offset);
+  }
   // example: glsize: 10, nprocs: 3 (3 processes in total)
   //   myrank = 0 -> mysize = 3
   //   myrank = 1 -> mysize = 3
@@ -91,8 +171,10 @@ int sdecomp_internal_kernel_get_mysize(
 }
 
 // compute offset of the grid point taken care of by the process
+// NOTE: weights can be NULL or have no weight, giving the uniform decomposition
 int sdecomp_internal_kernel_get_offset(
     const char error_label[],
+    const sdecomp_internal_weights_t * weights,
     const size_t glsize,
     const int nprocs,
     const int myrank,
@@ -104,16 +186,23 @@ int sdecomp_internal_kernel_get_offset(
   if(0 != sdecomp_internal_sanitise_glsize(error_label, glsize)) return 1;
   if(0 != compare_glsize_and_nprocs(error_label, glsize, nprocs)) return 1;
   if(0 != compare_nprocs_and_myrank(error_label, nprocs, myrank)) return 1;
+  if(NULL != weights && NULL != weights->cumsums){
+    size_t mysize = 0;
+    return get_range_weighted(error_label, weights, glsize, nprocs, myrank, &mysize, offset);
+  }
   // example: glsize: 10, nprocs: 3 (3 processes in total)
   //   myrank = 0 -> offset = 0
   //   myrank = 1 -> offset = 3
   //   myrank = 2 -> offset = 6
-  *offset = 0;
-  for(int i = 0; i < myrank; i++){
-    size_t val = 0;
-    if(0 != sdecomp_internal_kernel_get_mysize(error_label, glsize, nprocs, i, &val)) return 1;
-    *offset += val;
-  }
+  // NOTE: the first (nprocs - glsize % nprocs) processes have glsize / nprocs points
+  //   and the others have one more (see sdecomp_internal_kernel_get_mysize),
+  //   so that the sum over the lower ranks is given in a closed form,
+  //   which keeps the cost independent of nprocs
+  //   (plans ask for the offsets of all processes in a communicator)
+  const size_t quotient = glsize / (size_t)nprocs;
+  const size_t nsmaller = (size_t)nprocs - glsize % (size_t)nprocs;
+  const size_t rank = (size_t)myrank;
+  *offset = quotient * rank + (nsmaller < rank ? rank - nsmaller : 0);
   return 0;
 }
 
@@ -39,6 +39,15 @@ const sdecomp_pencil_t SDECOMP_X2PENCIL = 3;
 const sdecomp_pencil_t SDECOMP_Y2PENCIL = 4;
 const sdecomp_pencil_t SDECOMP_Z2PENCIL = 5;
 
+// default options of sdecomp_info_t
+const sdecomp_options_t SDECOMP_DEFAULT_OPTIONS = {
+  .node_aware = false,
+  .autotune   = false,
+  .glsizes    = NULL,
+  .weights    = {NULL, NULL, NULL},
+  .nweights   = {0, 0, 0},
+};
+
 static int check_dims(
     const char error_label[],
     const MPI_Comm comm_default,
@@ -112,6 +121,65 @@ static int check_dims(
   return 0;
 }
 
+// find which node I belong to and my position in it
+// NOTE: is_uniform is false when the numbers of processes differ among nodes
+static int get_node_config(
+    const MPI_Comm comm_default,
+    int * nprocs_node,
+    int * myrank_node,
+    int * mynode,
+    bool * is_uniform
+){
+  int myrank = 0;
+  MPI_Comm_rank(comm_default, &myrank);
+  // processes sharing memory
+  MPI_Comm comm_node = MPI_COMM_NULL;
+  MPI_Comm_split_type(comm_default, MPI_COMM_TYPE_SHARED, myrank, MPI_INFO_NULL, &comm_node);
+  MPI_Comm_size(comm_node, nprocs_node);
+  MPI_Comm_rank(comm_node, myrank_node);
+  // number the nodes by the leaders, which is shared in each node
+  MPI_Comm comm_leaders = MPI_COMM_NULL;
+  MPI_Comm_split(comm_default, 0 == *myrank_node ? 0 : MPI_UNDEFINED, myrank, &comm_leaders);
+  *mynode = 0;
+  if(MPI_COMM_NULL != comm_leaders){
+    MPI_Comm_rank(comm_leaders, mynode);
+    MPI_Comm_free(&comm_leaders);
+  }
+  MPI_Bcast(mynode, 1, MPI_INT, 0, comm_node);
+  MPI_Comm_free(&comm_node);
+  // check the number of processes of all nodes
+  int nprocs_node_min = 0;
+  int nprocs_node_max = 0;
+  MPI_Allreduce(nprocs_node, &nprocs_node_min, 1, MPI_INT, MPI_MIN, comm_default);
+  MPI_Allreduce(nprocs_node, &nprocs_node_max, 1, MPI_INT, MPI_MAX, comm_default);
+  *is_uniform = nprocs_node_min == nprocs_node_max;
+  return 0;
+}
+
+// decompose the domain such that the processes in y direction share a node,
+//   i.e. dims[1] is a divisor of the number of processes in a node,
+//   while dims[1] and dims[2] are as balanced as possible
+//   (larger dims[1] is preferred, which is consistent with MPI_Dims_create)
+static int create_dims_node_aware(
+    const int nprocs,
+    const int nprocs_node,
+    int * dims
+){
+  int best = 1;
+  for(int cand = 1; cand <= nprocs_node; cand++){
+    if(0 != nprocs_node % cand || 0 != nprocs % cand) continue;
+    const int score_cand = cand < nprocs / cand ? cand : nprocs / cand;
+    const int score_best = best < nprocs / best ? best : nprocs / best;
+    if(score_best <= score_cand){
+      best = cand;
+    }
+  }
+  dims[0] = 1;
+  dims[1] = best;
+  dims[2] = nprocs / best;
+  return 0;
+}
+
 static int create_new_communicator(
     const char error_label[],
     const MPI_Comm comm_default,
@@ -119,7 +187,9 @@ static int create_new_communicator(
     const size_t * dims,
     const bool * periods,
     const bool decomp_automatically,
-    MPI_Comm * comm_cart
+    const bool node_aware,
+    MPI_Comm * comm_cart,
+    bool * is_laid_out_by_nodes
 ){
   // number of total processes participating in this decomposition
   int nprocs = 0;
@@ -130,7 +200,20 @@ static int create_new_communicator(
   int * periods_ = sdecomp_internal_calloc(error_label, ndims, sizeof(int));
   if(NULL ==    dims_) return 1;
   if(NULL == periods_) return 1;
-  if(decomp_automatically){
+  // node topology, which only matters for three-dimensional domains
+  //   since all processes are aligned in y direction for two-dimensional domains
+  int nprocs_node = 1;
+  int myrank_node = 0;
+  int mynode = 0;
+  bool is_node_aware = false;
+  if(node_aware && 3 == ndims){
+    bool is_uniform = false;
+    if(0 != get_node_config(comm_default, &nprocs_node, &myrank_node, &mynode, &is_uniform)) return 1;
+    is_node_aware = is_uniform;
+  }
+  if(decomp_automatically && is_node_aware){
+    if(0 != create_dims_node_aware(nprocs, nprocs_node, dims_)) return 1;
+  }else if(decomp_automatically){
     for(size_t dim = 0; dim < ndims; dim++){
       // force 1st dimension NOT decomposed (assign 1)
       dims_[dim] = dim == 0 ? 1 : 0;
@@ -147,49 +230,86 @@ static int create_new_communicator(
     // copy user-specified value
     periods_[dim] = (int)(periods[dim]);
   }
+  // user-specified decomposition may not fit in the nodes
+  if(is_node_aware && 0 != nprocs_node % dims_[1]){
+    is_node_aware = false;
+  }
   // MPI rank in comm_default is no longer important,
   //   so I allow to override it
-  const int reorder = 1;
+  int reorder = 1;
+  MPI_Comm comm_ordered = comm_default;
+  if(is_node_aware){
+    // assign the positions by myself:
+    //   the processes in a node are split into groups of dims[1] processes,
+    //   each of which is aligned in y direction
+    //   and the groups are aligned in z direction
+    const int coord_y = myrank_node % dims_[1];
+    const int coord_z = mynode * (nprocs_node / dims_[1]) + myrank_node / dims_[1];
+    // rank in the Cartesian communicator (row-major)
+    const int key = coord_y * dims_[2] + coord_z;
+    MPI_Comm_split(comm_default, 0, key, &comm_ordered);
+    reorder = 0;
+  }
   // create communicator
   *comm_cart = MPI_COMM_NULL;
   MPI_Cart_create(
-      comm_default,
+      comm_ordered,
       (int)ndims,
       dims_,
       periods_,
       reorder,
       comm_cart
   );
+  if(comm_default != comm_ordered){
+    MPI_Comm_free(&comm_ordered);
+  }
+  *is_laid_out_by_nodes = is_node_aware;
   // clean-up integer buffers
   sdecomp_internal_free(   dims_);
   sdecomp_internal_free(periods_);
   return 0;
 }
 
-/**
- * @brief construct a structure sdecomp_info_t
- * @param[in] comm_default : MPI communicator which contains all processes
- *                             participating in the decomposition
- *                             (normally MPI_COMM_WORLD)
- * @param[in] ndims        : number of dimensions of the target domain
- * @param[in] dims         : number of processes in each dimension
- * @param[in] periods      : periodicities in each dimension
- * @param[out] info        : (success) a pointer to sdecomp_info_t
- *                           (failure) NULL pointer
- * @return                 : (success) 0
- *                           (failure) non-zero value
- */
+// store the cumulative sums of the weights given by the user
+static int init_weights(
+    const char error_label[],
+    const size_t ndims,
+    const sdecomp_options_t * options,
+    sdecomp_internal_weights_t * weights
+){
+  for(size_t dim = 0; dim < ndims; dim++){
+    const double * values = options->weights[dim];
+    const size_t nvalues = options->nweights[dim];
+    weights[dim].nweights = 0;
+    weights[dim].cumsums = NULL;
+    // uniform decomposition
+    if(NULL == values) continue;
+    if(0 != sdecomp_internal_sanitise_weights(error_label, nvalues, values)) return 1;
+    double * cumsums = sdecomp_internal_calloc(error_label, nvalues + 1, sizeof(double));
+    if(NULL == cumsums) return 1;
+    cumsums[0] = 0.;
+    for(size_t n = 0; n < nvalues; n++){
+      cumsums[n + 1] = cumsums[n] + values[n];
+    }
+    weights[dim].nweights = nvalues;
+    weights[dim].cumsums = cumsums;
+  }
+  return 0;
+}
+
 static int construct(
+    const char error_label[],
     const MPI_Comm comm_default,
     const size_t ndims,
     const size_t * dims,
     const bool * periods,
+    const sdecomp_options_t * options,
     sdecomp_info_t ** info
 ){
-  const char error_label[] = {"sdecomp.construct"};
   *info = NULL;
   if(0 != sdecomp_internal_sanitise_null(error_label,    "dims",    dims)) return 1;
   if(0 != sdecomp_internal_sanitise_null(error_label, "periods", periods)) return 1;
+  if(0 != sdecomp_internal_sanitise_null(error_label, "options", options)) return 1;
   if(0 != sdecomp_internal_sanitise_null(error_label,    "info",    info)) return 1;
   if(0 != sdecomp_internal_sanitise_ndims(error_label, ndims))             return 1;
   if(0 != sdecomp_internal_sanitise_comm(error_label, comm_default))       return 1;
@@ -204,8 +324,17 @@ static int construct(
         dims,
         &decomp_automatically
   )) return 1;
+  // measure candidates and adopt the fastest one,
+  //   which is regarded as the one given by the user
+  size_t tuned_dims[3] = {0};
+  if(options->autotune && decomp_automatically && 3 == ndims){
+    if(0 != sdecomp_internal_autotune_dims(error_label, comm_default, periods, options, tuned_dims)) return 1;
+    dims = tuned_dims;
+    decomp_automatically = false;
+  }
   // create new communicator (x1 pencil)
   MPI_Comm comm_cart = MPI_COMM_NULL;
+  bool is_laid_out_by_nodes = false;
   if(0 != create_new_communicator(
         error_label,
         comm_default,
@@ -213,17 +342,78 @@ static int construct(
         dims,
         periods,
         decomp_automatically,
-        &comm_cart
+        options->node_aware,
+        &comm_cart,
+        &is_laid_out_by_nodes
   )) return 1;
   // create sdecomp_info_t
   *info = sdecomp_internal_calloc(error_label, 1, sizeof(sdecomp_info_t));
   if(NULL == *info) return 1;
+  sdecomp_internal_wisdom_t * wisdom = sdecomp_internal_calloc(error_label, 1, sizeof(sdecomp_internal_wisdom_t));
+  if(NULL == wisdom) return 1;
   // assign members
   (*info)->ndims = ndims;
   (*info)->comm_cart = comm_cart;
+  (*info)->is_laid_out_by_nodes = is_laid_out_by_nodes;
+  (*info)->wisdom = wisdom;
+  // process configurations of all pencils, which the getters refer to
+  if(0 != sdecomp_internal_init_pencil_configs(error_label, *info)) return 1;
+  // weights of the decomposition, which the getters and the plans refer to
+  if(0 != init_weights(error_label, ndims, options, (*info)->weights)) return 1;
   return 0;
 }
 
+/**
+ * @brief construct a structure sdecomp_info_t
+ * @param[in] comm_default : MPI communicator which contains all processes
+ *                             participating in the decomposition
+ *                             (normally MPI_COMM_WORLD)
+ * @param[in] ndims        : number of dimensions of the target domain
+ * @param[in] dims         : number of processes in each dimension
+ * @param[in] periods      : periodicities in each dimension
+ * @param[out] info        : (success) a pointer to sdecomp_info_t
+ *                           (failure) NULL pointer
+ * @return                 : (success) 0
+ *                           (failure) non-zero value
+ */
+static int construct_default(
+    const MPI_Comm comm_default,
+    const size_t ndims,
+    const size_t * dims,
+    const bool * periods,
+    sdecomp_info_t ** info
+){
+  const char error_label[] = {"sdecomp.construct"};
+  const sdecomp_options_t * options = &SDECOMP_DEFAULT_OPTIONS;
+  return construct(error_label, comm_default, ndims, dims, periods, options, info);
+}
+
+/**
+ * @brief construct a structure sdecomp_info_t with options
+ * @param[in] comm_default : MPI communicator which contains all processes
+ *                             participating in the decomposition
+ *                             (normally MPI_COMM_WORLD)
+ * @param[in] ndims        : number of dimensions of the target domain
+ * @param[in] dims         : number of processes in each dimension
+ * @param[in] periods      : periodicities in each dimension
+ * @param[in] options      : options, see sdecomp_options_t
+ * @param[out] info        : (success) a pointer to sdecomp_info_t
+ *                           (failure) NULL pointer
+ * @return                 : (success) 0
+ *                           (failure) non-zero value
+ */
+static int construct_with_options(
+    const MPI_Comm comm_default,
+    const size_t ndims,
+    const size_t * dims,
+    const bool * periods,
+    const sdecomp_options_t * options,
+    sdecomp_info_t ** info
+){
+  const char error_label[] = {"sdecomp.construct_with_options"};
+  return construct(error_label, comm_default, ndims, dims, periods, options, info);
+}
+
 /**
  * @brief destruct a structure sdecomp_t
  * @param[in,out] info : structure to be cleaned up
@@ -236,6 +426,11 @@ static int destruct(
   if(0 != sdecomp_internal_sanitise_null(error_label, "info", info)) return 1;
   MPI_Comm * comm = &info->comm_cart;
   MPI_Comm_free(comm);
+  for(size_t dim = 0; dim < info->ndims; dim++){
+    sdecomp_internal_free(info->weights[dim].cumsums);
+  }
+  sdecomp_internal_free(info->wisdom->entries);
+  sdecomp_internal_free(info->wisdom);
   sdecomp_internal_free(info);
   return 0;
 }
@@ -290,21 +485,32 @@ static int get_comm_rank(
 
 // assign all "methods" (pointers to all internal functions)
 const sdecomp_t sdecomp = {
-  .construct         = construct,
-  .destruct          = destruct,
-  .get_ndims         = get_ndims,
-  .get_comm_size     = get_comm_size,
-  .get_comm_rank     = get_comm_rank,
-  .get_comm_cart     = get_comm_cart,
-  .get_nprocs        = sdecomp_internal_get_nprocs,
-  .get_myrank        = sdecomp_internal_get_myrank,
-  .get_neighbours    = sdecomp_internal_get_neighbours,
-  .get_pencil_mysize = sdecomp_internal_get_pencil_mysize,
-  .get_pencil_offset = sdecomp_internal_get_pencil_offset,
-  .transpose         = {
-    .construct = sdecomp_internal_transpose_construct,
-    .execute   = sdecomp_internal_transpose_execute,
-    .destruct  = sdecomp_internal_transpose_destruct,
+  .construct              = construct_default,
+  .construct_with_options = construct_with_options,
+  .destruct               = destruct,
+  .get_ndims              = get_ndims,
+  .get_comm_size          = get_comm_size,
+  .get_comm_rank          = get_comm_rank,
+  .get_comm_cart          = get_comm_cart,
+  .get_nprocs             = sdecomp_internal_get_nprocs,
+  .get_myrank             = sdecomp_internal_get_myrank,
+  .get_neighbours         = sdecomp_internal_get_neighbours,
+  .get_pencil_mysize      = sdecomp_internal_get_pencil_mysize,
+  .get_pencil_offset      = sdecomp_internal_get_pencil_offset,
+  .get_pencil_layout      = sdecomp_internal_get_pencil_layout,
+  .transpose              = {
+    .construct              = sdecomp_internal_transpose_construct,
+    .construct_with_options = sdecomp_internal_transpose_construct_with_options,
+    .construct_resized      = sdecomp_internal_transpose_construct_resized,
+    .execute                = sdecomp_internal_transpose_execute,
+    .execute_inplace        = sdecomp_internal_transpose_execute_inplace,
+    .execute_batch          = sdecomp_internal_transpose_execute_batch,
+    .start                  = sdecomp_internal_transpose_start,
+    .test                   = sdecomp_internal_transpose_test,
+    .wait                   = sdecomp_internal_transpose_wait,
+    .destruct               = sdecomp_internal_transpose_destruct,
+    .export_wisdom          = sdecomp_internal_transpose_export_wisdom,
+    .import_wisdom          = sdecomp_internal_transpose_import_wisdom,
   },
 };
 
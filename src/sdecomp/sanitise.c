@@ -28,6 +28,7 @@
 
 #include <stdbool.h>
 #include <limits.h>
+#include <math.h> // isfinite
 #include "sdecomp.h"
 #define SDECOMP_INTERNAL
 #include "internal.h"
@@ -187,6 +188,168 @@ int sdecomp_internal_sanitise_size_of_element(
   return 1;
 }
 
+// check the given transpose engine is valid
+int sdecomp_internal_sanitise_engine(
+    const char error_label[],
+    const sdecomp_transpose_engine_t engine
+){
+  if(
+         SDECOMP_TRANSPOSE_ENGINE_ALLTOALLW    == engine
+      || SDECOMP_TRANSPOSE_ENGINE_ALLTOALLV    == engine
+      || SDECOMP_TRANSPOSE_ENGINE_PAIRWISE     == engine
+      || SDECOMP_TRANSPOSE_ENGINE_BRUCK        == engine
+      || SDECOMP_TRANSPOSE_ENGINE_SHM          == engine
+      || SDECOMP_TRANSPOSE_ENGINE_HIERARCHICAL == engine
+      || SDECOMP_TRANSPOSE_ENGINE_RMA          == engine
+      || SDECOMP_TRANSPOSE_ENGINE_NEIGHBOR     == engine
+  ) return 0;
+  SDECOMP_ERROR(
+      "invalid engine: %u\n",
+      error_label, engine
+  );
+  return 1;
+}
+
+// check the number of slabs of pipelined rotations
+int sdecomp_internal_sanitise_nslabs(
+    const char error_label[],
+    const size_t nslabs,
+    const bool persistent
+){
+  if(0 == nslabs){
+    SDECOMP_ERROR(
+        "nslabs should be positive\n",
+        error_label
+    );
+    return 1;
+  }
+  if(1 < nslabs && persistent){
+    SDECOMP_ERROR(
+        "pipelined rotation (nslabs = %zu) cannot be persistent\n",
+        error_label, nslabs
+    );
+    return 1;
+  }
+  return 0;
+}
+
+// engines packing chunks explicitly, which can narrow the elements
+bool sdecomp_internal_is_packing_engine(
+    const sdecomp_transpose_engine_t engine
+){
+  return
+       SDECOMP_TRANSPOSE_ENGINE_ALLTOALLV    == engine
+    || SDECOMP_TRANSPOSE_ENGINE_PAIRWISE     == engine
+    || SDECOMP_TRANSPOSE_ENGINE_BRUCK        == engine
+    || SDECOMP_TRANSPOSE_ENGINE_SHM          == engine
+    || SDECOMP_TRANSPOSE_ENGINE_HIERARCHICAL == engine;
+}
+
+// engines creating persistent requests
+bool sdecomp_internal_is_persistent_engine(
+    const sdecomp_transpose_engine_t engine
+){
+  return
+       SDECOMP_TRANSPOSE_ENGINE_ALLTOALLW == engine
+    || SDECOMP_TRANSPOSE_ENGINE_ALLTOALLV == engine
+    || SDECOMP_TRANSPOSE_ENGINE_RMA       == engine;
+}
+
+// engines exchanging slabs one after another
+bool sdecomp_internal_is_pipelined_engine(
+    const sdecomp_transpose_engine_t engine
+){
+  return
+       SDECOMP_TRANSPOSE_ENGINE_ALLTOALLW == engine
+    || SDECOMP_TRANSPOSE_ENGINE_ALLTOALLV == engine;
+}
+
+// check the persistent and pipelined rotations are implemented by the engine,
+//   which would be silently ignored otherwise
+int sdecomp_internal_sanitise_engine_features(
+    const char error_label[],
+    const sdecomp_transpose_engine_t engine,
+    const size_t nslabs,
+    const bool persistent
+){
+  if(persistent && !sdecomp_internal_is_persistent_engine(engine)){
+    SDECOMP_ERROR(
+        "persistent rotation needs ALLTOALLW, ALLTOALLV or RMA, given engine: %u\n",
+        error_label, engine
+    );
+    return 1;
+  }
+  if(1 < nslabs && !sdecomp_internal_is_pipelined_engine(engine)){
+    SDECOMP_ERROR(
+        "pipelined rotation (nslabs = %zu) needs ALLTOALLW or ALLTOALLV, given engine: %u\n",
+        error_label, nslabs, engine
+    );
+    return 1;
+  }
+  return 0;
+}
+
+// check the element type on the wire,
+//   which can be narrowed only for double and double complex
+//   by the engines packing chunks explicitly
+int sdecomp_internal_sanitise_wire(
+    const char error_label[],
+    const sdecomp_transpose_wire_t wire,
+    const sdecomp_transpose_engine_t engine,
+    const size_t size_of_element
+){
+  if(SDECOMP_TRANSPOSE_WIRE_NATIVE == wire) return 0;
+  if(SDECOMP_TRANSPOSE_WIRE_FP32 != wire && SDECOMP_TRANSPOSE_WIRE_BF16 != wire){
+    SDECOMP_ERROR(
+        "invalid wire format: %u\n",
+        error_label, wire
+    );
+    return 1;
+  }
+  if(sizeof(double) != size_of_element && 2 * sizeof(double) != size_of_element){
+    SDECOMP_ERROR(
+        "reduced-precision wire format needs double or double complex, given size_of_element: %zu\n",
+        error_label, size_of_element
+    );
+    return 1;
+  }
+  if(!sdecomp_internal_is_packing_engine(engine)){
+    SDECOMP_ERROR(
+        "reduced-precision wire format needs an engine packing chunks explicitly, given engine: %u\n",
+        error_label, engine
+    );
+    return 1;
+  }
+  return 0;
+}
+
+// check the compression of the chunks,
+//   which is implemented only for the non-persistent, non-pipelined all-to-allv
+int sdecomp_internal_sanitise_compress(
+    const char error_label[],
+    const bool compress,
+    const sdecomp_transpose_engine_t engine,
+    const size_t nslabs,
+    const bool persistent
+){
+  if(!compress) return 0;
+  if(SDECOMP_TRANSPOSE_ENGINE_ALLTOALLV != engine){
+    SDECOMP_ERROR(
+        "compression needs SDECOMP_TRANSPOSE_ENGINE_ALLTOALLV, given engine: %u\n",
+        error_label, engine
+    );
+    return 1;
+  }
+  if(1 < nslabs || persistent){
+    SDECOMP_ERROR(
+        "compression cannot be combined with pipelined or persistent rotations\n",
+        error_label
+    );
+    return 1;
+  }
+  return 0;
+}
+
 // check the given pencil pair is valid (2D)
 int sdecomp_internal_sanitise_pencil_pair_2d(
     const char error_label[],
@@ -236,3 +399,57 @@ int sdecomp_internal_sanitise_pencil_pair_3d(
   return 1;
 }
 
+// check the global sizes of the pencils before and after a rotation,
+//   which may differ only in the rotated directions
+int sdecomp_internal_sanitise_glsizes_pair(
+    const char error_label[],
+    const size_t ndims,
+    const sdecomp_pencil_t pencil_bef,
+    const sdecomp_pencil_t pencil_aft,
+    const size_t * glsizes_bef,
+    const size_t * glsizes_aft
+){
+  if(0 != sdecomp_internal_sanitise_pencil(error_label, ndims, pencil_bef)) return 1;
+  if(0 != sdecomp_internal_sanitise_pencil(error_label, ndims, pencil_aft)) return 1;
+  // contiguous directions of the pencils, i.e. rotated directions
+  //   x1, x2 -> 0, y1, y2 -> 1, z1, z2 -> 2
+  const size_t dim_bef = (size_t)pencil_bef % 3;
+  const size_t dim_aft = (size_t)pencil_aft % 3;
+  for(size_t dim = 0; dim < ndims; dim++){
+    if(glsizes_bef[dim] == glsizes_aft[dim]) continue;
+    if(dim_bef != dim && dim_aft != dim){
+      SDECOMP_ERROR(
+          "global sizes in the unchanged direction %zu should be the same, given: %zu and %zu\n",
+          error_label, dim, glsizes_bef[dim], glsizes_aft[dim]
+      );
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// check the weights of the non-uniform decomposition,
+//   which should be positive and finite
+int sdecomp_internal_sanitise_weights(
+    const char error_label[],
+    const size_t nweights,
+    const double * weights
+){
+  const int maxnweights = INT_MAX;
+  if(0 == nweights || (size_t)maxnweights <= nweights){
+    SDECOMP_ERROR(
+        "number of weights (%zu) should be positive and smaller than %d\n",
+        error_label, nweights, maxnweights
+    );
+    return 1;
+  }
+  for(size_t n = 0; n < nweights; n++){
+    if(isfinite(weights[n]) && 0. < weights[n]) continue;
+    SDECOMP_ERROR(
+        "weights[%zu] (%e) should be positive and finite\n",
+        error_label, n, weights[n]
+    );
+    return 1;
+  }
+  return 0;
+}
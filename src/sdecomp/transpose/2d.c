@@ -65,7 +65,8 @@ static int convert_glsizes_to_sizes(
  * @param[in]  info            : struct contains information of process distribution
  * @param[in]  pencil_bef      : type of pencil before being rotated
  * @param[in]  pencil_aft      : type of pencil after  being rotated
- * @param[in]  glsizes         : global array size in each dimension
+ * @param[in]  glsizes_bef     : global array size in each dimension, before rotated
+ * @param[in]  glsizes_aft     : global array size in each dimension, after  rotated
  * @param[in]  size_of_element : size of each element, e.g., sizeof(double)
  * @param[out] plan            : (success) a pointer to the created plan
  *                               (failure) undefined
@@ -77,22 +78,15 @@ int sdecomp_internal_transpose_init_2d(
     const sdecomp_info_t * info,
     const sdecomp_pencil_t pencil_bef,
     const sdecomp_pencil_t pencil_aft,
-    const size_t * glsizes,
+    const size_t * glsizes_bef,
+    const size_t * glsizes_aft,
     const size_t size_of_element,
     sdecomp_transpose_plan_t ** plan
 ){
   *plan = NULL;
   if(0 != sdecomp_internal_sanitise_pencil_pair_2d(error_label, pencil_bef, pencil_aft)) return 1;
-  // create 2d communicator,
-  //   in which comm_2d collective comm. will be called
-  // NOTE: since now the domain is 2D, this is identical to
-  //   the default Cartesian communicator comm_cart
-  //   (= sdecomp.get_comm_cart(info)).
-  // It is duplicated here to simplify the destruction process
-  const MPI_Comm comm_cart = info->comm_cart;
-  MPI_Comm comm_2d = MPI_COMM_NULL;
-  MPI_Comm_dup(comm_cart, &comm_2d);
   // number of total process and my position
+  const MPI_Comm comm_cart = info->comm_cart;
   int nprocs_2d = 0;
   int myrank_2d = 0;
   {
@@ -100,33 +94,68 @@ int sdecomp_internal_transpose_init_2d(
     int    dims[SDECOMP_INTERNAL_LOCAL_NDIMS] = {0};
     int periods[SDECOMP_INTERNAL_LOCAL_NDIMS] = {0};
     int  coords[SDECOMP_INTERNAL_LOCAL_NDIMS] = {0};
-    MPI_Cart_get(comm_2d, SDECOMP_INTERNAL_LOCAL_NDIMS, dims, periods, coords);
+    MPI_Cart_get(comm_cart, SDECOMP_INTERNAL_LOCAL_NDIMS, dims, periods, coords);
     // I am interested in the memory-sparse direction
-    // since comm_2d is defined in PHYSICAL (not memory) order,
+    // since comm_cart is defined in PHYSICAL (not memory) order,
     //   1: physical y direction is what I should extract here
     nprocs_2d =   dims[1];
     myrank_2d = coords[1];
 #undef SDECOMP_INTERNAL_LOCAL_NDIMS
   }
+  // create 2d communicator,
+  //   in which comm_2d collective comm. will be called
+  // NOTE: since now the domain is 2D, this contains the same processes as
+  //   the default Cartesian communicator comm_cart
+  //   (= sdecomp.get_comm_cart(info)).
+  // It is duplicated here to simplify the destruction process
+  // NOTE: topology is intentionally dropped (split instead of dup),
+  //   since some MPI libraries (e.g. Open MPI 4.1) use the number of
+  //   Cartesian neighbours instead of the communicator size
+  //   to count datatypes given to MPI_Ialltoallw
+  MPI_Comm comm_2d = MPI_COMM_NULL;
+  MPI_Comm_split(comm_cart, 0, myrank_2d, &comm_2d);
   // get number of grid points in all directions
   //   in memory order (NOT physical order x, y)
   // NOTE: should never fail as long as
   //   glsizes is sanitised at the entrypoint
-  size_t sizes[SDECOMP_INTERNAL_NDIMS] = {0};
-  if(0 != convert_glsizes_to_sizes(error_label, pencil_bef, glsizes, sizes)) return 1;
+  // NOTE: both are in the memory order of the pencil before rotated
+  size_t sizes_bef[SDECOMP_INTERNAL_NDIMS] = {0};
+  size_t sizes_aft[SDECOMP_INTERNAL_NDIMS] = {0};
+  if(0 != convert_glsizes_to_sizes(error_label, pencil_bef, glsizes_bef, sizes_bef)) return 1;
+  if(0 != convert_glsizes_to_sizes(error_label, pencil_bef, glsizes_aft, sizes_aft)) return 1;
+  // weights of the decomposition, also in the memory order
+  const sdecomp_internal_weights_t * weights[SDECOMP_INTERNAL_NDIMS] = {NULL};
+  for(size_t dim = 0; dim < SDECOMP_INTERNAL_NDIMS; dim++){
+    weights[dim] = info->weights + (pencil_bef + dim) % SDECOMP_INTERNAL_NDIMS;
+  }
   // check I can safely decompose the domain into chunks beforehand,
   //   i.e. local chunk sizes are positive (0 is not accepted)
+  //   the row direction is decomposed after rotated,
+  //   while the column direction is decomposed before rotated
   // I do it here for early return (before allocating buffers)
   for(int rank = 0; rank < nprocs_2d; rank++){
     size_t dummy = 0;
     if(
-           0 != sdecomp_internal_kernel_get_mysize(error_label, sizes[0], nprocs_2d, rank, &dummy)
-        || 0 != sdecomp_internal_kernel_get_mysize(error_label, sizes[1], nprocs_2d, rank, &dummy)
+           0 != sdecomp_internal_kernel_get_mysize(error_label, weights[0], sizes_aft[0], nprocs_2d, rank, &dummy)
+        || 0 != sdecomp_internal_kernel_get_mysize(error_label, weights[1], sizes_bef[1], nprocs_2d, rank, &dummy)
     ) return 1;
   }
+  // only the leading part common to both pencils is exchanged,
+  //   which is the whole domain unless the global sizes differ
+  const size_t common_isize = sizes_bef[0] < sizes_aft[0] ? sizes_bef[0] : sizes_aft[0];
+  const size_t common_jsize = sizes_bef[1] < sizes_aft[1] ? sizes_bef[1] : sizes_aft[1];
   // allocate plan and its members
-  if(0 != sdecomp_internal_transpose_allocate(error_label, nprocs_2d, plan)) return 1;
+  if(0 != sdecomp_internal_transpose_allocate(error_label, nprocs_2d, myrank_2d, plan)) return 1;
   (*plan)->comm_2d = comm_2d;
+  // my pencils
+  size_t my_isize = 0;
+  size_t my_jsize = 0;
+  size_t my_joffs = 0;
+  sdecomp_internal_kernel_get_mysize(error_label, weights[0], sizes_aft[0], nprocs_2d, myrank_2d, &my_isize);
+  sdecomp_internal_kernel_get_mysize(error_label, weights[1], sizes_bef[1], nprocs_2d, myrank_2d, &my_jsize);
+  sdecomp_internal_kernel_get_offset(error_label, weights[1], sizes_bef[1], nprocs_2d, myrank_2d, &my_joffs);
+  (*plan)->nitems_bef = sizes_bef[0] * my_jsize;
+  (*plan)->nitems_aft = sizes_aft[1] * my_isize;
   // consider communication between my (myrank_2d-th) and your (yrrank_2d-th) pencils
   // base datatype having contiguous size_of_elemerror_label, ent bytes
   // NOTE: no need to commit since this is not directly communicated
@@ -143,17 +172,18 @@ int sdecomp_internal_transpose_init_2d(
       MPI_Datatype * type = &(*plan)->stypes [yrrank_2d];
       size_t chunk_isize = 0;
       size_t chunk_ioffs = 0;
-      size_t chunk_jsize = 0;
-      sdecomp_internal_kernel_get_mysize(error_label, sizes[0], nprocs_2d, yrrank_2d, &chunk_isize);
-      sdecomp_internal_kernel_get_offset(error_label, sizes[0], nprocs_2d, yrrank_2d, &chunk_ioffs);
-      sdecomp_internal_kernel_get_mysize(error_label, sizes[1], nprocs_2d, myrank_2d, &chunk_jsize);
+      size_t chunk_jsize = my_jsize;
+      sdecomp_internal_kernel_get_mysize(error_label, weights[0], sizes_aft[0], nprocs_2d, yrrank_2d, &chunk_isize);
+      sdecomp_internal_kernel_get_offset(error_label, weights[0], sizes_aft[0], nprocs_2d, yrrank_2d, &chunk_ioffs);
+      sdecomp_internal_transpose_clip(common_isize, chunk_ioffs, &chunk_isize);
+      sdecomp_internal_transpose_clip(common_jsize,     my_joffs, &chunk_jsize);
       // define an intermediate data type,
       //   which is contiguous in the column direction
       //   and only has one element in the row direction
       MPI_Type_create_hvector(
           (int)(chunk_jsize),
           1,
-          (MPI_Aint)(size_of_element * sizes[0]),
+          (MPI_Aint)(size_of_element * sizes_bef[0]),
           basetype,
           type
       );
@@ -167,35 +197,76 @@ int sdecomp_internal_transpose_init_2d(
           *type,
           type
       );
-      MPI_Type_commit(type);
+      sdecomp_internal_transpose_shift_type(size_of_element * chunk_ioffs, type);
       *count = 1;
-      *displ = (int)(size_of_element * chunk_ioffs);
+      *displ = 0;
+      // the same chunk for the explicit packing
+      sdecomp_internal_transpose_chunk_t * chunk = &(*plan)->schunks[yrrank_2d];
+      chunk->nbatch       = 1;
+      chunk->ni           = chunk_isize;
+      chunk->nj           = chunk_jsize;
+      chunk->offset       = chunk_ioffs;
+      chunk->stride_batch = 0;
+      chunk->stride       = sizes_bef[0];
     }
     // recv
     {
       int * count         = &(*plan)->rcounts[yrrank_2d];
       int * displ         = &(*plan)->rdispls[yrrank_2d];
       MPI_Datatype * type = &(*plan)->rtypes [yrrank_2d];
-      size_t chunk_isize = 0;
+      size_t chunk_isize = my_isize;
+      size_t chunk_ioffs = 0;
       size_t chunk_jsize = 0;
       size_t chunk_joffs = 0;
-      sdecomp_internal_kernel_get_mysize(error_label, sizes[0], nprocs_2d, myrank_2d, &chunk_isize);
-      sdecomp_internal_kernel_get_mysize(error_label, sizes[1], nprocs_2d, yrrank_2d, &chunk_jsize);
-      sdecomp_internal_kernel_get_offset(error_label, sizes[1], nprocs_2d, yrrank_2d, &chunk_joffs);
+      sdecomp_internal_kernel_get_offset(error_label, weights[0], sizes_aft[0], nprocs_2d, myrank_2d, &chunk_ioffs);
+      sdecomp_internal_kernel_get_mysize(error_label, weights[1], sizes_bef[1], nprocs_2d, yrrank_2d, &chunk_jsize);
+      sdecomp_internal_kernel_get_offset(error_label, weights[1], sizes_bef[1], nprocs_2d, yrrank_2d, &chunk_joffs);
+      sdecomp_internal_transpose_clip(common_isize, chunk_ioffs, &chunk_isize);
+      sdecomp_internal_transpose_clip(common_jsize, chunk_joffs, &chunk_jsize);
       // define a recv data type,
       //   which is to unpack the buffer
       MPI_Type_create_hvector(
           (int)(chunk_isize),
           (int)(chunk_jsize),
-          (MPI_Aint)(size_of_element * sizes[1]),
+          (MPI_Aint)(size_of_element * sizes_aft[1]),
           basetype,
           type
       );
-      MPI_Type_commit(type);
+      sdecomp_internal_transpose_shift_type(size_of_element * chunk_joffs, type);
       *count = 1;
-      *displ = (int)(size_of_element * chunk_joffs);
+      *displ = 0;
+      // the same chunk for the explicit unpacking
+      sdecomp_internal_transpose_chunk_t * chunk = &(*plan)->rchunks[yrrank_2d];
+      chunk->nbatch       = 1;
+      chunk->ni           = chunk_isize;
+      chunk->nj           = chunk_jsize;
+      chunk->offset       = chunk_joffs;
+      chunk->stride_batch = 0;
+      chunk->stride       = sizes_aft[1];
     }
   }
+  // padding of my pencil after rotated, which no one sends
+  //   0: rows beyond the column size of the pencil before rotated
+  //   1: columns beyond the row size of the pencil before rotated
+  {
+    size_t my_ioffs = 0;
+    size_t common_my_isize = my_isize;
+    sdecomp_internal_kernel_get_offset(error_label, weights[0], sizes_aft[0], nprocs_2d, myrank_2d, &my_ioffs);
+    sdecomp_internal_transpose_clip(common_isize, my_ioffs, &common_my_isize);
+    sdecomp_internal_transpose_chunk_t * pads = (*plan)->pads;
+    pads[0].nbatch       = 1;
+    pads[0].ni           = common_my_isize;
+    pads[0].nj           = sizes_aft[1] - common_jsize;
+    pads[0].offset       = common_jsize;
+    pads[0].stride_batch = 0;
+    pads[0].stride       = sizes_aft[1];
+    pads[1].nbatch       = 1;
+    pads[1].ni           = my_isize - common_my_isize;
+    pads[1].nj           = sizes_aft[1];
+    pads[1].offset       = sizes_aft[1] * common_my_isize;
+    pads[1].stride_batch = 0;
+    pads[1].stride       = sizes_aft[1];
+  }
   return 0;
 }
 
@@ -116,7 +116,8 @@ static int get_unchanged_dim(
  * @param[in]  info            : struct contains information of process distribution
  * @param[in]  pencil_bef      : type of pencil before being rotated
  * @param[in]  pencil_aft      : type of pencil after  being rotated
- * @param[in]  glsizes         : global array size in each dimension
+ * @param[in]  glsizes_bef     : global array size in each dimension, before rotated
+ * @param[in]  glsizes_aft     : global array size in each dimension, after  rotated
  * @param[in]  size_of_element : size of each element, e.g., sizeof(double)
  * @param[out] plan            : (success) a pointer to the created plan
  *                               (failure) undefined
@@ -128,7 +129,8 @@ int sdecomp_internal_transpose_init_3d(
     const sdecomp_info_t * info,
     const sdecomp_pencil_t pencil_bef,
     const sdecomp_pencil_t pencil_aft,
-    const size_t * glsizes,
+    const size_t * glsizes_bef,
+    const size_t * glsizes_aft,
     const size_t size_of_element,
     sdecomp_transpose_plan_t ** plan
 ){
@@ -149,6 +151,14 @@ int sdecomp_internal_transpose_init_3d(
     int remain_dims[SDECOMP_INTERNAL_NDIMS] = {1, 1, 1};
     remain_dims[unchanged_dim] = 0;
     MPI_Cart_sub(info->comm_cart, remain_dims, &comm_2d);
+    // topology is dropped (see the corresponding note in 2d.c)
+    {
+      MPI_Comm comm_sub = comm_2d;
+      int myrank_sub = 0;
+      MPI_Comm_rank(comm_sub, &myrank_sub);
+      MPI_Comm_split(comm_sub, 0, myrank_sub, &comm_2d);
+      MPI_Comm_free(&comm_sub);
+    }
     // consider the remained unaffected dimension
     int    dims[SDECOMP_INTERNAL_NDIMS] = {0};
     int periods[SDECOMP_INTERNAL_NDIMS] = {0};
@@ -158,39 +168,60 @@ int sdecomp_internal_transpose_init_3d(
     myrank_1d = coords[unchanged_dim];
   }
   // compute number of processes and my position in comm_2d
+  // NOTE: comm_2d consists of the undecomposed x and the other direction,
+  //   and thus its size and my rank are those in the latter
   int nprocs_2d = 0;
   int myrank_2d = 0;
-  {
-#define SDECOMP_INTERNAL_LOCAL_NDIMS 2 // 2d communicator
-    int    dims[SDECOMP_INTERNAL_LOCAL_NDIMS] = {0};
-    int periods[SDECOMP_INTERNAL_LOCAL_NDIMS] = {0};
-    int  coords[SDECOMP_INTERNAL_LOCAL_NDIMS] = {0};
-    MPI_Cart_get(comm_2d, SDECOMP_INTERNAL_LOCAL_NDIMS, dims, periods, coords);
-    nprocs_2d =   dims[1];
-    myrank_2d = coords[1];
-#undef SDECOMP_INTERNAL_LOCAL_NDIMS
-  }
+  MPI_Comm_size(comm_2d, &nprocs_2d);
+  MPI_Comm_rank(comm_2d, &myrank_2d);
   // get number of grid points in all directions
   //   in memory order (NOT physical order x, y, z)
   // NOTE: should never fail as long as
   //   glsizes is sanitised at the entrypoint
-  size_t sizes[SDECOMP_INTERNAL_NDIMS] = {0};
-  if(0 != convert_glsizes_to_sizes(error_label, pencil_bef, glsizes, sizes)) return 1;
+  // NOTE: both are in the memory order of the pencil before rotated
+  size_t sizes_bef[SDECOMP_INTERNAL_NDIMS] = {0};
+  size_t sizes_aft[SDECOMP_INTERNAL_NDIMS] = {0};
+  if(0 != convert_glsizes_to_sizes(error_label, pencil_bef, glsizes_bef, sizes_bef)) return 1;
+  if(0 != convert_glsizes_to_sizes(error_label, pencil_bef, glsizes_aft, sizes_aft)) return 1;
+  // weights of the decomposition, also in the memory order
+  const sdecomp_internal_weights_t * weights[SDECOMP_INTERNAL_NDIMS] = {NULL};
+  for(size_t dim = 0; dim < SDECOMP_INTERNAL_NDIMS; dim++){
+    weights[dim] = info->weights + (pencil_bef % SDECOMP_INTERNAL_NDIMS + dim) % SDECOMP_INTERNAL_NDIMS;
+  }
+  // rotated directions: dim0 is decomposed after rotated,
+  //   while dim1 is decomposed before rotated
+  const size_t dim0 = 0;
+  const size_t dim1 = is_forward ? 1 : 2;
   // check I can safely decompose the domain into chunks,
   //   i.e. local chunk sizes are positive (0 is not accepted)
   // I do it here for early return (before allocating buffers)
   for(int rank = 0; rank < nprocs_2d; rank++){
-    const size_t dim0 = 0;
-    const size_t dim1 = is_forward ? 1 : 2;
     size_t dummy = 0;
     if(
-           0 != sdecomp_internal_kernel_get_mysize(error_label, sizes[dim0], nprocs_2d, rank, &dummy)
-        || 0 != sdecomp_internal_kernel_get_mysize(error_label, sizes[dim1], nprocs_2d, rank, &dummy)
+           0 != sdecomp_internal_kernel_get_mysize(error_label, weights[dim0], sizes_aft[dim0], nprocs_2d, rank, &dummy)
+        || 0 != sdecomp_internal_kernel_get_mysize(error_label, weights[dim1], sizes_bef[dim1], nprocs_2d, rank, &dummy)
     ) return 1;
   }
+  // only the leading part common to both pencils is exchanged,
+  //   which is the whole domain unless the global sizes differ
+  const size_t common_sizes[SDECOMP_INTERNAL_NDIMS] = {
+    sizes_bef[0] < sizes_aft[0] ? sizes_bef[0] : sizes_aft[0],
+    sizes_bef[1] < sizes_aft[1] ? sizes_bef[1] : sizes_aft[1],
+    sizes_bef[2] < sizes_aft[2] ? sizes_bef[2] : sizes_aft[2],
+  };
   // allocate plan and its members
-  if(0 != sdecomp_internal_transpose_allocate(error_label, nprocs_2d, plan)) return 1;
+  if(0 != sdecomp_internal_transpose_allocate(error_label, nprocs_2d, myrank_2d, plan)) return 1;
   (*plan)->comm_2d = comm_2d;
+  // my pencils, whose sizes in the unchanged direction are not affected
+  const size_t dim2 = is_forward ? 2 : 1;
+  size_t my_sizes[SDECOMP_INTERNAL_NDIMS] = {0};
+  size_t my_offs1 = 0;
+  sdecomp_internal_kernel_get_mysize(error_label, weights[dim0], sizes_aft[dim0], nprocs_2d, myrank_2d, &my_sizes[dim0]);
+  sdecomp_internal_kernel_get_mysize(error_label, weights[dim1], sizes_bef[dim1], nprocs_2d, myrank_2d, &my_sizes[dim1]);
+  sdecomp_internal_kernel_get_offset(error_label, weights[dim1], sizes_bef[dim1], nprocs_2d, myrank_2d, &my_offs1);
+  sdecomp_internal_kernel_get_mysize(error_label, weights[dim2], sizes_bef[dim2], nprocs_1d, myrank_1d, &my_sizes[dim2]);
+  (*plan)->nitems_bef = sizes_bef[dim0] * my_sizes[dim1] * my_sizes[dim2];
+  (*plan)->nitems_aft = sizes_aft[dim1] * my_sizes[dim0] * my_sizes[dim2];
   // consider communication between my (myrank_2d-th) and your (yrrank_2d-th) pencils
   // base datatype having contiguous size_of_element bytes
   // NOTE: no need to commit since this is not directly communicated
@@ -207,20 +238,29 @@ int sdecomp_internal_transpose_init_3d(
       MPI_Datatype * type = &(*plan)->stypes [yrrank_2d];
       size_t chunk_isize = 0;
       size_t chunk_ioffs = 0;
-      size_t chunk_jsize = 0;
-      size_t chunk_ksize = 0;
+      sdecomp_internal_kernel_get_mysize(error_label, weights[0], sizes_aft[0], nprocs_2d, yrrank_2d, &chunk_isize);
+      sdecomp_internal_kernel_get_offset(error_label, weights[0], sizes_aft[0], nprocs_2d, yrrank_2d, &chunk_ioffs);
+      sdecomp_internal_transpose_clip(common_sizes[0], chunk_ioffs, &chunk_isize);
       if(is_forward){
-        sdecomp_internal_kernel_get_mysize(error_label, sizes[0], nprocs_2d, yrrank_2d, &chunk_isize);
-        sdecomp_internal_kernel_get_offset(error_label, sizes[0], nprocs_2d, yrrank_2d, &chunk_ioffs);
-        sdecomp_internal_kernel_get_mysize(error_label, sizes[1], nprocs_2d, myrank_2d, &chunk_jsize);
-        sdecomp_internal_kernel_get_mysize(error_label, sizes[2], nprocs_1d, myrank_1d, &chunk_ksize);
+        size_t chunk_jsize = my_sizes[1];
+        size_t chunk_ksize = my_sizes[2];
+        sdecomp_internal_transpose_clip(common_sizes[1], my_offs1, &chunk_jsize);
+        // NOTE: j and k are nested rather than fused into a single count,
+        //       whose product may exceed the range of int
         MPI_Type_create_hvector(
-            (int)(chunk_jsize * chunk_ksize),
+            (int)(chunk_jsize),
             1,
-            (MPI_Aint)(size_of_element * sizes[0]),
+            (MPI_Aint)(size_of_element * sizes_bef[0]),
             basetype,
             type
         );
+        MPI_Type_create_hvector(
+            (int)(chunk_ksize),
+            1,
+            (MPI_Aint)(size_of_element * sizes_bef[0] * my_sizes[1]),
+            *type,
+            type
+        );
         MPI_Type_create_hvector(
             (int)(chunk_isize),
             1,
@@ -228,15 +268,23 @@ int sdecomp_internal_transpose_init_3d(
             *type,
             type
         );
+        // the same chunk for the explicit packing,
+        //   batched in the unchanged direction
+        sdecomp_internal_transpose_chunk_t * chunk = &(*plan)->schunks[yrrank_2d];
+        chunk->nbatch       = chunk_ksize;
+        chunk->ni           = chunk_isize;
+        chunk->nj           = chunk_jsize;
+        chunk->offset       = chunk_ioffs;
+        chunk->stride_batch = sizes_bef[0] * my_sizes[1];
+        chunk->stride       = sizes_bef[0];
       }else{
-        sdecomp_internal_kernel_get_mysize(error_label, sizes[0], nprocs_2d, yrrank_2d, &chunk_isize);
-        sdecomp_internal_kernel_get_offset(error_label, sizes[0], nprocs_2d, yrrank_2d, &chunk_ioffs);
-        sdecomp_internal_kernel_get_mysize(error_label, sizes[1], nprocs_1d, myrank_1d, &chunk_jsize);
-        sdecomp_internal_kernel_get_mysize(error_label, sizes[2], nprocs_2d, myrank_2d, &chunk_ksize);
+        size_t chunk_jsize = my_sizes[1];
+        size_t chunk_ksize = my_sizes[2];
+        sdecomp_internal_transpose_clip(common_sizes[2], my_offs1, &chunk_ksize);
         MPI_Type_create_hvector(
             (int)(chunk_ksize),
             1,
-            (MPI_Aint)(size_of_element * sizes[0] * chunk_jsize),
+            (MPI_Aint)(size_of_element * sizes_bef[0] * chunk_jsize),
             basetype,
             type
         );
@@ -250,61 +298,125 @@ int sdecomp_internal_transpose_init_3d(
         MPI_Type_create_hvector(
             (int)(chunk_jsize),
             1,
-            (MPI_Aint)(size_of_element * sizes[0]),
+            (MPI_Aint)(size_of_element * sizes_bef[0]),
             *type,
             type
         );
+        // the same chunk for the explicit packing,
+        //   batched in the unchanged direction
+        sdecomp_internal_transpose_chunk_t * chunk = &(*plan)->schunks[yrrank_2d];
+        chunk->nbatch       = chunk_jsize;
+        chunk->ni           = chunk_isize;
+        chunk->nj           = chunk_ksize;
+        chunk->offset       = chunk_ioffs;
+        chunk->stride_batch = sizes_bef[0];
+        chunk->stride       = sizes_bef[0] * chunk_jsize;
       }
-      MPI_Type_commit(type);
+      sdecomp_internal_transpose_shift_type(size_of_element * chunk_ioffs, type);
       *count = 1;
-      *displ = (int)(size_of_element * chunk_ioffs);
+      *displ = 0;
     }
     // recv
     {
       int * count         = &(*plan)->rcounts[yrrank_2d];
       int * displ         = &(*plan)->rdispls[yrrank_2d];
       MPI_Datatype * type = &(*plan)->rtypes [yrrank_2d];
+      size_t chunk_isize = my_sizes[0];
+      size_t chunk_ioffs = 0;
+      sdecomp_internal_kernel_get_offset(error_label, weights[0], sizes_aft[0], nprocs_2d, myrank_2d, &chunk_ioffs);
+      sdecomp_internal_transpose_clip(common_sizes[0], chunk_ioffs, &chunk_isize);
       if(is_forward){
-        size_t chunk_isize = 0;
         size_t chunk_jsize = 0;
         size_t chunk_joffs = 0;
-        size_t chunk_ksize = 0;
-        sdecomp_internal_kernel_get_mysize(error_label, sizes[0], nprocs_2d, myrank_2d, &chunk_isize);
-        sdecomp_internal_kernel_get_mysize(error_label, sizes[1], nprocs_2d, yrrank_2d, &chunk_jsize);
-        sdecomp_internal_kernel_get_offset(error_label, sizes[1], nprocs_2d, yrrank_2d, &chunk_joffs);
-        sdecomp_internal_kernel_get_mysize(error_label, sizes[2], nprocs_1d, myrank_1d, &chunk_ksize);
+        size_t chunk_ksize = my_sizes[2];
+        sdecomp_internal_kernel_get_mysize(error_label, weights[1], sizes_bef[1], nprocs_2d, yrrank_2d, &chunk_jsize);
+        sdecomp_internal_kernel_get_offset(error_label, weights[1], sizes_bef[1], nprocs_2d, yrrank_2d, &chunk_joffs);
+        sdecomp_internal_transpose_clip(common_sizes[1], chunk_joffs, &chunk_jsize);
         MPI_Type_create_hvector(
-            (int)(chunk_ksize * chunk_isize),
+            (int)(chunk_ksize),
             (int)(chunk_jsize),
-            (MPI_Aint)(size_of_element * sizes[1]),
+            (MPI_Aint)(size_of_element * sizes_aft[1]),
             basetype,
             type
         );
-        MPI_Type_commit(type);
+        MPI_Type_create_hvector(
+            (int)(chunk_isize),
+            1,
+            (MPI_Aint)(size_of_element * sizes_aft[1] * chunk_ksize),
+            *type,
+            type
+        );
+        sdecomp_internal_transpose_shift_type(size_of_element * chunk_joffs, type);
         *count = 1;
-        *displ = (int)(size_of_element * chunk_joffs);
+        *displ = 0;
+        // the same chunk for the explicit unpacking
+        sdecomp_internal_transpose_chunk_t * chunk = &(*plan)->rchunks[yrrank_2d];
+        chunk->nbatch       = chunk_ksize;
+        chunk->ni           = chunk_isize;
+        chunk->nj           = chunk_jsize;
+        chunk->offset       = chunk_joffs;
+        chunk->stride_batch = sizes_aft[1];
+        chunk->stride       = sizes_aft[1] * chunk_ksize;
       }else{
-        size_t chunk_isize = 0;
-        size_t chunk_jsize = 0;
+        size_t chunk_jsize = my_sizes[1];
         size_t chunk_ksize = 0;
         size_t chunk_koffs = 0;
-        sdecomp_internal_kernel_get_mysize(error_label, sizes[0], nprocs_2d, myrank_2d, &chunk_isize);
-        sdecomp_internal_kernel_get_mysize(error_label, sizes[1], nprocs_1d, myrank_1d, &chunk_jsize);
-        sdecomp_internal_kernel_get_mysize(error_label, sizes[2], nprocs_2d, yrrank_2d, &chunk_ksize);
-        sdecomp_internal_kernel_get_offset(error_label, sizes[2], nprocs_2d, yrrank_2d, &chunk_koffs);
+        sdecomp_internal_kernel_get_mysize(error_label, weights[2], sizes_bef[2], nprocs_2d, yrrank_2d, &chunk_ksize);
+        sdecomp_internal_kernel_get_offset(error_label, weights[2], sizes_bef[2], nprocs_2d, yrrank_2d, &chunk_koffs);
+        sdecomp_internal_transpose_clip(common_sizes[2], chunk_koffs, &chunk_ksize);
         MPI_Type_create_hvector(
-            (int)(chunk_isize * chunk_jsize),
+            (int)(chunk_isize),
             (int)(chunk_ksize),
-            (MPI_Aint)(size_of_element * sizes[2]),
+            (MPI_Aint)(size_of_element * sizes_aft[2]),
             basetype,
             type
         );
-        MPI_Type_commit(type);
+        MPI_Type_create_hvector(
+            (int)(chunk_jsize),
+            1,
+            (MPI_Aint)(size_of_element * sizes_aft[2] * my_sizes[0]),
+            *type,
+            type
+        );
+        sdecomp_internal_transpose_shift_type(size_of_element * chunk_koffs, type);
         *count = 1;
-        *displ = (int)(size_of_element * chunk_koffs);
+        *displ = 0;
+        // the same chunk for the explicit unpacking
+        sdecomp_internal_transpose_chunk_t * chunk = &(*plan)->rchunks[yrrank_2d];
+        chunk->nbatch       = chunk_jsize;
+        chunk->ni           = chunk_isize;
+        chunk->nj           = chunk_ksize;
+        chunk->offset       = chunk_koffs;
+        chunk->stride_batch = sizes_aft[2] * my_sizes[0];
+        chunk->stride       = sizes_aft[2];
       }
     }
   }
+  // padding of my pencil after rotated, which no one sends,
+  //   described in the same manner as the recv chunks
+  //   0: beyond the size of the pencil before rotated in its decomposed direction (dim1)
+  //   1: beyond the size of the pencil before rotated in its contiguous direction (dim0)
+  {
+    size_t my_ioffs = 0;
+    size_t common_my_isize = my_sizes[0];
+    sdecomp_internal_kernel_get_offset(error_label, weights[0], sizes_aft[0], nprocs_2d, myrank_2d, &my_ioffs);
+    sdecomp_internal_transpose_clip(common_sizes[0], my_ioffs, &common_my_isize);
+    const size_t stride_batch = is_forward ? sizes_aft[1] : sizes_aft[2] * my_sizes[0];
+    const size_t stride       = is_forward ? sizes_aft[1] * my_sizes[2] : sizes_aft[2];
+    sdecomp_internal_transpose_chunk_t * pads = (*plan)->pads;
+    pads[0].nbatch       = my_sizes[dim2];
+    pads[0].ni           = common_my_isize;
+    pads[0].nj           = sizes_aft[dim1] - common_sizes[dim1];
+    pads[0].offset       = common_sizes[dim1];
+    pads[0].stride_batch = stride_batch;
+    pads[0].stride       = stride;
+    pads[1].nbatch       = my_sizes[dim2];
+    pads[1].ni           = my_sizes[0] - common_my_isize;
+    pads[1].nj           = sizes_aft[dim1];
+    pads[1].offset       = stride * common_my_isize;
+    pads[1].stride_batch = stride_batch;
+    pads[1].stride       = stride;
+  }
   return 0;
 }
 
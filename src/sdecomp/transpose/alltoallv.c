@@ -0,0 +1,340 @@
+/*
+ * Copyright 2022 Naoki Hori
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// https://github.com/NaokiHori/SimpleDecomp
+
+// engine packing chunks explicitly into contiguous buffers,
+//   which are exchanged by MPI_Alltoallv and unpacked afterwards
+
+#include <stdbool.h>
+#include <mpi.h>
+#include "sdecomp.h"
+#define SDECOMP_INTERNAL
+#include "../internal.h"
+#define SDECOMP_INTERNAL_TRANSPOSE
+#include "internal.h"
+
+// counts and displacements of each slab for pipelined rotations,
+//   which are parts of the chunks since the batches are the slowest in the packed form
+// NOTE: each slab is packed from the beginning of one of the two halves
+//   of the slab buffers, i.e. the packed buffers of the whole pencils are not needed
+static int init_slabs(
+    const char error_label[],
+    sdecomp_transpose_plan_t * plan
+){
+  const size_t nslabs = plan->nslabs;
+  const int nprocs = plan->nprocs_2d;
+  const size_t nitems = nslabs * (size_t)nprocs;
+  plan->slab_scounts  = sdecomp_internal_calloc(error_label, nitems, sizeof(        int));
+  plan->slab_rcounts  = sdecomp_internal_calloc(error_label, nitems, sizeof(        int));
+  plan->slab_sdispls  = sdecomp_internal_calloc(error_label, nitems, sizeof(        int));
+  plan->slab_rdispls  = sdecomp_internal_calloc(error_label, nitems, sizeof(        int));
+  plan->slab_requests = sdecomp_internal_calloc(error_label, nslabs, sizeof(MPI_Request));
+  if(NULL == plan->slab_scounts ) return 1;
+  if(NULL == plan->slab_rcounts ) return 1;
+  if(NULL == plan->slab_sdispls ) return 1;
+  if(NULL == plan->slab_rdispls ) return 1;
+  if(NULL == plan->slab_requests) return 1;
+  plan->slab_ssize = 0;
+  plan->slab_rsize = 0;
+  for(size_t s = 0; s < nslabs; s++){
+    size_t b0 = 0;
+    size_t nb = 0;
+    sdecomp_internal_transpose_get_slab(plan, s, &b0, &nb);
+    size_t ssize = 0;
+    size_t rsize = 0;
+    for(int n = 0; n < nprocs; n++){
+      // NOTE: no overflow, since they are smaller than the whole chunks
+      //   whose counts are checked by sdecomp_internal_transpose_packed_init
+      const size_t index = s * (size_t)nprocs + (size_t)n;
+      const sdecomp_internal_transpose_chunk_t * schunk = plan->schunks + n;
+      const sdecomp_internal_transpose_chunk_t * rchunk = plan->rchunks + n;
+      const size_t scount = 0 == plan->packed_scounts[n] ? 0 : nb * schunk->ni * schunk->nj;
+      const size_t rcount = 0 == plan->packed_rcounts[n] ? 0 : nb * rchunk->ni * rchunk->nj;
+      plan->slab_scounts[index] = (int)scount;
+      plan->slab_rcounts[index] = (int)rcount;
+      plan->slab_sdispls[index] = (int)ssize;
+      plan->slab_rdispls[index] = (int)rsize;
+      ssize += scount;
+      rsize += rcount;
+    }
+    plan->slab_ssize = plan->slab_ssize < ssize ? ssize : plan->slab_ssize;
+    plan->slab_rsize = plan->slab_rsize < rsize ? rsize : plan->slab_rsize;
+  }
+  // double-buffered: a slab is packed while the previous one is exchanged
+  const size_t size_of_element = plan->packed_size_of_element;
+  plan->slab_sendbuf = sdecomp_internal_calloc(error_label, 2 * plan->slab_ssize, size_of_element);
+  plan->slab_recvbuf = sdecomp_internal_calloc(error_label, 2 * plan->slab_rsize, size_of_element);
+  if(NULL == plan->slab_sendbuf) return 1;
+  if(NULL == plan->slab_recvbuf) return 1;
+  return 0;
+}
+
+// persistent collective is bound to the packed buffers owned by the plan,
+//   and thus it does not depend on the buffers given by the user
+static int init(
+    const char error_label[],
+    const sdecomp_transpose_options_t * options,
+    sdecomp_transpose_plan_t * plan
+){
+  plan->is_persistent = false;
+  plan->persistent_request = MPI_REQUEST_NULL;
+  if(0 != sdecomp_internal_transpose_packed_init(error_label, plan)) return 1;
+  if(1 < plan->nslabs){
+    if(0 != init_slabs(error_label, plan)) return 1;
+  }
+  if(!options->persistent) return 0;
+  if(0 != sdecomp_internal_transpose_alltoallv_init(
+      plan->packed_sendbuf, plan->packed_scounts, plan->packed_sdispls,
+      plan->packed_recvbuf, plan->packed_rcounts, plan->packed_rdispls,
+      plan->elemtype,
+      plan->comm_2d,
+      &plan->persistent_request,
+      &plan->is_persistent
+  )) return 1;
+  return 0;
+}
+
+static int start(
+    const char error_label[],
+    sdecomp_transpose_plan_t * plan,
+    const void * sendbuf,
+    void * recvbuf,
+    sdecomp_transpose_request_t * request
+){
+  // NOTE: the compressed sizes should be known before the chunks are exchanged,
+  //   so that the rotation does not overlap with the caller
+  if(plan->compress){
+    if(0 != sdecomp_internal_transpose_packed_execute(error_label, plan, 1, &sendbuf, &recvbuf, sdecomp_internal_transpose_compressed_exchange)) return 1;
+    request->is_completed = true;
+    return 0;
+  }
+  if(0 != sdecomp_internal_transpose_packed_acquire(error_label, plan, request)) return 1;
+  sdecomp_internal_transpose_packed_pack(plan, 0, plan->schunks[0].nbatch, 1, &sendbuf, plan->packed_sdispls, request->packed_sendbuf);
+  if(plan->is_persistent && request->is_workspace_borrowed){
+    // NOTE: the persistent request is kept by the plan
+    request->handle = &plan->persistent_request;
+    MPI_Start(request->handle);
+  }else{
+    request->handle = &request->request;
+    MPI_Ialltoallv(
+        request->packed_sendbuf, plan->packed_scounts, plan->packed_sdispls, plan->elemtype,
+        request->packed_recvbuf, plan->packed_rcounts, plan->packed_rdispls, plan->elemtype,
+        plan->comm_2d,
+        request->handle
+    );
+  }
+  // my own chunk is processed while the others are on the fly
+  sdecomp_internal_transpose_copy_self(plan, sendbuf, recvbuf);
+  return 0;
+}
+
+static int complete(
+    sdecomp_transpose_request_t * request
+){
+  sdecomp_transpose_plan_t * plan = request->plan;
+  sdecomp_internal_transpose_packed_unpack(plan, 0, plan->rchunks[0].nbatch, 1, request->packed_recvbuf, plan->packed_rdispls, &request->recvbuf);
+  sdecomp_internal_transpose_packed_release(plan, request);
+  request->is_completed = true;
+  return 0;
+}
+
+static int test(
+    sdecomp_transpose_request_t * request,
+    bool * flag
+){
+  int flag_ = 0;
+  MPI_Test(request->handle, &flag_, MPI_STATUS_IGNORE);
+  if(0 != flag_){
+    complete(request);
+  }
+  *flag = request->is_completed;
+  return 0;
+}
+
+static int wait(
+    sdecomp_transpose_request_t * request
+){
+  MPI_Wait(request->handle, MPI_STATUS_IGNORE);
+  complete(request);
+  return 0;
+}
+
+// the halves of the slab buffers used by the s-th slab
+static void get_slab_buffers(
+    const sdecomp_transpose_plan_t * plan,
+    const size_t s,
+    void ** sendbuf,
+    void ** recvbuf
+){
+  const size_t size_of_element = plan->packed_size_of_element;
+  *sendbuf = (char *)plan->slab_sendbuf + size_of_element * (s % 2) * plan->slab_ssize;
+  *recvbuf = (char *)plan->slab_recvbuf + size_of_element * (s % 2) * plan->slab_rsize;
+}
+
+// slabs are exchanged one after another, and at most two of them are on the fly,
+//   i.e. packing (unpacking) a slab is overlapped with the exchange of the previous one
+// NOTE: the s-th slab uses the (s % 2)-th halves of the slab buffers,
+//   which are free since the (s - 2)-th slab has been unpacked
+static int execute_pipelined(
+    sdecomp_transpose_plan_t * plan,
+    const void * sendbuf,
+    void * recvbuf
+){
+  const size_t nslabs = plan->nslabs;
+  const size_t nprocs = (size_t)plan->nprocs_2d;
+  MPI_Request * requests = plan->slab_requests;
+  for(size_t s = 0; s < nslabs; s++){
+    size_t b0 = 0;
+    size_t nb = 0;
+    void * packed_sendbuf = NULL;
+    void * packed_recvbuf = NULL;
+    sdecomp_internal_transpose_get_slab(plan, s, &b0, &nb);
+    get_slab_buffers(plan, s, &packed_sendbuf, &packed_recvbuf);
+    sdecomp_internal_transpose_packed_pack(plan, b0, nb, 1, &sendbuf, plan->slab_sdispls + s * nprocs, packed_sendbuf);
+    MPI_Ialltoallv(
+        packed_sendbuf, plan->slab_scounts + s * nprocs, plan->slab_sdispls + s * nprocs, plan->elemtype,
+        packed_recvbuf, plan->slab_rcounts + s * nprocs, plan->slab_rdispls + s * nprocs, plan->elemtype,
+        plan->comm_2d,
+        requests + s
+    );
+    if(0 == s){
+      sdecomp_internal_transpose_copy_self(plan, sendbuf, recvbuf);
+    }else{
+      MPI_Wait(requests + s - 1, MPI_STATUS_IGNORE);
+      sdecomp_internal_transpose_get_slab(plan, s - 1, &b0, &nb);
+      get_slab_buffers(plan, s - 1, &packed_sendbuf, &packed_recvbuf);
+      sdecomp_internal_transpose_packed_unpack(plan, b0, nb, 1, packed_recvbuf, plan->slab_rdispls + (s - 1) * nprocs, &recvbuf);
+    }
+  }
+  {
+    size_t b0 = 0;
+    size_t nb = 0;
+    void * packed_sendbuf = NULL;
+    void * packed_recvbuf = NULL;
+    MPI_Wait(requests + nslabs - 1, MPI_STATUS_IGNORE);
+    sdecomp_internal_transpose_get_slab(plan, nslabs - 1, &b0, &nb);
+    get_slab_buffers(plan, nslabs - 1, &packed_sendbuf, &packed_recvbuf);
+    sdecomp_internal_transpose_packed_unpack(plan, b0, nb, 1, packed_recvbuf, plan->slab_rdispls + (nslabs - 1) * nprocs, &recvbuf);
+  }
+  return 0;
+}
+
+// blocking version is a combination of the non-blocking runners
+static int execute(
+    sdecomp_transpose_plan_t * plan,
+    const void * sendbuf,
+    void * recvbuf
+){
+  const char error_label[] = {"sdecomp.transpose.execute"};
+  if(plan->compress){
+    return sdecomp_internal_transpose_packed_execute(error_label, plan, 1, &sendbuf, &recvbuf, sdecomp_internal_transpose_compressed_exchange);
+  }
+  if(1 < plan->nslabs){
+    return execute_pipelined(plan, sendbuf, recvbuf);
+  }
+  sdecomp_transpose_request_t request = {0};
+  request.plan = plan;
+  request.recvbuf = recvbuf;
+  if(0 != start(error_label, plan, sendbuf, recvbuf, &request)) return 1;
+  if(0 != wait(&request)) return 1;
+  return 0;
+}
+
+// packed buffers accommodating all fields are prepared for each call
+static int execute_batch(
+    const char error_label[],
+    sdecomp_transpose_plan_t * plan,
+    const size_t nfields,
+    const void * const * sendbufs,
+    void * const * recvbufs
+){
+  if(plan->compress){
+    return sdecomp_internal_transpose_packed_execute(error_label, plan, nfields, sendbufs, recvbufs, sdecomp_internal_transpose_compressed_exchange);
+  }
+  // NOTE: in the packed buffers, whose elements may be narrowed
+  const size_t size_of_element = plan->packed_size_of_element;
+  const int nprocs = plan->nprocs_2d;
+  int * scounts = sdecomp_internal_calloc(error_label, (size_t)nprocs, sizeof(int));
+  int * rcounts = sdecomp_internal_calloc(error_label, (size_t)nprocs, sizeof(int));
+  int * sdispls = sdecomp_internal_calloc(error_label, (size_t)nprocs, sizeof(int));
+  int * rdispls = sdecomp_internal_calloc(error_label, (size_t)nprocs, sizeof(int));
+  if(NULL == scounts) return 1;
+  if(NULL == rcounts) return 1;
+  if(NULL == sdispls) return 1;
+  if(NULL == rdispls) return 1;
+  size_t ssize = 0;
+  size_t rsize = 0;
+  if(0 != sdecomp_internal_transpose_packed_counts(error_label, plan, nfields, plan->schunks, scounts, sdispls, &ssize)) return 1;
+  if(0 != sdecomp_internal_transpose_packed_counts(error_label, plan, nfields, plan->rchunks, rcounts, rdispls, &rsize)) return 1;
+  void * packed_sendbuf = sdecomp_internal_calloc(error_label, ssize, size_of_element);
+  void * packed_recvbuf = sdecomp_internal_calloc(error_label, rsize, size_of_element);
+  if(NULL == packed_sendbuf) return 1;
+  if(NULL == packed_recvbuf) return 1;
+  sdecomp_internal_transpose_packed_pack(plan, 0, plan->schunks[0].nbatch, nfields, sendbufs, sdispls, packed_sendbuf);
+  MPI_Request request = MPI_REQUEST_NULL;
+  MPI_Ialltoallv(
+      packed_sendbuf, scounts, sdispls, plan->elemtype,
+      packed_recvbuf, rcounts, rdispls, plan->elemtype,
+      plan->comm_2d,
+      &request
+  );
+  for(size_t f = 0; f < nfields; f++){
+    sdecomp_internal_transpose_copy_self(plan, sendbufs[f], recvbufs[f]);
+  }
+  MPI_Wait(&request, MPI_STATUS_IGNORE);
+  sdecomp_internal_transpose_packed_unpack(plan, 0, plan->rchunks[0].nbatch, nfields, packed_recvbuf, rdispls, recvbufs);
+  sdecomp_internal_free(scounts);
+  sdecomp_internal_free(rcounts);
+  sdecomp_internal_free(sdispls);
+  sdecomp_internal_free(rdispls);
+  sdecomp_internal_free(packed_sendbuf);
+  sdecomp_internal_free(packed_recvbuf);
+  return 0;
+}
+
+static int finalise(
+    sdecomp_transpose_plan_t * plan
+){
+  if(plan->is_persistent){
+    MPI_Request_free(&plan->persistent_request);
+    plan->is_persistent = false;
+  }
+  sdecomp_internal_transpose_packed_finalise(plan);
+  sdecomp_internal_free(plan->slab_scounts);
+  sdecomp_internal_free(plan->slab_rcounts);
+  sdecomp_internal_free(plan->slab_sdispls);
+  sdecomp_internal_free(plan->slab_rdispls);
+  sdecomp_internal_free(plan->slab_requests);
+  sdecomp_internal_free(plan->slab_sendbuf);
+  sdecomp_internal_free(plan->slab_recvbuf);
+  return 0;
+}
+
+const sdecomp_internal_transpose_engine_t sdecomp_internal_transpose_engine_alltoallv = {
+  .init          = init,
+  .execute       = execute,
+  .execute_batch = execute_batch,
+  .start         = start,
+  .test          = test,
+  .wait          = wait,
+  .finalise      = finalise,
+};
@@ -0,0 +1,366 @@
+/*
+ * Copyright 2022 Naoki Hori
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// https://github.com/NaokiHori/SimpleDecomp
+
+// engine using derived data types and MPI_Alltoallw,
+//   in which packing and unpacking are delegated to the MPI library
+
+#include <stdbool.h>
+#include <limits.h>
+#include <mpi.h>
+#include "sdecomp.h"
+#define SDECOMP_INTERNAL
+#include "../internal.h"
+#define SDECOMP_INTERNAL_TRANSPOSE
+#include "internal.h"
+
+// data types describing the batches from b0 to b0 + nb - 1 of a send chunk
+int sdecomp_internal_transpose_create_send_type(
+    const size_t size_of_element,
+    const sdecomp_internal_transpose_chunk_t * chunk,
+    const size_t b0,
+    const size_t nb,
+    MPI_Datatype * type
+){
+  MPI_Datatype basetype = MPI_DATATYPE_NULL;
+  MPI_Datatype column = MPI_DATATYPE_NULL;
+  MPI_Datatype block = MPI_DATATYPE_NULL;
+  MPI_Type_contiguous((int)size_of_element, MPI_BYTE, &basetype);
+  // one element in i, nj elements in j
+  MPI_Type_create_hvector((int)chunk->nj, 1, (MPI_Aint)(size_of_element * chunk->stride), basetype, &column);
+  // repetition in i
+  MPI_Type_create_hvector((int)chunk->ni, 1, (MPI_Aint)(size_of_element), column, &block);
+  // repetition in batch
+  MPI_Type_create_hvector((int)nb, 1, (MPI_Aint)(size_of_element * chunk->stride_batch), block, type);
+  MPI_Type_free(&basetype);
+  MPI_Type_free(&column);
+  MPI_Type_free(&block);
+  sdecomp_internal_transpose_shift_type(size_of_element * (chunk->offset + b0 * chunk->stride_batch), type);
+  return 0;
+}
+
+// data types describing the batches from b0 to b0 + nb - 1 of a recv chunk
+int sdecomp_internal_transpose_create_recv_type(
+    const size_t size_of_element,
+    const sdecomp_internal_transpose_chunk_t * chunk,
+    const size_t b0,
+    const size_t nb,
+    MPI_Datatype * type
+){
+  MPI_Datatype basetype = MPI_DATATYPE_NULL;
+  MPI_Datatype block = MPI_DATATYPE_NULL;
+  MPI_Type_contiguous((int)size_of_element, MPI_BYTE, &basetype);
+  // ni x nj elements, j is contiguous
+  MPI_Type_create_hvector((int)chunk->ni, (int)chunk->nj, (MPI_Aint)(size_of_element * chunk->stride), basetype, &block);
+  // repetition in batch
+  MPI_Type_create_hvector((int)nb, 1, (MPI_Aint)(size_of_element * chunk->stride_batch), block, type);
+  MPI_Type_free(&basetype);
+  MPI_Type_free(&block);
+  sdecomp_internal_transpose_shift_type(size_of_element * (chunk->offset + b0 * chunk->stride_batch), type);
+  return 0;
+}
+
+// data types of each slab for pipelined rotations
+static int init_slabs(
+    const char error_label[],
+    sdecomp_transpose_plan_t * plan
+){
+  const size_t size_of_element = plan->size_of_element;
+  const size_t nslabs = plan->nslabs;
+  const int nprocs = plan->nprocs_2d;
+  const size_t nitems = nslabs * (size_t)nprocs;
+  plan->slab_sdispls  = sdecomp_internal_calloc(error_label, nitems, sizeof(         int));
+  plan->slab_rdispls  = sdecomp_internal_calloc(error_label, nitems, sizeof(         int));
+  plan->slab_stypes   = sdecomp_internal_calloc(error_label, nitems, sizeof(MPI_Datatype));
+  plan->slab_rtypes   = sdecomp_internal_calloc(error_label, nitems, sizeof(MPI_Datatype));
+  plan->slab_requests = sdecomp_internal_calloc(error_label, nslabs, sizeof( MPI_Request));
+  if(NULL == plan->slab_sdispls ) return 1;
+  if(NULL == plan->slab_rdispls ) return 1;
+  if(NULL == plan->slab_stypes  ) return 1;
+  if(NULL == plan->slab_rtypes  ) return 1;
+  if(NULL == plan->slab_requests) return 1;
+  for(size_t s = 0; s < nslabs; s++){
+    size_t b0 = 0;
+    size_t nb = 0;
+    sdecomp_internal_transpose_get_slab(plan, s, &b0, &nb);
+    for(int n = 0; n < nprocs; n++){
+      const size_t index = s * (size_t)nprocs + (size_t)n;
+      sdecomp_internal_transpose_create_send_type(size_of_element, plan->schunks + n, b0, nb, plan->slab_stypes + index);
+      sdecomp_internal_transpose_create_recv_type(size_of_element, plan->rchunks + n, b0, nb, plan->slab_rtypes + index);
+    }
+  }
+  return 0;
+}
+
+// persistent collective is bound to the buffers given by the options
+static int init(
+    const char error_label[],
+    const sdecomp_transpose_options_t * options,
+    sdecomp_transpose_plan_t * plan
+){
+  plan->is_persistent = false;
+  plan->sendbuf = NULL;
+  plan->recvbuf = NULL;
+  plan->persistent_request = MPI_REQUEST_NULL;
+  if(1 < plan->nslabs){
+    if(0 != init_slabs(error_label, plan)) return 1;
+  }
+  if(!options->persistent) return 0;
+  if(0 != sdecomp_internal_sanitise_null(error_label, "options->sendbuf", options->sendbuf)) return 1;
+  if(0 != sdecomp_internal_sanitise_null(error_label, "options->recvbuf", options->recvbuf)) return 1;
+  if(0 != sdecomp_internal_transpose_alltoallw_init(
+      options->sendbuf, plan->scounts, plan->sdispls, plan->stypes,
+      options->recvbuf, plan->rcounts, plan->rdispls, plan->rtypes,
+      plan->comm_2d,
+      &plan->persistent_request,
+      &plan->is_persistent
+  )) return 1;
+  if(plan->is_persistent){
+    plan->sendbuf = options->sendbuf;
+    plan->recvbuf = options->recvbuf;
+  }
+  return 0;
+}
+
+// check whether the given pair of buffers can be handled by the persistent collective
+static bool is_bound(
+    const sdecomp_transpose_plan_t * plan,
+    const void * sendbuf,
+    const void * recvbuf
+){
+  if(!plan->is_persistent) return false;
+  return plan->sendbuf == sendbuf && plan->recvbuf == recvbuf;
+}
+
+// slabs are exchanged one after another,
+//   and at most two of them are on the fly at the same time
+static int execute_pipelined(
+    sdecomp_transpose_plan_t * plan,
+    const void * sendbuf,
+    void * recvbuf
+){
+  const size_t nslabs = plan->nslabs;
+  const size_t nprocs = (size_t)plan->nprocs_2d;
+  MPI_Request * requests = plan->slab_requests;
+  for(size_t s = 0; s < nslabs; s++){
+    MPI_Ialltoallw(
+        sendbuf, plan->scounts, plan->slab_sdispls + s * nprocs, plan->slab_stypes + s * nprocs,
+        recvbuf, plan->rcounts, plan->slab_rdispls + s * nprocs, plan->slab_rtypes + s * nprocs,
+        plan->comm_2d,
+        requests + s
+    );
+    if(0 == s){
+      sdecomp_internal_transpose_copy_self(plan, sendbuf, recvbuf);
+    }else{
+      MPI_Wait(requests + s - 1, MPI_STATUS_IGNORE);
+    }
+  }
+  MPI_Wait(requests + nslabs - 1, MPI_STATUS_IGNORE);
+  return 0;
+}
+
+static int execute(
+    sdecomp_transpose_plan_t * plan,
+    const void * sendbuf,
+    void * recvbuf
+){
+  if(1 < plan->nslabs){
+    return execute_pipelined(plan, sendbuf, recvbuf);
+  }
+  // NOTE: non-blocking collective is used even in the blocking runner,
+  //   so that my own chunk is processed while the others are on the fly
+  MPI_Request request = MPI_REQUEST_NULL;
+  MPI_Request * handle = &request;
+  if(is_bound(plan, sendbuf, recvbuf)){
+    handle = &plan->persistent_request;
+    MPI_Start(handle);
+  }else{
+    MPI_Ialltoallw(
+        sendbuf, plan->scounts, plan->sdispls, plan->stypes,
+        recvbuf, plan->rcounts, plan->rdispls, plan->rtypes,
+        plan->comm_2d,
+        handle
+    );
+  }
+  sdecomp_internal_transpose_copy_self(plan, sendbuf, recvbuf);
+  MPI_Wait(handle, MPI_STATUS_IGNORE);
+  return 0;
+}
+
+// data types of all fields are merged into one per process,
+//   whose displacements are the absolute addresses of the chunks
+//   i.e. they are used with MPI_BOTTOM
+int sdecomp_internal_transpose_create_batch_types(
+    const char error_label[],
+    const sdecomp_transpose_plan_t * plan,
+    const size_t nfields,
+    const void * const * sendbufs,
+    void * const * recvbufs,
+    MPI_Datatype * stypes,
+    MPI_Datatype * rtypes
+){
+  if((size_t)INT_MAX < nfields){
+    SDECOMP_ERROR("too many fields: %zu\n", error_label, nfields);
+    return 1;
+  }
+  const int nprocs = plan->nprocs_2d;
+  int          * blocklens = sdecomp_internal_calloc(error_label,        nfields, sizeof(         int));
+  MPI_Aint     * addrs     = sdecomp_internal_calloc(error_label,        nfields, sizeof(    MPI_Aint));
+  MPI_Datatype * types     = sdecomp_internal_calloc(error_label,        nfields, sizeof(MPI_Datatype));
+  if(NULL == blocklens) return 1;
+  if(NULL ==     addrs) return 1;
+  if(NULL ==     types) return 1;
+  for(int n = 0; n < nprocs; n++){
+    for(size_t f = 0; f < nfields; f++){
+      blocklens[f] = 1;
+      MPI_Get_address((const char *)sendbufs[f] + plan->sdispls[n], addrs + f);
+      types[f] = plan->stypes[n];
+    }
+    MPI_Type_create_struct((int)nfields, blocklens, addrs, types, stypes + n);
+    MPI_Type_commit(stypes + n);
+    for(size_t f = 0; f < nfields; f++){
+      MPI_Get_address((char *)recvbufs[f] + plan->rdispls[n], addrs + f);
+      types[f] = plan->rtypes[n];
+    }
+    MPI_Type_create_struct((int)nfields, blocklens, addrs, types, rtypes + n);
+    MPI_Type_commit(rtypes + n);
+  }
+  sdecomp_internal_free(blocklens);
+  sdecomp_internal_free(addrs);
+  sdecomp_internal_free(types);
+  return 0;
+}
+
+static int execute_batch(
+    const char error_label[],
+    sdecomp_transpose_plan_t * plan,
+    const size_t nfields,
+    const void * const * sendbufs,
+    void * const * recvbufs
+){
+  const int nprocs = plan->nprocs_2d;
+  int          * displs = sdecomp_internal_calloc(error_label, (size_t)nprocs, sizeof(         int));
+  MPI_Datatype * stypes = sdecomp_internal_calloc(error_label, (size_t)nprocs, sizeof(MPI_Datatype));
+  MPI_Datatype * rtypes = sdecomp_internal_calloc(error_label, (size_t)nprocs, sizeof(MPI_Datatype));
+  if(NULL == displs) return 1;
+  if(NULL == stypes) return 1;
+  if(NULL == rtypes) return 1;
+  if(0 != sdecomp_internal_transpose_create_batch_types(error_label, plan, nfields, sendbufs, recvbufs, stypes, rtypes)) return 1;
+  // NOTE: counts to myself are zero, see sdecomp_internal_transpose_copy_self
+  MPI_Request request = MPI_REQUEST_NULL;
+  MPI_Ialltoallw(
+      MPI_BOTTOM, plan->scounts, displs, stypes,
+      MPI_BOTTOM, plan->rcounts, displs, rtypes,
+      plan->comm_2d,
+      &request
+  );
+  for(size_t f = 0; f < nfields; f++){
+    sdecomp_internal_transpose_copy_self(plan, sendbufs[f], recvbufs[f]);
+  }
+  MPI_Wait(&request, MPI_STATUS_IGNORE);
+  for(int n = 0; n < nprocs; n++){
+    MPI_Type_free(stypes + n);
+    MPI_Type_free(rtypes + n);
+  }
+  sdecomp_internal_free(displs);
+  sdecomp_internal_free(stypes);
+  sdecomp_internal_free(rtypes);
+  return 0;
+}
+
+static int start(
+    const char error_label[],
+    sdecomp_transpose_plan_t * plan,
+    const void * sendbuf,
+    void * recvbuf,
+    sdecomp_transpose_request_t * request
+){
+  (void)error_label;
+  if(is_bound(plan, sendbuf, recvbuf)){
+    // NOTE: the persistent request is kept by the plan
+    request->handle = &plan->persistent_request;
+    MPI_Start(request->handle);
+  }else{
+    request->handle = &request->request;
+    MPI_Ialltoallw(
+        sendbuf, plan->scounts, plan->sdispls, plan->stypes,
+        recvbuf, plan->rcounts, plan->rdispls, plan->rtypes,
+        plan->comm_2d,
+        request->handle
+    );
+  }
+  // my own chunk is processed while the others are on the fly
+  sdecomp_internal_transpose_copy_self(plan, sendbuf, recvbuf);
+  return 0;
+}
+
+static int test(
+    sdecomp_transpose_request_t * request,
+    bool * flag
+){
+  // NOTE: MPI_Test also drives progress of the communication
+  int flag_ = 0;
+  MPI_Test(request->handle, &flag_, MPI_STATUS_IGNORE);
+  request->is_completed = 0 != flag_;
+  *flag = request->is_completed;
+  return 0;
+}
+
+static int wait(
+    sdecomp_transpose_request_t * request
+){
+  MPI_Wait(request->handle, MPI_STATUS_IGNORE);
+  request->is_completed = true;
+  return 0;
+}
+
+static int finalise(
+    sdecomp_transpose_plan_t * plan
+){
+  if(plan->is_persistent){
+    MPI_Request_free(&plan->persistent_request);
+    plan->is_persistent = false;
+  }
+  if(1 < plan->nslabs){
+    const size_t nitems = plan->nslabs * (size_t)plan->nprocs_2d;
+    for(size_t n = 0; n < nitems; n++){
+      MPI_Type_free(plan->slab_stypes + n);
+      MPI_Type_free(plan->slab_rtypes + n);
+    }
+  }
+  sdecomp_internal_free(plan->slab_sdispls);
+  sdecomp_internal_free(plan->slab_rdispls);
+  sdecomp_internal_free(plan->slab_stypes);
+  sdecomp_internal_free(plan->slab_rtypes);
+  sdecomp_internal_free(plan->slab_requests);
+  return 0;
+}
+
+const sdecomp_internal_transpose_engine_t sdecomp_internal_transpose_engine_alltoallw = {
+  .init          = init,
+  .execute       = execute,
+  .execute_batch = execute_batch,
+  .start         = start,
+  .test          = test,
+  .wait          = wait,
+  .finalise      = finalise,
+};
@@ -0,0 +1,500 @@
+/*
+ * Copyright 2022 Naoki Hori
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// https://github.com/NaokiHori/SimpleDecomp
+
+// autotuning of transpose plans and the tuned results (wisdom),
+//   which are attached to sdecomp_info_t and can be exported / imported
+
+#include <stdio.h>
+#include <string.h>
+#include <mpi.h>
+#include "sdecomp.h"
+#define SDECOMP_INTERNAL
+#include "../internal.h"
+#define SDECOMP_INTERNAL_TRANSPOSE
+#include "internal.h"
+
+// number of rotations to measure each candidate
+#define SDECOMP_INTERNAL_NITERS 4
+
+// FNV-1a hash, updated by the given bytes
+static unsigned long long update_hash(
+    unsigned long long hash,
+    const void * data,
+    const size_t nbytes
+){
+  const unsigned char * bytes = data;
+  for(size_t n = 0; n < nbytes; n++){
+    hash ^= bytes[n];
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+// hash of the cumulative sums of the weights in all directions,
+//   which distinguishes the non-uniform decompositions sharing the process grid
+// NOTE: zero for the uniform decomposition
+static unsigned long long hash_weights(
+    const sdecomp_info_t * info
+){
+  bool is_uniform = true;
+  unsigned long long hash = 14695981039346656037ull;
+  for(size_t dim = 0; dim < info->ndims; dim++){
+    const sdecomp_internal_weights_t * weights = info->weights + dim;
+    // the number of weights in each direction is included,
+    //   so that the same weights in the other directions are distinguished
+    hash = update_hash(hash, &weights->nweights, sizeof(size_t));
+    if(NULL == weights->cumsums) continue;
+    is_uniform = false;
+    hash = update_hash(hash, weights->cumsums, sizeof(double) * (weights->nweights + 1));
+  }
+  return is_uniform ? 0 : hash;
+}
+
+// NOTE: missing dimensions (2D) are filled with zeros,
+//   so that keys can be compared and written in the same manner
+static int create_key(
+    const sdecomp_info_t * info,
+    const sdecomp_pencil_t pencil_bef,
+    const sdecomp_pencil_t pencil_aft,
+    const size_t * glsizes_bef,
+    const size_t * glsizes_aft,
+    const size_t size_of_element,
+    const sdecomp_transpose_wire_t wire,
+    const bool persistent,
+    sdecomp_internal_wisdom_entry_t * entry
+){
+  const size_t ndims = info->ndims;
+  int dims[3] = {0};
+  int periods[3] = {0};
+  int coords[3] = {0};
+  MPI_Cart_get(info->comm_cart, (int)ndims, dims, periods, coords);
+  memset(entry, 0, sizeof(sdecomp_internal_wisdom_entry_t));
+  entry->ndims = ndims;
+  entry->is_laid_out_by_nodes = info->is_laid_out_by_nodes;
+  entry->weights_hash = hash_weights(info);
+  for(size_t dim = 0; dim < ndims; dim++){
+    entry->dims[dim] = dims[dim];
+    entry->glsizes_bef[dim] = glsizes_bef[dim];
+    entry->glsizes_aft[dim] = glsizes_aft[dim];
+  }
+  entry->pencil_bef = pencil_bef;
+  entry->pencil_aft = pencil_aft;
+  entry->size_of_element = size_of_element;
+  entry->wire = wire;
+  entry->persistent = persistent;
+  return 0;
+}
+
+static bool is_same_key(
+    const sdecomp_internal_wisdom_entry_t * a,
+    const sdecomp_internal_wisdom_entry_t * b
+){
+  if(a->ndims != b->ndims) return false;
+  for(size_t dim = 0; dim < 3; dim++){
+    if(a->dims[dim] != b->dims[dim]) return false;
+    if(a->glsizes_bef[dim] != b->glsizes_bef[dim]) return false;
+    if(a->glsizes_aft[dim] != b->glsizes_aft[dim]) return false;
+  }
+  if(a->is_laid_out_by_nodes != b->is_laid_out_by_nodes) return false;
+  if(a->weights_hash != b->weights_hash) return false;
+  if(a->pencil_bef != b->pencil_bef) return false;
+  if(a->pencil_aft != b->pencil_aft) return false;
+  if(a->size_of_element != b->size_of_element) return false;
+  if(a->wire != b->wire) return false;
+  if(a->persistent != b->persistent) return false;
+  return true;
+}
+
+static sdecomp_internal_wisdom_entry_t * find_entry(
+    const sdecomp_internal_wisdom_t * wisdom,
+    const sdecomp_internal_wisdom_entry_t * key
+){
+  for(size_t n = 0; n < wisdom->nentries; n++){
+    if(is_same_key(wisdom->entries + n, key)){
+      return wisdom->entries + n;
+    }
+  }
+  return NULL;
+}
+
+// an existing entry having the same key is overwritten
+static int add_entry(
+    const char error_label[],
+    sdecomp_internal_wisdom_t * wisdom,
+    const sdecomp_internal_wisdom_entry_t * entry
+){
+  sdecomp_internal_wisdom_entry_t * found = find_entry(wisdom, entry);
+  if(NULL != found){
+    *found = *entry;
+    return 0;
+  }
+  const size_t nentries = wisdom->nentries + 1;
+  sdecomp_internal_wisdom_entry_t * entries = sdecomp_internal_calloc(error_label, nentries, sizeof(sdecomp_internal_wisdom_entry_t));
+  if(NULL == entries) return 1;
+  if(0 < wisdom->nentries){
+    memcpy(entries, wisdom->entries, wisdom->nentries * sizeof(sdecomp_internal_wisdom_entry_t));
+  }
+  entries[nentries - 1] = *entry;
+  sdecomp_internal_free(wisdom->entries);
+  wisdom->nentries = nentries;
+  wisdom->entries = entries;
+  return 0;
+}
+
+static int get_nitems(
+    const sdecomp_info_t * info,
+    const sdecomp_pencil_t pencil,
+    const size_t * glsizes,
+    size_t * nitems
+){
+  size_t mysizes[3] = {0};
+  size_t offsets[3] = {0};
+  if(0 != sdecomp_internal_get_pencil_layout(info, pencil, glsizes, mysizes, offsets)) return 1;
+  *nitems = 1;
+  for(size_t dim = 0; dim < info->ndims; dim++){
+    *nitems *= mysizes[dim];
+  }
+  return 0;
+}
+
+// the slowest process decides the elapsed time, which is shared by all processes
+static int measure(
+    const char error_label[],
+    const sdecomp_info_t * info,
+    const sdecomp_pencil_t pencil_bef,
+    const sdecomp_pencil_t pencil_aft,
+    const size_t * glsizes_bef,
+    const size_t * glsizes_aft,
+    const size_t size_of_element,
+    const sdecomp_transpose_options_t * candidate,
+    double * elapsed
+){
+  size_t nitems_bef = 0;
+  size_t nitems_aft = 0;
+  if(0 != get_nitems(info, pencil_bef, glsizes_bef, &nitems_bef)) return 1;
+  if(0 != get_nitems(info, pencil_aft, glsizes_aft, &nitems_aft)) return 1;
+  void * sendbuf = sdecomp_internal_calloc(error_label, nitems_bef, size_of_element);
+  void * recvbuf = sdecomp_internal_calloc(error_label, nitems_aft, size_of_element);
+  if(NULL == sendbuf) return 1;
+  if(NULL == recvbuf) return 1;
+  sdecomp_transpose_plan_t * plan = NULL;
+  if(0 != sdecomp_internal_transpose_construct_resized(info, pencil_bef, pencil_aft, glsizes_bef, glsizes_aft, size_of_element, size_of_element, candidate, &plan)) return 1;
+  // warm-up
+  if(0 != sdecomp_internal_transpose_execute(plan, sendbuf, recvbuf)) return 1;
+  MPI_Barrier(info->comm_cart);
+  const double tic = MPI_Wtime();
+  for(size_t iter = 0; iter < SDECOMP_INTERNAL_NITERS; iter++){
+    if(0 != sdecomp_internal_transpose_execute(plan, sendbuf, recvbuf)) return 1;
+  }
+  const double toc = MPI_Wtime();
+  *elapsed = toc - tic;
+  MPI_Allreduce(MPI_IN_PLACE, elapsed, 1, MPI_DOUBLE, MPI_MAX, info->comm_cart);
+  if(0 != sdecomp_internal_transpose_destruct(plan)) return 1;
+  sdecomp_internal_free(sendbuf);
+  sdecomp_internal_free(recvbuf);
+  return 0;
+}
+
+/**
+ * @brief find the fastest way to perform a pencil rotation
+ * @param[in]  error_label     : label of the caller
+ * @param[in]  info            : struct contains information of process distribution
+ * @param[in]  pencil_bef      : type of pencil before rotated
+ * @param[in]  pencil_aft      : type of pencil after  rotated
+ * @param[in]  glsizes_bef     : global array size in each dimension, before rotated
+ * @param[in]  glsizes_aft     : global array size in each dimension, after  rotated
+ * @param[in]  size_of_element : size of each element
+ * @param[in]  options         : options given by the user
+ * @param[out] tuned           : options whose engine and nslabs are tuned
+ * @return                     : (success) 0
+ *                               (failure) non-zero value
+ */
+int sdecomp_internal_transpose_autotune(
+    const char error_label[],
+    const sdecomp_info_t * info,
+    const sdecomp_pencil_t pencil_bef,
+    const sdecomp_pencil_t pencil_aft,
+    const size_t * glsizes_bef,
+    const size_t * glsizes_aft,
+    const size_t size_of_element,
+    const sdecomp_transpose_options_t * options,
+    sdecomp_transpose_options_t * tuned
+){
+  *tuned = *options;
+  tuned->autotune = false;
+  // compression is implemented only for one engine, leaving nothing to be tuned
+  if(options->compress){
+    tuned->engine = SDECOMP_TRANSPOSE_ENGINE_ALLTOALLV;
+    tuned->nslabs = 1;
+    return 0;
+  }
+  sdecomp_internal_wisdom_entry_t entry = {0};
+  create_key(info, pencil_bef, pencil_aft, glsizes_bef, glsizes_aft, size_of_element, options->wire, options->persistent, &entry);
+  // skip measurements if known
+  // NOTE: all processes share the same wisdom, see import_wisdom
+  const sdecomp_internal_wisdom_entry_t * found = find_entry(info->wisdom, &entry);
+  if(NULL != found){
+    tuned->engine = found->engine;
+    tuned->nslabs = found->nslabs;
+    return 0;
+  }
+  // candidates, which are filtered by the requested features below
+  const size_t nslabs_pipelined = 4;
+  const sdecomp_transpose_engine_t engines[] = {
+    SDECOMP_TRANSPOSE_ENGINE_ALLTOALLW,
+    SDECOMP_TRANSPOSE_ENGINE_ALLTOALLV,
+    SDECOMP_TRANSPOSE_ENGINE_PAIRWISE,
+    SDECOMP_TRANSPOSE_ENGINE_BRUCK,
+    SDECOMP_TRANSPOSE_ENGINE_SHM,
+    SDECOMP_TRANSPOSE_ENGINE_HIERARCHICAL,
+    SDECOMP_TRANSPOSE_ENGINE_RMA,
+    SDECOMP_TRANSPOSE_ENGINE_NEIGHBOR,
+    SDECOMP_TRANSPOSE_ENGINE_ALLTOALLW,
+    SDECOMP_TRANSPOSE_ENGINE_ALLTOALLV,
+  };
+  const size_t nslabs[] = {1, 1, 1, 1, 1, 1, 1, 1, nslabs_pipelined, nslabs_pipelined};
+  const size_t ncandidates = sizeof(engines) / sizeof(engines[0]);
+  double elapsed_min = 0.;
+  bool is_measured = false;
+  for(size_t n = 0; n < ncandidates; n++){
+    // reduced-precision wire format is available only for some engines
+    if(SDECOMP_TRANSPOSE_WIRE_NATIVE != options->wire && !sdecomp_internal_is_packing_engine(engines[n])){
+      continue;
+    }
+    // pipelined rotations cannot be persistent
+    if(options->persistent && 1 < nslabs[n]){
+      continue;
+    }
+    // persistent rotations are available only for some engines
+    if(options->persistent && !sdecomp_internal_is_persistent_engine(engines[n])){
+      continue;
+    }
+    // NOTE: measured without persistent collectives,
+    //   since they are bound to the buffers given by the user
+    sdecomp_transpose_options_t candidate = SDECOMP_TRANSPOSE_DEFAULT_OPTIONS;
+    candidate.engine = engines[n];
+    candidate.nslabs = nslabs[n];
+    candidate.wire = options->wire;
+    double elapsed = 0.;
+    if(0 != measure(error_label, info, pencil_bef, pencil_aft, glsizes_bef, glsizes_aft, size_of_element, &candidate, &elapsed)) return 1;
+    if(!is_measured || elapsed < elapsed_min){
+      is_measured = true;
+      elapsed_min = elapsed;
+      tuned->engine = candidate.engine;
+      tuned->nslabs = candidate.nslabs;
+    }
+  }
+  entry.engine = tuned->engine;
+  entry.nslabs = tuned->nslabs;
+  if(0 != add_entry(error_label, info->wisdom, &entry)) return 1;
+  return 0;
+}
+
+/**
+ * @brief write tuned results to a file
+ * @param[in] info     : struct contains information of process distribution
+ * @param[in] filename : name of the file (written by the main process)
+ * @return             : (success) 0
+ *                       (failure) non-zero value
+ */
+int sdecomp_internal_transpose_export_wisdom(
+    const sdecomp_info_t * info,
+    const char filename[]
+){
+  const char error_label[] = {"sdecomp.transpose.export_wisdom"};
+  if(0 != sdecomp_internal_sanitise_null(error_label,     "info",     info)) return 1;
+  if(0 != sdecomp_internal_sanitise_null(error_label, "filename", filename)) return 1;
+  int myrank = 0;
+  MPI_Comm_rank(info->comm_cart, &myrank);
+  // NOTE: the result of the main process is shared, so that all processes return the same value
+  int retval = 0;
+  if(0 == myrank){
+    FILE * fp = fopen(filename, "w");
+    if(NULL == fp){
+      SDECOMP_ERROR(
+          "failed to open file: %s\n",
+          error_label, filename
+      );
+      retval = 1;
+    }else{
+      const sdecomp_internal_wisdom_t * wisdom = info->wisdom;
+      fprintf(fp, "# ndims, dims[3], is_laid_out_by_nodes, weights_hash, pencil_bef, pencil_aft, glsizes_bef[3], glsizes_aft[3], size_of_element, wire, persistent, engine, nslabs\n");
+      for(size_t n = 0; n < wisdom->nentries; n++){
+        const sdecomp_internal_wisdom_entry_t * entry = wisdom->entries + n;
+        fprintf(
+            fp,
+            "%zu %d %d %d %u %016llx %u %u %zu %zu %zu %zu %zu %zu %zu %u %u %u %zu\n",
+            entry->ndims,
+            entry->dims[0], entry->dims[1], entry->dims[2],
+            (unsigned int)entry->is_laid_out_by_nodes,
+            entry->weights_hash,
+            (unsigned int)entry->pencil_bef, (unsigned int)entry->pencil_aft,
+            entry->glsizes_bef[0], entry->glsizes_bef[1], entry->glsizes_bef[2],
+            entry->glsizes_aft[0], entry->glsizes_aft[1], entry->glsizes_aft[2],
+            entry->size_of_element,
+            (unsigned int)entry->wire,
+            (unsigned int)entry->persistent,
+            (unsigned int)entry->engine,
+            entry->nslabs
+        );
+      }
+      fclose(fp);
+    }
+  }
+  MPI_Bcast(&retval, 1, MPI_INT, 0, info->comm_cart);
+  return retval;
+}
+
+// read entries on the main process
+static int read_wisdom(
+    const char error_label[],
+    const char filename[],
+    size_t * nentries,
+    sdecomp_internal_wisdom_entry_t ** entries
+){
+  *nentries = 0;
+  *entries = NULL;
+  FILE * fp = fopen(filename, "r");
+  if(NULL == fp){
+    SDECOMP_ERROR(
+        "failed to open file: %s\n",
+        error_label, filename
+    );
+    return 1;
+  }
+  char line[512] = {0};
+  while(NULL != fgets(line, sizeof(line), fp)){
+    if('#' == line[0]) continue;
+    sdecomp_internal_wisdom_entry_t entry = {0};
+    unsigned int is_laid_out_by_nodes = 0;
+    unsigned int pencil_bef = 0;
+    unsigned int pencil_aft = 0;
+    unsigned int wire = 0;
+    unsigned int persistent = 0;
+    unsigned int engine = 0;
+    const int nitems = sscanf(
+        line,
+        "%zu %d %d %d %u %llx %u %u %zu %zu %zu %zu %zu %zu %zu %u %u %u %zu",
+        &entry.ndims,
+        entry.dims + 0, entry.dims + 1, entry.dims + 2,
+        &is_laid_out_by_nodes,
+        &entry.weights_hash,
+        &pencil_bef, &pencil_aft,
+        entry.glsizes_bef + 0, entry.glsizes_bef + 1, entry.glsizes_bef + 2,
+        entry.glsizes_aft + 0, entry.glsizes_aft + 1, entry.glsizes_aft + 2,
+        &entry.size_of_element,
+        &wire,
+        &persistent,
+        &engine,
+        &entry.nslabs
+    );
+    if(19 != nitems){
+      SDECOMP_ERROR(
+          "invalid line in %s: %s",
+          error_label, filename, line
+      );
+      fclose(fp);
+      return 1;
+    }
+    entry.is_laid_out_by_nodes = 0 != is_laid_out_by_nodes;
+    entry.pencil_bef = (sdecomp_pencil_t)pencil_bef;
+    entry.pencil_aft = (sdecomp_pencil_t)pencil_aft;
+    entry.wire = (sdecomp_transpose_wire_t)wire;
+    entry.persistent = 0 != persistent;
+    entry.engine = (sdecomp_transpose_engine_t)engine;
+    if(0 != sdecomp_internal_sanitise_engine(error_label, entry.engine)
+        || 0 != sdecomp_internal_sanitise_wire(error_label, entry.wire, entry.engine, entry.size_of_element)
+        || 0 != sdecomp_internal_sanitise_nslabs(error_label, entry.nslabs, entry.persistent)
+        || 0 != sdecomp_internal_sanitise_engine_features(error_label, entry.engine, entry.nslabs, entry.persistent)
+    ){
+      fclose(fp);
+      return 1;
+    }
+    sdecomp_internal_wisdom_t wisdom = {.nentries = *nentries, .entries = *entries};
+    if(0 != add_entry(error_label, &wisdom, &entry)){
+      fclose(fp);
+      return 1;
+    }
+    *nentries = wisdom.nentries;
+    *entries = wisdom.entries;
+  }
+  fclose(fp);
+  return 0;
+}
+
+/**
+ * @brief read tuned results from a file, which are merged into the existing ones
+ * @param[in] info     : struct contains information of process distribution
+ * @param[in] filename : name of the file (read by the main process)
+ * @return             : (success) 0
+ *                       (failure) non-zero value
+ */
+int sdecomp_internal_transpose_import_wisdom(
+    const sdecomp_info_t * info,
+    const char filename[]
+){
+  const char error_label[] = {"sdecomp.transpose.import_wisdom"};
+  if(0 != sdecomp_internal_sanitise_null(error_label,     "info",     info)) return 1;
+  if(0 != sdecomp_internal_sanitise_null(error_label, "filename", filename)) return 1;
+  int myrank = 0;
+  MPI_Comm_rank(info->comm_cart, &myrank);
+  // read by the main process and broadcast,
+  //   so that all processes share the same wisdom
+  int retval = 0;
+  size_t nentries = 0;
+  sdecomp_internal_wisdom_entry_t * entries = NULL;
+  if(0 == myrank){
+    retval = read_wisdom(error_label, filename, &nentries, &entries);
+  }
+  MPI_Bcast(&retval, 1, MPI_INT, 0, info->comm_cart);
+  if(0 != retval){
+    sdecomp_internal_free(entries);
+    return retval;
+  }
+  unsigned long long nentries_ = (unsigned long long)nentries;
+  MPI_Bcast(&nentries_, 1, MPI_UNSIGNED_LONG_LONG, 0, info->comm_cart);
+  nentries = (size_t)nentries_;
+  if(0 == nentries) return 0;
+  int is_failed = 0;
+  if(0 != myrank){
+    entries = sdecomp_internal_calloc(error_label, nentries, sizeof(sdecomp_internal_wisdom_entry_t));
+    is_failed = NULL == entries;
+  }
+  // all processes should agree before the broadcast, which is collective
+  MPI_Allreduce(MPI_IN_PLACE, &is_failed, 1, MPI_INT, MPI_LOR, info->comm_cart);
+  if(is_failed){
+    sdecomp_internal_free(entries);
+    return 1;
+  }
+  MPI_Bcast(entries, (int)(nentries * sizeof(sdecomp_internal_wisdom_entry_t)), MPI_BYTE, 0, info->comm_cart);
+  for(size_t n = 0; n < nentries; n++){
+    if(0 != add_entry(error_label, info->wisdom, entries + n)){
+      sdecomp_internal_free(entries);
+      return 1;
+    }
+  }
+  sdecomp_internal_free(entries);
+  return 0;
+}
+
+#undef SDECOMP_INTERNAL_NITERS
@@ -0,0 +1,209 @@
+/*
+ * Copyright 2022 Naoki Hori
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// https://github.com/NaokiHori/SimpleDecomp
+
+// engine packing chunks explicitly into contiguous buffers,
+//   which are exchanged by the Bruck algorithm and unpacked afterwards
+// NOTE: suitable for small messages, since only log2(nprocs) messages are sent
+//   per process in exchange for forwarding chunks several times
+
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <mpi.h>
+#include "sdecomp.h"
+#define SDECOMP_INTERNAL
+#include "../internal.h"
+#define SDECOMP_INTERNAL_TRANSPOSE
+#include "internal.h"
+
+// the largest chunk in comm_2d, to which all chunks are padded
+static int init_max_count(
+    sdecomp_transpose_plan_t * plan
+){
+  unsigned long long max_count = 0;
+  for(int n = 0; n < plan->nprocs_2d; n++){
+    const unsigned long long count = (unsigned long long)plan->packed_scounts[n];
+    max_count = max_count < count ? count : max_count;
+  }
+  MPI_Allreduce(MPI_IN_PLACE, &max_count, 1, MPI_UNSIGNED_LONG_LONG, MPI_MAX, plan->comm_2d);
+  plan->max_count = (size_t)max_count;
+  return 0;
+}
+
+// in the round with a distance of 2^k, the chunks whose index has the k-th bit
+//   are forwarded to the process which is 2^k ahead,
+//   after the chunks are rotated such that the n-th one is sent to the (myrank + n)-th process
+static int exchange(
+    const char error_label[],
+    const sdecomp_transpose_plan_t * plan,
+    const size_t nfields,
+    const void * sendbuf,
+    const int * scounts,
+    const int * sdispls,
+    void * recvbuf,
+    const int * rcounts,
+    const int * rdispls
+){
+  // NOTE: in the packed buffers, whose elements may be narrowed
+  const size_t size_of_element = plan->packed_size_of_element;
+  const int nprocs = plan->nprocs_2d;
+  const int myrank = plan->myrank_2d;
+  // in the unit of elements
+  const size_t blocksize = nfields * plan->max_count;
+  if((size_t)INT_MAX < (size_t)nprocs * blocksize){
+    SDECOMP_ERROR(
+        "message is too large to be described by int\n",
+        error_label
+    );
+    return 1;
+  }
+  const size_t nbytes = size_of_element * blocksize;
+  char * blocks = sdecomp_internal_calloc(error_label, (size_t)nprocs, nbytes);
+  char * sbuf   = sdecomp_internal_calloc(error_label, (size_t)nprocs, nbytes);
+  char * rbuf   = sdecomp_internal_calloc(error_label, (size_t)nprocs, nbytes);
+  if(NULL == blocks) return 1;
+  if(NULL ==   sbuf) return 1;
+  if(NULL ==   rbuf) return 1;
+  for(int n = 0; n < nprocs; n++){
+    const int dst = (myrank + n) % nprocs;
+    memcpy(
+        blocks + nbytes * (size_t)n,
+        (const char *)sendbuf + size_of_element * (size_t)sdispls[dst],
+        size_of_element * (size_t)scounts[dst]
+    );
+  }
+  for(int distance = 1; distance < nprocs; distance *= 2){
+    const int dst = (myrank + distance) % nprocs;
+    const int src = (myrank - distance + nprocs) % nprocs;
+    int nblocks = 0;
+    for(int n = 0; n < nprocs; n++){
+      if(0 == (n & distance)) continue;
+      memcpy(sbuf + nbytes * (size_t)nblocks, blocks + nbytes * (size_t)n, nbytes);
+      nblocks += 1;
+    }
+    MPI_Sendrecv(
+        sbuf, nblocks * (int)blocksize, plan->elemtype, dst, 0,
+        rbuf, nblocks * (int)blocksize, plan->elemtype, src, 0,
+        plan->comm_2d,
+        MPI_STATUS_IGNORE
+    );
+    nblocks = 0;
+    for(int n = 0; n < nprocs; n++){
+      if(0 == (n & distance)) continue;
+      memcpy(blocks + nbytes * (size_t)n, rbuf + nbytes * (size_t)nblocks, nbytes);
+      nblocks += 1;
+    }
+  }
+  // now the n-th chunk comes from the (myrank - n)-th process
+  for(int n = 0; n < nprocs; n++){
+    const int src = (myrank - n + nprocs) % nprocs;
+    memcpy(
+        (char *)recvbuf + size_of_element * (size_t)rdispls[src],
+        blocks + nbytes * (size_t)n,
+        size_of_element * (size_t)rcounts[src]
+    );
+  }
+  sdecomp_internal_free(blocks);
+  sdecomp_internal_free(sbuf);
+  sdecomp_internal_free(rbuf);
+  return 0;
+}
+
+static int init(
+    const char error_label[],
+    const sdecomp_transpose_options_t * options,
+    sdecomp_transpose_plan_t * plan
+){
+  (void)options;
+  plan->is_persistent = false;
+  plan->persistent_request = MPI_REQUEST_NULL;
+  if(0 != sdecomp_internal_transpose_packed_init(error_label, plan)) return 1;
+  if(0 != init_max_count(plan)) return 1;
+  return 0;
+}
+
+static int execute(
+    sdecomp_transpose_plan_t * plan,
+    const void * sendbuf,
+    void * recvbuf
+){
+  const char error_label[] = {"sdecomp.transpose.execute"};
+  return sdecomp_internal_transpose_packed_execute(error_label, plan, 1, &sendbuf, &recvbuf, exchange);
+}
+
+static int execute_batch(
+    const char error_label[],
+    sdecomp_transpose_plan_t * plan,
+    const size_t nfields,
+    const void * const * sendbufs,
+    void * const * recvbufs
+){
+  return sdecomp_internal_transpose_packed_execute(error_label, plan, nfields, sendbufs, recvbufs, exchange);
+}
+
+// NOTE: each step forwards the blocks received in the previous steps,
+//   which are rearranged in between, so that the steps cannot be left to
+//   sdecomp.transpose.test / wait and the rotation does not overlap with the caller
+static int start(
+    const char error_label[],
+    sdecomp_transpose_plan_t * plan,
+    const void * sendbuf,
+    void * recvbuf,
+    sdecomp_transpose_request_t * request
+){
+  if(0 != sdecomp_internal_transpose_packed_execute(error_label, plan, 1, &sendbuf, &recvbuf, exchange)) return 1;
+  request->is_completed = true;
+  return 0;
+}
+
+static int test(
+    sdecomp_transpose_request_t * request,
+    bool * flag
+){
+  *flag = request->is_completed;
+  return 0;
+}
+
+static int wait(
+    sdecomp_transpose_request_t * request
+){
+  (void)request;
+  return 0;
+}
+
+static int finalise(
+    sdecomp_transpose_plan_t * plan
+){
+  sdecomp_internal_transpose_packed_finalise(plan);
+  return 0;
+}
+
+const sdecomp_internal_transpose_engine_t sdecomp_internal_transpose_engine_bruck = {
+  .init          = init,
+  .execute       = execute,
+  .execute_batch = execute_batch,
+  .start         = start,
+  .test          = test,
+  .wait          = wait,
+  .finalise      = finalise,
+};
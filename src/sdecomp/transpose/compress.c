@@ -0,0 +1,344 @@
+/*
+ * Copyright 2022 Naoki Hori
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// https://github.com/NaokiHori/SimpleDecomp
+
+// lossless compression of the packed chunks (see alltoallv.c)
+//   each chunk is byte-shuffled, i.e. the n-th bytes of all elements are gathered,
+//   and compressed by a small LZ77 codec,
+//   whose size is exchanged prior to the chunk itself
+// NOTE: a chunk which does not shrink is sent as it is,
+//   which is told by the receiver since the size is unchanged
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <mpi.h>
+#include "sdecomp.h"
+#define SDECOMP_INTERNAL
+#include "../internal.h"
+#define SDECOMP_INTERNAL_TRANSPOSE
+#include "internal.h"
+
+// shortest match and farthest reference of the codec
+#define SDECOMP_INTERNAL_MINMATCH 4
+#define SDECOMP_INTERNAL_MAXOFFSET 65535
+// number of entries of the hash table to find matches
+#define SDECOMP_INTERNAL_HASHLOG 12
+
+// gather the n-th bytes of all elements
+static void shuffle(
+    const size_t size_of_element,
+    const size_t nitems,
+    const uint8_t * restrict src,
+    uint8_t * restrict dst
+){
+  for(size_t n = 0; n < size_of_element; n++){
+    for(size_t m = 0; m < nitems; m++){
+      dst[n * nitems + m] = src[m * size_of_element + n];
+    }
+  }
+}
+
+static void unshuffle(
+    const size_t size_of_element,
+    const size_t nitems,
+    const uint8_t * restrict src,
+    uint8_t * restrict dst
+){
+  for(size_t n = 0; n < size_of_element; n++){
+    for(size_t m = 0; m < nitems; m++){
+      dst[m * size_of_element + n] = src[n * nitems + m];
+    }
+  }
+}
+
+static uint32_t read32(
+    const uint8_t * src
+){
+  uint32_t value = 0;
+  memcpy(&value, src, sizeof(uint32_t));
+  return value;
+}
+
+// a sequence consists of
+//   token: upper 4 bits for the number of literals,
+//          lower 4 bits for the length of the match minus MINMATCH,
+//          15 is followed by additional bytes, each of which is added until it is not 255
+//   literals
+//   offset of the match (2 bytes, little endian), absent in the last sequence
+//   additional bytes of the length of the match
+static bool put_length(
+    size_t length,
+    uint8_t * dst,
+    const size_t capacity,
+    size_t * position
+){
+  for(; 255 <= length; length -= 255){
+    if(capacity <= *position) return false;
+    dst[(*position)++] = 255;
+  }
+  if(capacity <= *position) return false;
+  dst[(*position)++] = (uint8_t)length;
+  return true;
+}
+
+static bool put_sequence(
+    const uint8_t * literals,
+    const size_t nliterals,
+    const size_t offset,
+    const size_t length,
+    const bool is_last,
+    uint8_t * dst,
+    const size_t capacity,
+    size_t * position
+){
+  const size_t extra = is_last ? 0 : length - SDECOMP_INTERNAL_MINMATCH;
+  if(capacity <= *position) return false;
+  dst[(*position)++] = (uint8_t)((nliterals < 15 ? nliterals : 15) << 4 | (extra < 15 ? extra : 15));
+  if(15 <= nliterals && !put_length(nliterals - 15, dst, capacity, position)) return false;
+  if(capacity - *position < nliterals) return false;
+  memcpy(dst + *position, literals, nliterals);
+  *position += nliterals;
+  if(is_last) return true;
+  if(capacity - *position < 2) return false;
+  dst[(*position)++] = (uint8_t)(offset & 0xff);
+  dst[(*position)++] = (uint8_t)(offset >> 8);
+  if(15 <= extra && !put_length(extra - 15, dst, capacity, position)) return false;
+  return true;
+}
+
+/**
+ * @brief compress a buffer
+ * @param[in]  src      : buffer to be compressed
+ * @param[in]  nbytes   : size of src
+ * @param[out] dst      : compressed buffer
+ * @param[in]  capacity : size of dst
+ * @return              : (success) size of the compressed buffer
+ *                        (failure) 0, i.e. it does not fit in dst
+ */
+static size_t compress(
+    const uint8_t * restrict src,
+    const size_t nbytes,
+    uint8_t * restrict dst,
+    const size_t capacity
+){
+  // the last position of each hashed 4-byte sequence plus one, 0 if not found yet
+  size_t table[1 << SDECOMP_INTERNAL_HASHLOG] = {0};
+  size_t position = 0;
+  size_t anchor = 0;
+  size_t index = 0;
+  while(index + SDECOMP_INTERNAL_MINMATCH <= nbytes){
+    const uint32_t sequence = read32(src + index);
+    const size_t hash = (size_t)((sequence * 2654435761u) >> (32 - SDECOMP_INTERNAL_HASHLOG));
+    const size_t reference = table[hash];
+    table[hash] = index + 1;
+    if(0 == reference || SDECOMP_INTERNAL_MAXOFFSET < index - (reference - 1) || read32(src + reference - 1) != sequence){
+      index += 1;
+      continue;
+    }
+    const size_t match = reference - 1;
+    size_t length = SDECOMP_INTERNAL_MINMATCH;
+    while(index + length < nbytes && src[match + length] == src[index + length]){
+      length += 1;
+    }
+    if(!put_sequence(src + anchor, index - anchor, index - match, length, false, dst, capacity, &position)) return 0;
+    index += length;
+    anchor = index;
+  }
+  if(!put_sequence(src + anchor, nbytes - anchor, 0, 0, true, dst, capacity, &position)) return 0;
+  return position;
+}
+
+static bool get_length(
+    const uint8_t * src,
+    const size_t nbytes,
+    size_t * position,
+    size_t * length
+){
+  for(;;){
+    if(nbytes <= *position) return false;
+    const uint8_t byte = src[(*position)++];
+    *length += byte;
+    if(255 != byte) return true;
+  }
+}
+
+/**
+ * @brief decompress a buffer
+ * @param[in]  src      : compressed buffer
+ * @param[in]  nbytes   : size of src
+ * @param[out] dst      : decompressed buffer
+ * @param[in]  capacity : expected size of dst
+ * @return              : (success) 0
+ *                        (failure) non-zero value, i.e. src is corrupted
+ */
+static int decompress(
+    const uint8_t * restrict src,
+    const size_t nbytes,
+    uint8_t * restrict dst,
+    const size_t capacity
+){
+  size_t position = 0;
+  size_t index = 0;
+  while(position < nbytes){
+    const uint8_t token = src[position++];
+    size_t nliterals = token >> 4;
+    if(15 == nliterals && !get_length(src, nbytes, &position, &nliterals)) return 1;
+    if(nbytes - position < nliterals || capacity - index < nliterals) return 1;
+    memcpy(dst + index, src + position, nliterals);
+    position += nliterals;
+    index += nliterals;
+    // the last sequence has no match
+    if(nbytes == position) break;
+    if(nbytes - position < 2) return 1;
+    const size_t offset = (size_t)src[position] | (size_t)src[position + 1] << 8;
+    position += 2;
+    size_t length = token & 0x0f;
+    if(15 == length && !get_length(src, nbytes, &position, &length)) return 1;
+    length += SDECOMP_INTERNAL_MINMATCH;
+    if(0 == offset || index < offset || capacity - index < length) return 1;
+    // NOTE: the match may overlap with itself, and thus copied byte by byte
+    for(size_t n = 0; n < length; n++, index++){
+      dst[index] = dst[index - offset];
+    }
+  }
+  return capacity == index ? 0 : 1;
+}
+
+/**
+ * @brief exchange the packed buffers, each chunk of which is compressed
+ * @param[in]  error_label : label of the caller
+ * @param[in]  plan        : transpose plan
+ * @param[in]  nfields     : number of fields in the packed buffers
+ * @param[in]  sendbuf     : packed send buffer
+ * @param[in]  scounts     : number of elements sent to each process
+ * @param[in]  sdispls     : displacement of each chunk in sendbuf
+ * @param[out] recvbuf     : packed recv buffer
+ * @param[in]  rcounts     : number of elements received from each process
+ * @param[in]  rdispls     : displacement of each chunk in recvbuf
+ * @return                 : (success) 0
+ *                           (failure) non-zero value
+ */
+int sdecomp_internal_transpose_compressed_exchange(
+    const char error_label[],
+    const sdecomp_transpose_plan_t * plan,
+    const size_t nfields,
+    const void * sendbuf,
+    const int * scounts,
+    const int * sdispls,
+    void * recvbuf,
+    const int * rcounts,
+    const int * rdispls
+){
+  (void)nfields;
+  const size_t size_of_element = plan->packed_size_of_element;
+  const int nprocs = plan->nprocs_2d;
+  // in the unit of bytes, which are described by int
+  size_t ssize = 0;
+  size_t rsize = 0;
+  size_t nscratch = 0;
+  for(int n = 0; n < nprocs; n++){
+    const size_t scount = (size_t)scounts[n];
+    const size_t rcount = (size_t)rcounts[n];
+    ssize = ssize < (size_t)sdispls[n] + scount ? (size_t)sdispls[n] + scount : ssize;
+    rsize += rcount;
+    nscratch = nscratch < scount ? scount : nscratch;
+    nscratch = nscratch < rcount ? rcount : nscratch;
+  }
+  if((size_t)INT_MAX / size_of_element < ssize || (size_t)INT_MAX / size_of_element < rsize){
+    SDECOMP_ERROR(
+        "packed buffer is too large to be compressed\n",
+        error_label
+    );
+    return 1;
+  }
+  int * sbytes = sdecomp_internal_calloc(error_label, (size_t)nprocs, sizeof(int));
+  int * rbytes = sdecomp_internal_calloc(error_label, (size_t)nprocs, sizeof(int));
+  int * sbdispls = sdecomp_internal_calloc(error_label, (size_t)nprocs, sizeof(int));
+  int * rbdispls = sdecomp_internal_calloc(error_label, (size_t)nprocs, sizeof(int));
+  uint8_t * compressed_sendbuf = sdecomp_internal_calloc(error_label, ssize, size_of_element);
+  uint8_t * compressed_recvbuf = sdecomp_internal_calloc(error_label, rsize, size_of_element);
+  uint8_t * scratch = sdecomp_internal_calloc(error_label, nscratch, size_of_element);
+  if(NULL ==             sbytes) return 1;
+  if(NULL ==             rbytes) return 1;
+  if(NULL ==           sbdispls) return 1;
+  if(NULL ==           rbdispls) return 1;
+  if(NULL == compressed_sendbuf) return 1;
+  if(NULL == compressed_recvbuf) return 1;
+  if(NULL ==            scratch) return 1;
+  // each compressed chunk is placed where the raw one is,
+  //   since it is not larger than the raw one
+  for(int n = 0; n < nprocs; n++){
+    const size_t nitems = (size_t)scounts[n];
+    const size_t nbytes = size_of_element * nitems;
+    const uint8_t * raw = (const uint8_t *)sendbuf + size_of_element * (size_t)sdispls[n];
+    uint8_t * compressed = compressed_sendbuf + size_of_element * (size_t)sdispls[n];
+    shuffle(size_of_element, nitems, raw, scratch);
+    // a chunk which does not shrink is sent as it is
+    const size_t size = 0 == nbytes ? 0 : compress(scratch, nbytes, compressed, nbytes - 1);
+    if(0 == size){
+      memcpy(compressed, raw, nbytes);
+      sbytes[n] = (int)nbytes;
+    }else{
+      sbytes[n] = (int)size;
+    }
+    sbdispls[n] = (int)(size_of_element * (size_t)sdispls[n]);
+  }
+  MPI_Alltoall(sbytes, 1, MPI_INT, rbytes, 1, MPI_INT, plan->comm_2d);
+  for(int n = 1; n < nprocs; n++){
+    rbdispls[n] = rbdispls[n - 1] + rbytes[n - 1];
+  }
+  MPI_Alltoallv(
+      compressed_sendbuf, sbytes, sbdispls, MPI_BYTE,
+      compressed_recvbuf, rbytes, rbdispls, MPI_BYTE,
+      plan->comm_2d
+  );
+  int retval = 0;
+  for(int n = 0; n < nprocs; n++){
+    const size_t nitems = (size_t)rcounts[n];
+    const size_t nbytes = size_of_element * nitems;
+    const uint8_t * compressed = compressed_recvbuf + (size_t)rbdispls[n];
+    uint8_t * raw = (uint8_t *)recvbuf + size_of_element * (size_t)rdispls[n];
+    if(nbytes == (size_t)rbytes[n]){
+      memcpy(raw, compressed, nbytes);
+      continue;
+    }
+    if(0 != decompress(compressed, (size_t)rbytes[n], scratch, nbytes)){
+      SDECOMP_ERROR(
+          "failed to decompress a chunk from process %d\n",
+          error_label, n
+      );
+      retval = 1;
+      break;
+    }
+    unshuffle(size_of_element, nitems, scratch, raw);
+  }
+  sdecomp_internal_free(sbytes);
+  sdecomp_internal_free(rbytes);
+  sdecomp_internal_free(sbdispls);
+  sdecomp_internal_free(rbdispls);
+  sdecomp_internal_free(compressed_sendbuf);
+  sdecomp_internal_free(compressed_recvbuf);
+  sdecomp_internal_free(scratch);
+  return retval;
+}
@@ -0,0 +1,494 @@
+/*
+ * Copyright 2022 Naoki Hori
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// https://github.com/NaokiHori/SimpleDecomp
+
+// engine packing chunks explicitly into contiguous buffers,
+//   which are exchanged hierarchically through a leader process of each node
+// NOTE: suitable for many processes spread over many nodes,
+//   since each node sends only one message to each of the other nodes
+//   1. chunks are gathered to the leader of the node,
+//   2. reordered by destination node and exchanged among the leaders,
+//   3. reordered by destination process and scattered in the node
+
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <mpi.h>
+#include "sdecomp.h"
+#define SDECOMP_INTERNAL
+#include "../internal.h"
+#define SDECOMP_INTERNAL_TRANSPOSE
+#include "internal.h"
+
+// (leader only) counts and displacements of the messages in int
+//   and buffers holding the data of the whole node,
+//   for a given number of fields exchanged at once
+typedef struct {
+  int * member_scounts;
+  int * member_sdispls;
+  int * member_rcounts;
+  int * member_rdispls;
+  int * node_scounts;
+  int * node_sdispls;
+  int * node_rcounts;
+  int * node_rdispls;
+  char * gathered;
+  char * aggregated;
+  char * received;
+  char * scattered;
+} layout_t;
+
+// NOTE: counts and displacements are for one field in the unit of elements,
+//   which are multiplied by the number of fields exchanged at once
+// NOTE: members of each node are in ascending order of the rank in comm_2d,
+//   which coincides with the rank in comm_node
+struct sdecomp_internal_transpose_hierarchy_t_ {
+  // leaders of all nodes, MPI_COMM_NULL if I am not a leader
+  MPI_Comm comm_leaders;
+  int nnodes;
+  int mynode;
+  // node index of each process in comm_2d
+  int * nodes;
+  // processes in comm_2d sorted by node,
+  //   members of the k-th node are members[offsets[k]] to members[offsets[k + 1] - 1]
+  int * members;
+  int * offsets;
+  // (leader only) packed-buffer layouts of the members (node_nprocs x nprocs_2d)
+  size_t * scounts;
+  size_t * sdispls;
+  size_t * rcounts;
+  size_t * rdispls;
+  // (leader only) totals of the members and of the other nodes
+  size_t * member_ssizes;
+  size_t * member_rsizes;
+  size_t * node_ssizes;
+  size_t * node_rsizes;
+  // (leader only) layout for a single field, which is prepared once
+  layout_t layout;
+};
+
+// counts and displacements in int, for the given number of fields
+static int scale(
+    const char error_label[],
+    const int n,
+    const size_t nfields,
+    const size_t * sizes,
+    int * counts,
+    int * displs
+){
+  size_t total = 0;
+  for(int i = 0; i < n; i++){
+    const size_t count = nfields * sizes[i];
+    if((size_t)INT_MAX < count || (size_t)INT_MAX < total){
+      SDECOMP_ERROR(
+          "aggregated message is too large to be described by int\n",
+          error_label
+      );
+      return 1;
+    }
+    counts[i] = (int)count;
+    displs[i] = (int)total;
+    total += count;
+  }
+  return 0;
+}
+
+static void finalise_layout(
+    layout_t * layout
+){
+  sdecomp_internal_free(layout->member_scounts);
+  sdecomp_internal_free(layout->member_sdispls);
+  sdecomp_internal_free(layout->member_rcounts);
+  sdecomp_internal_free(layout->member_rdispls);
+  sdecomp_internal_free(layout->node_scounts);
+  sdecomp_internal_free(layout->node_sdispls);
+  sdecomp_internal_free(layout->node_rcounts);
+  sdecomp_internal_free(layout->node_rdispls);
+  sdecomp_internal_free(layout->gathered);
+  sdecomp_internal_free(layout->aggregated);
+  sdecomp_internal_free(layout->received);
+  sdecomp_internal_free(layout->scattered);
+}
+
+// NOTE: members allocated before a failure are left to finalise_layout
+static int init_layout(
+    const char error_label[],
+    const sdecomp_internal_transpose_hierarchy_t * hierarchy,
+    const int node_nprocs,
+    const size_t nfields,
+    const size_t size_of_element,
+    layout_t * layout
+){
+  const int nnodes = hierarchy->nnodes;
+  layout->member_scounts = sdecomp_internal_calloc(error_label, (size_t)node_nprocs, sizeof(int));
+  layout->member_sdispls = sdecomp_internal_calloc(error_label, (size_t)node_nprocs, sizeof(int));
+  layout->member_rcounts = sdecomp_internal_calloc(error_label, (size_t)node_nprocs, sizeof(int));
+  layout->member_rdispls = sdecomp_internal_calloc(error_label, (size_t)node_nprocs, sizeof(int));
+  layout->node_scounts = sdecomp_internal_calloc(error_label, (size_t)nnodes, sizeof(int));
+  layout->node_sdispls = sdecomp_internal_calloc(error_label, (size_t)nnodes, sizeof(int));
+  layout->node_rcounts = sdecomp_internal_calloc(error_label, (size_t)nnodes, sizeof(int));
+  layout->node_rdispls = sdecomp_internal_calloc(error_label, (size_t)nnodes, sizeof(int));
+  if(NULL == layout->member_scounts) return 1;
+  if(NULL == layout->member_sdispls) return 1;
+  if(NULL == layout->member_rcounts) return 1;
+  if(NULL == layout->member_rdispls) return 1;
+  if(NULL == layout->node_scounts) return 1;
+  if(NULL == layout->node_sdispls) return 1;
+  if(NULL == layout->node_rcounts) return 1;
+  if(NULL == layout->node_rdispls) return 1;
+  if(0 != scale(error_label, node_nprocs, nfields, hierarchy->member_ssizes, layout->member_scounts, layout->member_sdispls)) return 1;
+  if(0 != scale(error_label, node_nprocs, nfields, hierarchy->member_rsizes, layout->member_rcounts, layout->member_rdispls)) return 1;
+  if(0 != scale(error_label, nnodes, nfields, hierarchy->node_ssizes, layout->node_scounts, layout->node_sdispls)) return 1;
+  if(0 != scale(error_label, nnodes, nfields, hierarchy->node_rsizes, layout->node_rcounts, layout->node_rdispls)) return 1;
+  const size_t ssize = (size_t)layout->member_sdispls[node_nprocs - 1] + (size_t)layout->member_scounts[node_nprocs - 1];
+  const size_t rsize = (size_t)layout->member_rdispls[node_nprocs - 1] + (size_t)layout->member_rcounts[node_nprocs - 1];
+  layout->gathered   = sdecomp_internal_calloc(error_label, ssize, size_of_element);
+  layout->aggregated = sdecomp_internal_calloc(error_label, ssize, size_of_element);
+  layout->received   = sdecomp_internal_calloc(error_label, rsize, size_of_element);
+  layout->scattered  = sdecomp_internal_calloc(error_label, rsize, size_of_element);
+  if(NULL ==   layout->gathered) return 1;
+  if(NULL == layout->aggregated) return 1;
+  if(NULL ==   layout->received) return 1;
+  if(NULL ==  layout->scattered) return 1;
+  return 0;
+}
+
+// 1. gather, by the leader, the packed send buffers of the members
+// 2. reorder them by destination node and exchange among the leaders
+// 3. reorder them by destination process and scatter them to the members
+static int exchange(
+    const char error_label[],
+    const sdecomp_transpose_plan_t * plan,
+    const size_t nfields,
+    const void * sendbuf,
+    const int * scounts,
+    const int * sdispls,
+    void * recvbuf,
+    const int * rcounts,
+    const int * rdispls
+){
+  (void)sdispls;
+  (void)rdispls;
+  const sdecomp_internal_transpose_hierarchy_t * hierarchy = plan->hierarchy;
+  // NOTE: in the packed buffers, whose elements may be narrowed
+  const size_t size_of_element = plan->packed_size_of_element;
+  const int nprocs = plan->nprocs_2d;
+  int node_nprocs = 0;
+  int node_myrank = 0;
+  MPI_Comm_size(plan->comm_node, &node_nprocs);
+  MPI_Comm_rank(plan->comm_node, &node_myrank);
+  const bool is_leader = 0 == node_myrank;
+  size_t ssize = 0;
+  size_t rsize = 0;
+  for(int n = 0; n < nprocs; n++){
+    ssize += (size_t)scounts[n];
+    rsize += (size_t)rcounts[n];
+  }
+  // layout for a single field is prepared in advance,
+  //   while the others are prepared for each batch
+  layout_t batch = {0};
+  const layout_t * layout = &hierarchy->layout;
+  if(1 != nfields){
+    // NOTE: a failure of any leader is shared with all processes,
+    //   which would otherwise be blocked in the gather or the exchange
+    int is_failed = 0;
+    if(is_leader){
+      is_failed = 0 != init_layout(error_label, hierarchy, node_nprocs, nfields, size_of_element, &batch);
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &is_failed, 1, MPI_INT, MPI_LOR, plan->comm_2d);
+    if(is_failed){
+      finalise_layout(&batch);
+      return 1;
+    }
+    layout = &batch;
+  }
+  if(!is_leader){
+    MPI_Gatherv(sendbuf, (int)ssize, plan->elemtype, NULL, NULL, NULL, plan->elemtype, 0, plan->comm_node);
+    MPI_Scatterv(NULL, NULL, NULL, plan->elemtype, recvbuf, (int)rsize, plan->elemtype, 0, plan->comm_node);
+    return 0;
+  }
+  const int nnodes = hierarchy->nnodes;
+  const int * members = hierarchy->members;
+  const int * offsets = hierarchy->offsets;
+  char * gathered = layout->gathered;
+  char * aggregated = layout->aggregated;
+  char * received = layout->received;
+  char * scattered = layout->scattered;
+  MPI_Gatherv(sendbuf, (int)ssize, plan->elemtype, gathered, layout->member_scounts, layout->member_sdispls, plan->elemtype, 0, plan->comm_node);
+  // [destination node][source member][destination member]
+  size_t offset = 0;
+  for(int k = 0; k < nnodes; k++){
+    for(int m = 0; m < node_nprocs; m++){
+      for(int l = offsets[k]; l < offsets[k + 1]; l++){
+        const int d = members[l];
+        const size_t index = (size_t)m * (size_t)nprocs + (size_t)d;
+        const size_t count = nfields * hierarchy->scounts[index];
+        memcpy(
+            aggregated + size_of_element * offset,
+            gathered + size_of_element * ((size_t)layout->member_sdispls[m] + nfields * hierarchy->sdispls[index]),
+            size_of_element * count
+        );
+        offset += count;
+      }
+    }
+  }
+  MPI_Alltoallv(
+      aggregated, layout->node_scounts, layout->node_sdispls, plan->elemtype,
+      received, layout->node_rcounts, layout->node_rdispls, plan->elemtype,
+      hierarchy->comm_leaders
+  );
+  // [source node][source member][destination member]
+  offset = 0;
+  for(int k = 0; k < nnodes; k++){
+    for(int l = offsets[k]; l < offsets[k + 1]; l++){
+      const int s = members[l];
+      for(int m = 0; m < node_nprocs; m++){
+        const size_t index = (size_t)m * (size_t)nprocs + (size_t)s;
+        const size_t count = nfields * hierarchy->rcounts[index];
+        memcpy(
+            scattered + size_of_element * ((size_t)layout->member_rdispls[m] + nfields * hierarchy->rdispls[index]),
+            received + size_of_element * offset,
+            size_of_element * count
+        );
+        offset += count;
+      }
+    }
+  }
+  MPI_Scatterv(scattered, layout->member_rcounts, layout->member_rdispls, plan->elemtype, recvbuf, (int)rsize, plan->elemtype, 0, plan->comm_node);
+  finalise_layout(&batch);
+  return 0;
+}
+
+static int init_hierarchy(
+    const char error_label[],
+    sdecomp_transpose_plan_t * plan
+){
+  const int nprocs = plan->nprocs_2d;
+  const int myrank = plan->myrank_2d;
+  sdecomp_internal_transpose_hierarchy_t * hierarchy = sdecomp_internal_calloc(error_label, 1, sizeof(sdecomp_internal_transpose_hierarchy_t));
+  if(NULL == hierarchy) return 1;
+  plan->hierarchy = hierarchy;
+  // processes sharing memory form a node, whose first process is the leader
+  MPI_Comm_split_type(plan->comm_2d, MPI_COMM_TYPE_SHARED, myrank, MPI_INFO_NULL, &plan->comm_node);
+  int node_nprocs = 0;
+  int node_myrank = 0;
+  MPI_Comm_size(plan->comm_node, &node_nprocs);
+  MPI_Comm_rank(plan->comm_node, &node_myrank);
+  const bool is_leader = 0 == node_myrank;
+  MPI_Comm_split(plan->comm_2d, is_leader ? 0 : MPI_UNDEFINED, myrank, &hierarchy->comm_leaders);
+  // index of my node, which is the rank of the leader in comm_leaders
+  int node_info[2] = {0, 0};
+  if(is_leader){
+    MPI_Comm_rank(hierarchy->comm_leaders, node_info + 0);
+    MPI_Comm_size(hierarchy->comm_leaders, node_info + 1);
+  }
+  MPI_Bcast(node_info, 2, MPI_INT, 0, plan->comm_node);
+  hierarchy->mynode = node_info[0];
+  hierarchy->nnodes = node_info[1];
+  const int nnodes = hierarchy->nnodes;
+  // sort processes by node, keeping the order of ranks in each node
+  hierarchy->nodes = sdecomp_internal_calloc(error_label, (size_t)nprocs, sizeof(int));
+  hierarchy->members = sdecomp_internal_calloc(error_label, (size_t)nprocs, sizeof(int));
+  hierarchy->offsets = sdecomp_internal_calloc(error_label, (size_t)nnodes + 1, sizeof(int));
+  if(NULL == hierarchy->nodes) return 1;
+  if(NULL == hierarchy->members) return 1;
+  if(NULL == hierarchy->offsets) return 1;
+  MPI_Allgather(&hierarchy->mynode, 1, MPI_INT, hierarchy->nodes, 1, MPI_INT, plan->comm_2d);
+  for(int n = 0; n < nprocs; n++){
+    hierarchy->offsets[hierarchy->nodes[n] + 1] += 1;
+  }
+  for(int k = 0; k < nnodes; k++){
+    hierarchy->offsets[k + 1] += hierarchy->offsets[k];
+  }
+  for(int k = 0, l = 0; k < nnodes; k++){
+    for(int n = 0; n < nprocs; n++){
+      if(k == hierarchy->nodes[n]){
+        hierarchy->members[l] = n;
+        l += 1;
+      }
+    }
+  }
+  // packed-buffer layouts of the members, which are collected by the leader
+  int * scounts = NULL;
+  int * rcounts = NULL;
+  // NOTE: all processes agree on the result of the leaders,
+  //   since the following communications are collective
+  int is_failed = 0;
+  if(is_leader){
+    const size_t nitems = (size_t)node_nprocs * (size_t)nprocs;
+    scounts = sdecomp_internal_calloc(error_label, nitems, sizeof(int));
+    rcounts = sdecomp_internal_calloc(error_label, nitems, sizeof(int));
+    hierarchy->scounts = sdecomp_internal_calloc(error_label, nitems, sizeof(size_t));
+    hierarchy->sdispls = sdecomp_internal_calloc(error_label, nitems, sizeof(size_t));
+    hierarchy->rcounts = sdecomp_internal_calloc(error_label, nitems, sizeof(size_t));
+    hierarchy->rdispls = sdecomp_internal_calloc(error_label, nitems, sizeof(size_t));
+    hierarchy->member_ssizes = sdecomp_internal_calloc(error_label, (size_t)node_nprocs, sizeof(size_t));
+    hierarchy->member_rsizes = sdecomp_internal_calloc(error_label, (size_t)node_nprocs, sizeof(size_t));
+    hierarchy->node_ssizes = sdecomp_internal_calloc(error_label, (size_t)nnodes, sizeof(size_t));
+    hierarchy->node_rsizes = sdecomp_internal_calloc(error_label, (size_t)nnodes, sizeof(size_t));
+    is_failed =
+      NULL == scounts
+      || NULL == rcounts
+      || NULL == hierarchy->scounts
+      || NULL == hierarchy->sdispls
+      || NULL == hierarchy->rcounts
+      || NULL == hierarchy->rdispls
+      || NULL == hierarchy->member_ssizes
+      || NULL == hierarchy->member_rsizes
+      || NULL == hierarchy->node_ssizes
+      || NULL == hierarchy->node_rsizes;
+  }
+  MPI_Allreduce(MPI_IN_PLACE, &is_failed, 1, MPI_INT, MPI_LOR, plan->comm_2d);
+  if(is_failed){
+    sdecomp_internal_free(scounts);
+    sdecomp_internal_free(rcounts);
+    return 1;
+  }
+  MPI_Gather(plan->packed_scounts, nprocs, MPI_INT, scounts, nprocs, MPI_INT, 0, plan->comm_node);
+  MPI_Gather(plan->packed_rcounts, nprocs, MPI_INT, rcounts, nprocs, MPI_INT, 0, plan->comm_node);
+  if(is_leader){
+    for(int m = 0; m < node_nprocs; m++){
+      size_t sdispl = 0;
+      size_t rdispl = 0;
+      for(int n = 0; n < nprocs; n++){
+        const size_t index = (size_t)m * (size_t)nprocs + (size_t)n;
+        hierarchy->scounts[index] = (size_t)scounts[index];
+        hierarchy->rcounts[index] = (size_t)rcounts[index];
+        hierarchy->sdispls[index] = sdispl;
+        hierarchy->rdispls[index] = rdispl;
+        sdispl += hierarchy->scounts[index];
+        rdispl += hierarchy->rcounts[index];
+        hierarchy->node_ssizes[hierarchy->nodes[n]] += hierarchy->scounts[index];
+        hierarchy->node_rsizes[hierarchy->nodes[n]] += hierarchy->rcounts[index];
+      }
+      hierarchy->member_ssizes[m] = sdispl;
+      hierarchy->member_rsizes[m] = rdispl;
+    }
+    // counts, displacements and buffers used by every single-field rotation
+    is_failed = 0 != init_layout(error_label, hierarchy, node_nprocs, 1, plan->packed_size_of_element, &hierarchy->layout);
+  }
+  sdecomp_internal_free(scounts);
+  sdecomp_internal_free(rcounts);
+  MPI_Allreduce(MPI_IN_PLACE, &is_failed, 1, MPI_INT, MPI_LOR, plan->comm_2d);
+  if(is_failed) return 1;
+  return 0;
+}
+
+static int init(
+    const char error_label[],
+    const sdecomp_transpose_options_t * options,
+    sdecomp_transpose_plan_t * plan
+){
+  (void)options;
+  plan->is_persistent = false;
+  plan->persistent_request = MPI_REQUEST_NULL;
+  if(0 != sdecomp_internal_transpose_packed_init(error_label, plan)) return 1;
+  if(0 != init_hierarchy(error_label, plan)) return 1;
+  return 0;
+}
+
+static int execute(
+    sdecomp_transpose_plan_t * plan,
+    const void * sendbuf,
+    void * recvbuf
+){
+  const char error_label[] = {"sdecomp.transpose.execute"};
+  return sdecomp_internal_transpose_packed_execute(error_label, plan, 1, &sendbuf, &recvbuf, exchange);
+}
+
+static int execute_batch(
+    const char error_label[],
+    sdecomp_transpose_plan_t * plan,
+    const size_t nfields,
+    const void * const * sendbufs,
+    void * const * recvbufs
+){
+  return sdecomp_internal_transpose_packed_execute(error_label, plan, nfields, sendbufs, recvbufs, exchange);
+}
+
+// NOTE: the leaders cannot exchange the aggregated chunks before they are gathered,
+//   nor scatter them before they are received, so that the rotation
+//   (gather, exchange and scatter) does not overlap with the caller
+static int start(
+    const char error_label[],
+    sdecomp_transpose_plan_t * plan,
+    const void * sendbuf,
+    void * recvbuf,
+    sdecomp_transpose_request_t * request
+){
+  if(0 != sdecomp_internal_transpose_packed_execute(error_label, plan, 1, &sendbuf, &recvbuf, exchange)) return 1;
+  request->is_completed = true;
+  return 0;
+}
+
+static int test(
+    sdecomp_transpose_request_t * request,
+    bool * flag
+){
+  *flag = request->is_completed;
+  return 0;
+}
+
+static int wait(
+    sdecomp_transpose_request_t * request
+){
+  (void)request;
+  return 0;
+}
+
+static int finalise(
+    sdecomp_transpose_plan_t * plan
+){
+  sdecomp_internal_transpose_packed_finalise(plan);
+  if(MPI_COMM_NULL != plan->comm_node){
+    MPI_Comm_free(&plan->comm_node);
+  }
+  sdecomp_internal_transpose_hierarchy_t * hierarchy = plan->hierarchy;
+  if(NULL == hierarchy) return 0;
+  if(MPI_COMM_NULL != hierarchy->comm_leaders){
+    MPI_Comm_free(&hierarchy->comm_leaders);
+  }
+  sdecomp_internal_free(hierarchy->nodes);
+  sdecomp_internal_free(hierarchy->members);
+  sdecomp_internal_free(hierarchy->offsets);
+  sdecomp_internal_free(hierarchy->scounts);
+  sdecomp_internal_free(hierarchy->sdispls);
+  sdecomp_internal_free(hierarchy->rcounts);
+  sdecomp_internal_free(hierarchy->rdispls);
+  sdecomp_internal_free(hierarchy->member_ssizes);
+  sdecomp_internal_free(hierarchy->member_rsizes);
+  sdecomp_internal_free(hierarchy->node_ssizes);
+  sdecomp_internal_free(hierarchy->node_rsizes);
+  finalise_layout(&hierarchy->layout);
+  sdecomp_internal_free(hierarchy);
+  return 0;
+}
+
+const sdecomp_internal_transpose_engine_t sdecomp_internal_transpose_engine_hierarchical = {
+  .init          = init,
+  .execute       = execute,
+  .execute_batch = execute_batch,
+  .start         = start,
+  .test          = test,
+  .wait          = wait,
+  .finalise      = finalise,
+};
@@ -0,0 +1,289 @@
+/*
+ * Copyright 2022 Naoki Hori
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// https://github.com/NaokiHori/SimpleDecomp
+
+// in-place rotation, in which one buffer holds the pencils before and after,
+//   whose size is the larger of the two
+// 1. the chunks are packed in place in the order they are sent,
+//    and moved to the end of the buffer
+// 2. one chunk is sent to and one chunk is received from one process per step,
+//    the latter of which is appended to the beginning of the buffer;
+//    it is staged in a scratch buffer until the region is released by the sent chunks
+// 3. the received chunks are unpacked in place
+// NOTE: the engine of the plan is not used
+
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <mpi.h>
+#include "sdecomp.h"
+#define SDECOMP_INTERNAL
+#include "../internal.h"
+#define SDECOMP_INTERNAL_TRANSPOSE
+#include "internal.h"
+
+// packed form of the chunks, in which they are ordered by the steps
+typedef struct {
+  const sdecomp_internal_transpose_chunk_t * chunks;
+  bool is_send;
+  int nprocs;
+  // partner at each step
+  const int * partners;
+  // first element of the chunk of each step (nprocs + 1)
+  const size_t * offsets;
+} layout_t;
+
+static size_t get_count(
+    const sdecomp_internal_transpose_chunk_t * chunk
+){
+  return chunk->nbatch * chunk->ni * chunk->nj;
+}
+
+// index in the pencil of the element at the given index in the packed form
+static size_t locate(
+    const layout_t * layout,
+    const size_t index
+){
+  // the step whose chunk contains the element, which is not empty
+  int lo = 0;
+  int hi = layout->nprocs;
+  while(1 < hi - lo){
+    const int mid = (lo + hi) / 2;
+    if(layout->offsets[mid] <= index){
+      lo = mid;
+    }else{
+      hi = mid;
+    }
+  }
+  const sdecomp_internal_transpose_chunk_t * chunk = layout->chunks + layout->partners[lo];
+  const size_t nij = chunk->ni * chunk->nj;
+  const size_t q = index - layout->offsets[lo];
+  const size_t b = q / nij;
+  const size_t i = q % nij / chunk->nj;
+  const size_t j = q % nij % chunk->nj;
+  // see sdecomp_internal_transpose_chunk_t
+  if(layout->is_send){
+    return chunk->offset + b * chunk->stride_batch + i + j * chunk->stride;
+  }else{
+    return chunk->offset + b * chunk->stride_batch + i * chunk->stride + j;
+  }
+}
+
+// permute the elements between the pencil and the packed form in place,
+//   by following the cycles of the permutation,
+//   in which the visited elements are flagged by one bit each
+static int permute(
+    const char error_label[],
+    const layout_t * layout,
+    const size_t nitems,
+    const size_t size_of_element,
+    const bool to_packed,
+    char * buf
+){
+  unsigned char * is_visited = sdecomp_internal_calloc(error_label, nitems / CHAR_BIT + 1, sizeof(unsigned char));
+  char * stash = sdecomp_internal_calloc(error_label, 2, size_of_element);
+  if(NULL == is_visited) return 1;
+  if(NULL ==      stash) return 1;
+#define VISIT(index) (is_visited[(index) / CHAR_BIT] |= (unsigned char)(1u << (index) % CHAR_BIT))
+#define VISITED(index) (is_visited[(index) / CHAR_BIT] & (1u << (index) % CHAR_BIT))
+#define ELEMENT(index) (buf + (index) * size_of_element)
+  for(size_t head = 0; head < nitems; head++){
+    if(VISITED(head)) continue;
+    memcpy(stash, ELEMENT(head), size_of_element);
+    if(to_packed){
+      // each element in the cycle is pulled from the pencil
+      size_t index = head;
+      for(;;){
+        VISIT(index);
+        const size_t source = locate(layout, index);
+        if(head == source){
+          memcpy(ELEMENT(index), stash, size_of_element);
+          break;
+        }
+        memcpy(ELEMENT(index), ELEMENT(source), size_of_element);
+        index = source;
+      }
+    }else{
+      // each element in the cycle is pushed to the pencil
+      VISIT(head);
+      for(size_t index = locate(layout, head); head != index; index = locate(layout, index)){
+        VISIT(index);
+        memcpy(stash + size_of_element, ELEMENT(index), size_of_element);
+        memcpy(ELEMENT(index), stash, size_of_element);
+        memcpy(stash, stash + size_of_element, size_of_element);
+      }
+      memcpy(ELEMENT(head), stash, size_of_element);
+    }
+  }
+#undef VISIT
+#undef VISITED
+#undef ELEMENT
+  sdecomp_internal_free(is_visited);
+  sdecomp_internal_free(stash);
+  return 0;
+}
+
+// the received chunks waiting for the region to be released
+//   are kept by the scratch buffer, whose size is found by following the steps
+static size_t get_nscratch(
+    const int nprocs,
+    const size_t * soffsets,
+    const size_t * roffsets,
+    const size_t capacity
+){
+  size_t nscratch = 0;
+  size_t head = 0;
+  size_t tail = capacity - soffsets[nprocs];
+  size_t npending = 0;
+  for(int step = 0; step < nprocs; step++){
+    npending += roffsets[step + 1] - roffsets[step];
+    nscratch = nscratch < npending ? npending : nscratch;
+    tail += soffsets[step + 1] - soffsets[step];
+    const size_t nflush = npending < tail - head ? npending : tail - head;
+    head += nflush;
+    npending -= nflush;
+  }
+  return nscratch;
+}
+
+static int exchange(
+    const char error_label[],
+    const sdecomp_transpose_plan_t * plan,
+    const int * partners,
+    const size_t * soffsets,
+    const size_t * roffsets,
+    const size_t capacity,
+    char * buf
+){
+  const size_t size_of_element = plan->size_of_element;
+  const int nprocs = plan->nprocs_2d;
+  const int myrank = plan->myrank_2d;
+  for(int step = 0; step < nprocs; step++){
+    const size_t count = soffsets[step + 1] - soffsets[step] < roffsets[step + 1] - roffsets[step]
+      ? roffsets[step + 1] - roffsets[step]
+      : soffsets[step + 1] - soffsets[step];
+    if((size_t)INT_MAX < count){
+      SDECOMP_ERROR(
+          "chunk is too large to be described by int\n",
+          error_label
+      );
+      return 1;
+    }
+  }
+  const size_t nscratch = get_nscratch(nprocs, soffsets, roffsets, capacity);
+  char * scratch = sdecomp_internal_calloc(error_label, nscratch, size_of_element);
+  if(NULL == scratch) return 1;
+  MPI_Datatype elemtype = MPI_DATATYPE_NULL;
+  MPI_Type_contiguous((int)size_of_element, MPI_BYTE, &elemtype);
+  MPI_Type_commit(&elemtype);
+  // the sent chunks are stored from "tail" to the end,
+  //   while the received chunks are stored from the beginning to "head"
+  //   and the others in the scratch buffer
+  size_t head = 0;
+  size_t tail = capacity - soffsets[nprocs];
+  size_t npending = 0;
+  memmove(buf + tail * size_of_element, buf, soffsets[nprocs] * size_of_element);
+  for(int step = 0; step < nprocs; step++){
+    const int partner = partners[step];
+    const size_t scount = soffsets[step + 1] - soffsets[step];
+    const size_t rcount = roffsets[step + 1] - roffsets[step];
+    const char * sendbuf = buf + tail * size_of_element;
+    char * recvbuf = scratch + npending * size_of_element;
+    if(myrank == partner){
+      memcpy(recvbuf, sendbuf, scount * size_of_element);
+    }else{
+      MPI_Sendrecv(
+          sendbuf, (int)scount, elemtype, partner, 0,
+          recvbuf, (int)rcount, elemtype, partner, 0,
+          plan->comm_2d, MPI_STATUS_IGNORE
+      );
+    }
+    npending += rcount;
+    tail += scount;
+    const size_t nflush = npending < tail - head ? npending : tail - head;
+    memcpy(buf + head * size_of_element, scratch, nflush * size_of_element);
+    memmove(scratch, scratch + nflush * size_of_element, (npending - nflush) * size_of_element);
+    head += nflush;
+    npending -= nflush;
+  }
+  MPI_Type_free(&elemtype);
+  sdecomp_internal_free(scratch);
+  return 0;
+}
+
+/**
+ * @brief execute transpose in place
+ * @param[in]     error_label : label of the caller
+ * @param[in]     plan        : transpose plan initialised by constructor
+ * @param[in,out] buf         : (in)  pencil before rotated
+ *                              (out) pencil after  rotated
+ * @return                    : (success) 0
+ *                              (failure) non-zero value
+ */
+int sdecomp_internal_transpose_inplace(
+    const char error_label[],
+    const sdecomp_transpose_plan_t * plan,
+    void * buf
+){
+  const size_t size_of_element = plan->size_of_element;
+  const int nprocs = plan->nprocs_2d;
+  const int myrank = plan->myrank_2d;
+  int * partners = sdecomp_internal_calloc(error_label, (size_t)nprocs, sizeof(int));
+  size_t * soffsets = sdecomp_internal_calloc(error_label, (size_t)nprocs + 1, sizeof(size_t));
+  size_t * roffsets = sdecomp_internal_calloc(error_label, (size_t)nprocs + 1, sizeof(size_t));
+  if(NULL == partners) return 1;
+  if(NULL == soffsets) return 1;
+  if(NULL == roffsets) return 1;
+  // the partner of my partner is me at each step,
+  //   so that two processes exchange their chunks with each other
+  for(int step = 0; step < nprocs; step++){
+    const int partner = ((step - myrank) % nprocs + nprocs) % nprocs;
+    partners[step] = partner;
+    soffsets[step + 1] = soffsets[step] + get_count(plan->schunks + partner);
+    roffsets[step + 1] = roffsets[step] + get_count(plan->rchunks + partner);
+  }
+  const size_t ssize = soffsets[nprocs];
+  const size_t rsize = roffsets[nprocs];
+  const size_t capacity = ssize < rsize ? rsize : ssize;
+  const layout_t slayout = {
+    .chunks   = plan->schunks,
+    .is_send  = true,
+    .nprocs   = nprocs,
+    .partners = partners,
+    .offsets  = soffsets,
+  };
+  const layout_t rlayout = {
+    .chunks   = plan->rchunks,
+    .is_send  = false,
+    .nprocs   = nprocs,
+    .partners = partners,
+    .offsets  = roffsets,
+  };
+  int retval = 0;
+  if(0 == retval) retval = permute(error_label, &slayout, ssize, size_of_element, true, buf);
+  if(0 == retval) retval = exchange(error_label, plan, partners, soffsets, roffsets, capacity, buf);
+  if(0 == retval) retval = permute(error_label, &rlayout, rsize, size_of_element, false, buf);
+  sdecomp_internal_free(partners);
+  sdecomp_internal_free(soffsets);
+  sdecomp_internal_free(roffsets);
+  return retval;
+}
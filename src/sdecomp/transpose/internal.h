@@ -28,7 +28,90 @@
 #error "do not include this header file"
 #endif
 
+// shape of a chunk exchanged with a process, in the unit of elements
+//   a chunk consists of "nbatch" (ni x nj) blocks, which are
+//   strided by "stride" in j and contiguous in i in the send buffer, and
+//   strided by "stride" in i and contiguous in j in the recv buffer
+// NOTE: in the packed (contiguous) form, elements are ordered as
+//   [batch][i][j] (j is the fastest),
+//   i.e. the pack process is a local transpose of each block
+typedef struct {
+  size_t nbatch;
+  size_t ni;
+  size_t nj;
+  size_t offset;
+  size_t stride_batch;
+  size_t stride;
+} sdecomp_internal_transpose_chunk_t;
+
+// nodes and their leaders for hierarchical rotations (see hierarchical.c)
+typedef struct sdecomp_internal_transpose_hierarchy_t_ sdecomp_internal_transpose_hierarchy_t;
+
+// engine-specific implementations of the runners
+typedef struct {
+  // prepare engine-specific members of the plan
+  int (* const init)(
+      const char error_label[],
+      const sdecomp_transpose_options_t * options,
+      sdecomp_transpose_plan_t * plan
+  );
+  // blocking rotation
+  int (* const execute)(
+      sdecomp_transpose_plan_t * plan,
+      const void * sendbuf,
+      void * recvbuf
+  );
+  // blocking rotation of several fields in one collective
+  int (* const execute_batch)(
+      const char error_label[],
+      sdecomp_transpose_plan_t * plan,
+      const size_t nfields,
+      const void * const * sendbufs,
+      void * const * recvbufs
+  );
+  // initiate non-blocking rotation
+  int (* const start)(
+      const char error_label[],
+      sdecomp_transpose_plan_t * plan,
+      const void * sendbuf,
+      void * recvbuf,
+      sdecomp_transpose_request_t * request
+  );
+  // check completion, engine resources of the request are released when completed
+  int (* const test)(
+      sdecomp_transpose_request_t * request,
+      bool * flag
+  );
+  // complete, engine resources of the request are released
+  int (* const wait)(
+      sdecomp_transpose_request_t * request
+  );
+  // clean-up engine-specific members of the plan
+  int (* const finalise)(
+      sdecomp_transpose_plan_t * plan
+  );
+} sdecomp_internal_transpose_engine_t;
+
 struct sdecomp_transpose_plan_t_ {
+  const sdecomp_internal_transpose_engine_t * engine;
+  size_t size_of_element;
+  // element type on the wire and the size of each element in the packed buffers,
+  //   which are smaller than size_of_element if narrowed
+  sdecomp_transpose_wire_t wire;
+  size_t packed_size_of_element;
+  // chunks in the packed buffers are compressed (see compress.c)
+  bool compress;
+  // number of elements of my pencils before and after the rotation,
+  //   which are not tiled by the chunks if the global sizes differ
+  bool is_resized;
+  size_t nitems_bef;
+  size_t nitems_aft;
+  // regions of my recv buffer which no one sends (padding),
+  //   described in the same manner as the recv chunks and zero-filled by the runners
+  sdecomp_internal_transpose_chunk_t pads[2];
+  int nprocs_2d;
+  int myrank_2d;
+  // all-to-allw parameters, using derived data types
   int * restrict scounts;
   int * restrict rcounts;
   int * restrict sdispls;
@@ -36,11 +119,205 @@ struct sdecomp_transpose_plan_t_ {
   MPI_Datatype * restrict stypes;
   MPI_Datatype * restrict rtypes;
   MPI_Comm comm_2d;
+  // chunks to be sent to / received from each process
+  sdecomp_internal_transpose_chunk_t * restrict schunks;
+  sdecomp_internal_transpose_chunk_t * restrict rchunks;
+  // all-to-allv parameters, using packed buffers
+  //   in the unit of elements
+  MPI_Datatype elemtype;
+  int * restrict packed_scounts;
+  int * restrict packed_rcounts;
+  int * restrict packed_sdispls;
+  int * restrict packed_rdispls;
+  size_t packed_ssize;
+  size_t packed_rsize;
+  // packed buffers owned by the plan,
+  //   which are lent to one rotation at a time
+  void * packed_sendbuf;
+  void * packed_recvbuf;
+  bool is_workspace_busy;
+  // persistent collective and the buffers bound to it
+  bool is_persistent;
+  const void * sendbuf;
+  void * recvbuf;
+  MPI_Request persistent_request;
+  // pipelined rotation, split into slabs along the unchanged dimension
+  //   counts, displacements and data types of each slab (nslabs x nprocs_2d)
+  size_t nslabs;
+  int * restrict slab_scounts;
+  int * restrict slab_rcounts;
+  int * restrict slab_sdispls;
+  int * restrict slab_rdispls;
+  MPI_Datatype * restrict slab_stypes;
+  MPI_Datatype * restrict slab_rtypes;
+  MPI_Request * restrict slab_requests;
+  //   packed buffers owned by the plan, which accommodate two slabs (double-buffered)
+  //   and replace the ones of the whole pencils (see alltoallv.c)
+  size_t slab_ssize;
+  size_t slab_rsize;
+  void * slab_sendbuf;
+  void * slab_recvbuf;
+  // the largest number of elements sent from one process to another,
+  //   in which all pairs in comm_2d are considered
+  size_t max_count;
+  // processes sharing memory with me, whose chunks are read directly
+  //   rank in comm_node of each process in comm_2d, MPI_UNDEFINED if not sharing memory
+  MPI_Comm comm_node;
+  int * restrict node_ranks;
+  bool has_remote;
+  // window exposing the chunks which each process in comm_node sends to the others in comm_node
+  //   segments and displacements are indexed by the rank in comm_2d
+  //   node_sdispls: chunk to each process in my segment
+  //   node_rdispls: chunk to me in the segment of each process
+  MPI_Win node_win;
+  void * node_sendbuf;
+  size_t node_ssize;
+  const void ** restrict node_sendbufs;
+  size_t * restrict node_sdispls;
+  size_t * restrict node_rdispls;
+  // hierarchical rotation through the leader of each node
+  sdecomp_internal_transpose_hierarchy_t * hierarchy;
+  // one-sided rotation, putting chunks into the receive buffers of the others
+  //   windows over the last receive buffers (bound by the options if persistent),
+  //   which are replaced in turn by the next one, and
+  //   a window over a staging buffer owned by the plan, which is copied afterwards
+  //   and is used while an on-going rotation uses one of the former windows
+  MPI_Win rma_wins[4];
+  void * rma_bases[4];
+  size_t rma_next;
+  MPI_Win rma_staging_win;
+  void * rma_staging_buf;
+  size_t rma_rsize;
+  //   data types of my chunks in my send buffer and in the receive buffers of the others
+  MPI_Datatype * restrict rma_stypes;
+  MPI_Datatype * restrict rma_rtypes;
+  //   processes putting chunks to me and those to which I put chunks,
+  //   which are given to the exposure and access epochs respectively
+  MPI_Group rma_origin_group;
+  MPI_Group rma_target_group;
+  // neighbourhood collective over a distributed graph,
+  //   in which the processes exchanging chunks with me are connected
+  //   sources / destinations sending / receiving chunks to / from me,
+  //   and the parameters of them in the order given to the graph,
+  //   whose data types are borrowed from stypes and rtypes
+  MPI_Comm comm_graph;
+  int nsources;
+  int ndestinations;
+  int * restrict sources;
+  int * restrict destinations;
+  int * restrict nbr_scounts;
+  int * restrict nbr_rcounts;
+  MPI_Aint * restrict nbr_sdispls;
+  MPI_Aint * restrict nbr_rdispls;
+  MPI_Datatype * restrict nbr_stypes;
+  MPI_Datatype * restrict nbr_rtypes;
 };
 
+struct sdecomp_transpose_request_t_ {
+  sdecomp_transpose_plan_t * plan;
+  void * recvbuf;
+  // points to either "request" below or the persistent one owned by the plan
+  MPI_Request * handle;
+  MPI_Request request;
+  // packed buffers, which are borrowed from the plan if available
+  void * packed_sendbuf;
+  void * packed_recvbuf;
+  bool is_workspace_borrowed;
+  // window whose epochs are opened by the rotation, see rma.c
+  MPI_Win window;
+  bool is_access_completed;
+  // exchange progressed step by step, see pairwise.c
+  int step;
+  MPI_Request step_requests[2];
+  bool is_completed;
+};
+
+extern const sdecomp_internal_transpose_engine_t sdecomp_internal_transpose_engine_alltoallw;
+extern const sdecomp_internal_transpose_engine_t sdecomp_internal_transpose_engine_alltoallv;
+extern const sdecomp_internal_transpose_engine_t sdecomp_internal_transpose_engine_pairwise;
+extern const sdecomp_internal_transpose_engine_t sdecomp_internal_transpose_engine_bruck;
+extern const sdecomp_internal_transpose_engine_t sdecomp_internal_transpose_engine_shm;
+extern const sdecomp_internal_transpose_engine_t sdecomp_internal_transpose_engine_hierarchical;
+extern const sdecomp_internal_transpose_engine_t sdecomp_internal_transpose_engine_rma;
+extern const sdecomp_internal_transpose_engine_t sdecomp_internal_transpose_engine_neighbor;
+
+// exchange of the packed buffers, in the unit of elements
+typedef int (* sdecomp_internal_transpose_exchange_t)(
+    const char error_label[],
+    const sdecomp_transpose_plan_t * plan,
+    const size_t nfields,
+    const void * sendbuf,
+    const int * scounts,
+    const int * sdispls,
+    void * recvbuf,
+    const int * rcounts,
+    const int * rdispls
+);
+
+// helper functions for the engines using the packed buffers
+extern int sdecomp_internal_transpose_packed_counts(
+    const char error_label[],
+    const sdecomp_transpose_plan_t * plan,
+    const size_t nfields,
+    const sdecomp_internal_transpose_chunk_t * chunks,
+    int * counts,
+    int * displs,
+    size_t * total
+);
+
+extern int sdecomp_internal_transpose_packed_init(
+    const char error_label[],
+    sdecomp_transpose_plan_t * plan
+);
+
+extern int sdecomp_internal_transpose_packed_finalise(
+    sdecomp_transpose_plan_t * plan
+);
+
+extern int sdecomp_internal_transpose_packed_acquire(
+    const char error_label[],
+    sdecomp_transpose_plan_t * plan,
+    sdecomp_transpose_request_t * request
+);
+
+extern int sdecomp_internal_transpose_packed_release(
+    sdecomp_transpose_plan_t * plan,
+    sdecomp_transpose_request_t * request
+);
+
+extern int sdecomp_internal_transpose_packed_pack(
+    const sdecomp_transpose_plan_t * plan,
+    const size_t b0,
+    const size_t nb,
+    const size_t nfields,
+    const void * const * sendbufs,
+    const int * displs,
+    void * packed
+);
+
+extern int sdecomp_internal_transpose_packed_unpack(
+    const sdecomp_transpose_plan_t * plan,
+    const size_t b0,
+    const size_t nb,
+    const size_t nfields,
+    const void * packed,
+    const int * displs,
+    void * const * recvbufs
+);
+
+extern int sdecomp_internal_transpose_packed_execute(
+    const char error_label[],
+    sdecomp_transpose_plan_t * plan,
+    const size_t nfields,
+    const void * const * sendbufs,
+    void * const * recvbufs,
+    const sdecomp_internal_transpose_exchange_t exchange
+);
+
 extern int sdecomp_internal_transpose_allocate(
     const char error_label[],
     const int nprocs_2d,
+    const int myrank_2d,
     sdecomp_transpose_plan_t ** plan
 );
 
@@ -53,7 +330,8 @@ extern int sdecomp_internal_transpose_init_2d(
     const sdecomp_info_t * info,
     const sdecomp_pencil_t pencil_bef,
     const sdecomp_pencil_t pencil_aft,
-    const size_t * glsizes,
+    const size_t * glsizes_bef,
+    const size_t * glsizes_aft,
     const size_t size_of_element,
     sdecomp_transpose_plan_t ** plan
 );
@@ -63,11 +341,170 @@ extern int sdecomp_internal_transpose_init_3d(
     const sdecomp_info_t * info,
     const sdecomp_pencil_t pencil_bef,
     const sdecomp_pencil_t pencil_aft,
-    const size_t * glsizes,
+    const size_t * glsizes_bef,
+    const size_t * glsizes_aft,
     const size_t size_of_element,
     sdecomp_transpose_plan_t ** plan
 );
 
+// create persistent all-to-allw if the MPI library supports it
+extern int sdecomp_internal_transpose_alltoallw_init(
+    const void * sendbuf,
+    const int * scounts,
+    const int * sdispls,
+    const MPI_Datatype * stypes,
+    void * recvbuf,
+    const int * rcounts,
+    const int * rdispls,
+    const MPI_Datatype * rtypes,
+    const MPI_Comm comm,
+    MPI_Request * request,
+    bool * is_created
+);
+
+// create persistent all-to-allv if the MPI library supports it
+extern int sdecomp_internal_transpose_alltoallv_init(
+    const void * sendbuf,
+    const int * scounts,
+    const int * sdispls,
+    void * recvbuf,
+    const int * rcounts,
+    const int * rdispls,
+    const MPI_Datatype datatype,
+    const MPI_Comm comm,
+    MPI_Request * request,
+    bool * is_created
+);
+
+// data types describing the batches from b0 to b0 + nb - 1 of a chunk,
+//   whose elements are ordered as in the packed form
+//   and whose offsets are embedded (i.e. displacements are zero)
+extern int sdecomp_internal_transpose_create_send_type(
+    const size_t size_of_element,
+    const sdecomp_internal_transpose_chunk_t * chunk,
+    const size_t b0,
+    const size_t nb,
+    MPI_Datatype * type
+);
+
+extern int sdecomp_internal_transpose_create_recv_type(
+    const size_t size_of_element,
+    const sdecomp_internal_transpose_chunk_t * chunk,
+    const size_t b0,
+    const size_t nb,
+    MPI_Datatype * type
+);
+
+// embed the offset of a chunk in its data type
+extern int sdecomp_internal_transpose_shift_type(
+    const size_t nbytes,
+    MPI_Datatype * type
+);
+
+// restrict a range to the leading part of a dimension
+extern int sdecomp_internal_transpose_clip(
+    const size_t extent,
+    const size_t offset,
+    size_t * size
+);
+
+// data types of several fields merged into one per process, used with MPI_BOTTOM
+extern int sdecomp_internal_transpose_create_batch_types(
+    const char error_label[],
+    const sdecomp_transpose_plan_t * plan,
+    const size_t nfields,
+    const void * const * sendbufs,
+    void * const * recvbufs,
+    MPI_Datatype * stypes,
+    MPI_Datatype * rtypes
+);
+
+// local transpose, from (nj x ni) to (ni x nj)
+extern void sdecomp_internal_transpose_kernel(
+    const size_t size_of_element,
+    const size_t ni,
+    const size_t nj,
+    const void * restrict src,
+    const size_t src_stride,
+    void * restrict dst,
+    const size_t dst_stride
+);
+
+// pack a chunk to a contiguous buffer
+extern void sdecomp_internal_transpose_pack(
+    const size_t size_of_element,
+    const sdecomp_internal_transpose_chunk_t * chunk,
+    const void * restrict sendbuf,
+    void * restrict packed
+);
+
+// unpack a chunk from a contiguous buffer
+extern void sdecomp_internal_transpose_unpack(
+    const size_t size_of_element,
+    const sdecomp_internal_transpose_chunk_t * chunk,
+    const void * restrict packed,
+    void * restrict recvbuf
+);
+
+// exchange of the packed buffers, each chunk of which is compressed
+extern int sdecomp_internal_transpose_compressed_exchange(
+    const char error_label[],
+    const sdecomp_transpose_plan_t * plan,
+    const size_t nfields,
+    const void * sendbuf,
+    const int * scounts,
+    const int * sdispls,
+    void * recvbuf,
+    const int * rcounts,
+    const int * rdispls
+);
+
+// pack / unpack a chunk, whose elements are narrowed on the wire
+//   identical to the above if the wire format is native
+extern void sdecomp_internal_transpose_pack_wire(
+    const sdecomp_transpose_wire_t wire,
+    const size_t size_of_element,
+    const sdecomp_internal_transpose_chunk_t * chunk,
+    const void * restrict sendbuf,
+    void * restrict packed
+);
+
+extern void sdecomp_internal_transpose_unpack_wire(
+    const sdecomp_transpose_wire_t wire,
+    const size_t size_of_element,
+    const sdecomp_internal_transpose_chunk_t * chunk,
+    const void * restrict packed,
+    void * restrict recvbuf
+);
+
+// range of batches of a slab, for pipelined rotations
+extern void sdecomp_internal_transpose_get_slab(
+    const sdecomp_transpose_plan_t * plan,
+    const size_t slab,
+    size_t * offset,
+    size_t * nbatch
+);
+
+// copy the chunk which I send to myself, without communication
+extern void sdecomp_internal_transpose_copy_self(
+    const sdecomp_transpose_plan_t * plan,
+    const void * restrict sendbuf,
+    void * restrict recvbuf
+);
+
+// zero-fill the padding of the pencil after rotated
+extern void sdecomp_internal_transpose_fill_pads(
+    const sdecomp_transpose_plan_t * plan,
+    void * recvbuf
+);
+
+// in-place rotation, in which the engine is not used
+extern int sdecomp_internal_transpose_inplace(
+    const char error_label[],
+    const sdecomp_transpose_plan_t * plan,
+    void * buf
+);
+
 extern int sdecomp_internal_execute(
     sdecomp_transpose_plan_t * restrict plan,
     const void * restrict sendbuf,
@@ -0,0 +1,619 @@
+/*
+ * Copyright 2022 Naoki Hori
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// https://github.com/NaokiHori/SimpleDecomp
+
+// local kernels to reorder data, used by the engines which pack messages explicitly
+// NOTE: transposes of 4-, 8- and 16-byte elements (e.g. float, double, double complex)
+//   are specialised, and small blocks are transposed in registers
+//   using SSE2 (and AVX, if enabled by the compiler flag, e.g. -mavx)
+
+#include <stdint.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+#include "sdecomp.h"
+#define SDECOMP_INTERNAL
+#include "../internal.h"
+#define SDECOMP_INTERNAL_TRANSPOSE
+#include "internal.h"
+
+// number of elements in one direction of a tile,
+//   which is small enough to keep a tile of the largest element (16 bytes) in L1
+#define SDECOMP_INTERNAL_TILE 32
+
+static size_t min(
+    const size_t a,
+    const size_t b
+){
+  return a < b ? a : b;
+}
+
+// transpose [i0 : i1) x [j0 : j1) element by element
+// NOTE: size_of_element is a constant for the specialised kernels,
+//   so that memcpy is reduced to a single load / store
+static inline void tile_scalar(
+    const size_t size_of_element,
+    const size_t i0,
+    const size_t i1,
+    const size_t j0,
+    const size_t j1,
+    const char * restrict src,
+    const size_t src_stride,
+    char * restrict dst,
+    const size_t dst_stride
+){
+  for(size_t i = i0; i < i1; i++){
+    for(size_t j = j0; j < j1; j++){
+      memcpy(
+          dst + size_of_element * (i * dst_stride + j),
+          src + size_of_element * (j * src_stride + i),
+          size_of_element
+      );
+    }
+  }
+}
+
+#if defined(__AVX__)
+
+// 8 x 8 block of 4-byte elements
+// NOTE: float instructions are used only to move bits
+static inline void block_b4(
+    const char * restrict src,
+    const size_t src_stride,
+    char * restrict dst,
+    const size_t dst_stride
+){
+  const size_t s = 4 * src_stride;
+  const size_t d = 4 * dst_stride;
+  const __m256 r0 = _mm256_loadu_ps((const float *)(src + 0 * s));
+  const __m256 r1 = _mm256_loadu_ps((const float *)(src + 1 * s));
+  const __m256 r2 = _mm256_loadu_ps((const float *)(src + 2 * s));
+  const __m256 r3 = _mm256_loadu_ps((const float *)(src + 3 * s));
+  const __m256 r4 = _mm256_loadu_ps((const float *)(src + 4 * s));
+  const __m256 r5 = _mm256_loadu_ps((const float *)(src + 5 * s));
+  const __m256 r6 = _mm256_loadu_ps((const float *)(src + 6 * s));
+  const __m256 r7 = _mm256_loadu_ps((const float *)(src + 7 * s));
+  const __m256 t0 = _mm256_unpacklo_ps(r0, r1);
+  const __m256 t1 = _mm256_unpackhi_ps(r0, r1);
+  const __m256 t2 = _mm256_unpacklo_ps(r2, r3);
+  const __m256 t3 = _mm256_unpackhi_ps(r2, r3);
+  const __m256 t4 = _mm256_unpacklo_ps(r4, r5);
+  const __m256 t5 = _mm256_unpackhi_ps(r4, r5);
+  const __m256 t6 = _mm256_unpacklo_ps(r6, r7);
+  const __m256 t7 = _mm256_unpackhi_ps(r6, r7);
+  const __m256 u0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+  const __m256 u1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+  const __m256 u2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+  const __m256 u3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+  const __m256 u4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+  const __m256 u5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+  const __m256 u6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+  const __m256 u7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+  _mm256_storeu_ps((float *)(dst + 0 * d), _mm256_permute2f128_ps(u0, u4, 0x20));
+  _mm256_storeu_ps((float *)(dst + 1 * d), _mm256_permute2f128_ps(u1, u5, 0x20));
+  _mm256_storeu_ps((float *)(dst + 2 * d), _mm256_permute2f128_ps(u2, u6, 0x20));
+  _mm256_storeu_ps((float *)(dst + 3 * d), _mm256_permute2f128_ps(u3, u7, 0x20));
+  _mm256_storeu_ps((float *)(dst + 4 * d), _mm256_permute2f128_ps(u0, u4, 0x31));
+  _mm256_storeu_ps((float *)(dst + 5 * d), _mm256_permute2f128_ps(u1, u5, 0x31));
+  _mm256_storeu_ps((float *)(dst + 6 * d), _mm256_permute2f128_ps(u2, u6, 0x31));
+  _mm256_storeu_ps((float *)(dst + 7 * d), _mm256_permute2f128_ps(u3, u7, 0x31));
+}
+#define SDECOMP_INTERNAL_BLOCK_B4 8
+
+// 4 x 4 block of 8-byte elements
+// NOTE: double instructions are used only to move bits
+static inline void block_b8(
+    const char * restrict src,
+    const size_t src_stride,
+    char * restrict dst,
+    const size_t dst_stride
+){
+  const size_t s = 8 * src_stride;
+  const size_t d = 8 * dst_stride;
+  const __m256d r0 = _mm256_loadu_pd((const double *)(src + 0 * s));
+  const __m256d r1 = _mm256_loadu_pd((const double *)(src + 1 * s));
+  const __m256d r2 = _mm256_loadu_pd((const double *)(src + 2 * s));
+  const __m256d r3 = _mm256_loadu_pd((const double *)(src + 3 * s));
+  const __m256d t0 = _mm256_unpacklo_pd(r0, r1);
+  const __m256d t1 = _mm256_unpackhi_pd(r0, r1);
+  const __m256d t2 = _mm256_unpacklo_pd(r2, r3);
+  const __m256d t3 = _mm256_unpackhi_pd(r2, r3);
+  _mm256_storeu_pd((double *)(dst + 0 * d), _mm256_permute2f128_pd(t0, t2, 0x20));
+  _mm256_storeu_pd((double *)(dst + 1 * d), _mm256_permute2f128_pd(t1, t3, 0x20));
+  _mm256_storeu_pd((double *)(dst + 2 * d), _mm256_permute2f128_pd(t0, t2, 0x31));
+  _mm256_storeu_pd((double *)(dst + 3 * d), _mm256_permute2f128_pd(t1, t3, 0x31));
+}
+#define SDECOMP_INTERNAL_BLOCK_B8 4
+
+#elif defined(__SSE2__)
+
+// 4 x 4 block of 4-byte elements
+static inline void block_b4(
+    const char * restrict src,
+    const size_t src_stride,
+    char * restrict dst,
+    const size_t dst_stride
+){
+  const size_t s = 4 * src_stride;
+  const size_t d = 4 * dst_stride;
+  const __m128i r0 = _mm_loadu_si128((const __m128i *)(src + 0 * s));
+  const __m128i r1 = _mm_loadu_si128((const __m128i *)(src + 1 * s));
+  const __m128i r2 = _mm_loadu_si128((const __m128i *)(src + 2 * s));
+  const __m128i r3 = _mm_loadu_si128((const __m128i *)(src + 3 * s));
+  const __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+  const __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+  const __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+  const __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+  _mm_storeu_si128((__m128i *)(dst + 0 * d), _mm_unpacklo_epi64(t0, t1));
+  _mm_storeu_si128((__m128i *)(dst + 1 * d), _mm_unpackhi_epi64(t0, t1));
+  _mm_storeu_si128((__m128i *)(dst + 2 * d), _mm_unpacklo_epi64(t2, t3));
+  _mm_storeu_si128((__m128i *)(dst + 3 * d), _mm_unpackhi_epi64(t2, t3));
+}
+#define SDECOMP_INTERNAL_BLOCK_B4 4
+
+// 2 x 2 block of 8-byte elements
+static inline void block_b8(
+    const char * restrict src,
+    const size_t src_stride,
+    char * restrict dst,
+    const size_t dst_stride
+){
+  const size_t s = 8 * src_stride;
+  const size_t d = 8 * dst_stride;
+  const __m128i r0 = _mm_loadu_si128((const __m128i *)(src + 0 * s));
+  const __m128i r1 = _mm_loadu_si128((const __m128i *)(src + 1 * s));
+  _mm_storeu_si128((__m128i *)(dst + 0 * d), _mm_unpacklo_epi64(r0, r1));
+  _mm_storeu_si128((__m128i *)(dst + 1 * d), _mm_unpackhi_epi64(r0, r1));
+}
+#define SDECOMP_INTERNAL_BLOCK_B8 2
+
+#endif
+
+#if defined(SDECOMP_INTERNAL_BLOCK_B4)
+
+// transpose a tile of 4-byte elements, block by block
+static void tile_b4(
+    const size_t i0,
+    const size_t i1,
+    const size_t j0,
+    const size_t j1,
+    const char * restrict src,
+    const size_t src_stride,
+    char * restrict dst,
+    const size_t dst_stride
+){
+  const size_t size_of_element = 4;
+  const size_t block = SDECOMP_INTERNAL_BLOCK_B4;
+  const size_t ib = i0 + (i1 - i0) / block * block;
+  const size_t jb = j0 + (j1 - j0) / block * block;
+  for(size_t i = i0; i < ib; i += block){
+    for(size_t j = j0; j < jb; j += block){
+      block_b4(
+          src + size_of_element * (j * src_stride + i),
+          src_stride,
+          dst + size_of_element * (i * dst_stride + j),
+          dst_stride
+      );
+    }
+  }
+  // remainders
+  tile_scalar(size_of_element, i0, ib, jb, j1, src, src_stride, dst, dst_stride);
+  tile_scalar(size_of_element, ib, i1, j0, j1, src, src_stride, dst, dst_stride);
+}
+
+// transpose a tile of 8-byte elements, block by block
+static void tile_b8(
+    const size_t i0,
+    const size_t i1,
+    const size_t j0,
+    const size_t j1,
+    const char * restrict src,
+    const size_t src_stride,
+    char * restrict dst,
+    const size_t dst_stride
+){
+  const size_t size_of_element = 8;
+  const size_t block = SDECOMP_INTERNAL_BLOCK_B8;
+  const size_t ib = i0 + (i1 - i0) / block * block;
+  const size_t jb = j0 + (j1 - j0) / block * block;
+  for(size_t i = i0; i < ib; i += block){
+    for(size_t j = j0; j < jb; j += block){
+      block_b8(
+          src + size_of_element * (j * src_stride + i),
+          src_stride,
+          dst + size_of_element * (i * dst_stride + j),
+          dst_stride
+      );
+    }
+  }
+  // remainders
+  tile_scalar(size_of_element, i0, ib, jb, j1, src, src_stride, dst, dst_stride);
+  tile_scalar(size_of_element, ib, i1, j0, j1, src, src_stride, dst, dst_stride);
+}
+
+#else
+
+// no SIMD, the compiler is in charge
+
+static void tile_b4(
+    const size_t i0,
+    const size_t i1,
+    const size_t j0,
+    const size_t j1,
+    const char * restrict src,
+    const size_t src_stride,
+    char * restrict dst,
+    const size_t dst_stride
+){
+  tile_scalar(4, i0, i1, j0, j1, src, src_stride, dst, dst_stride);
+}
+
+static void tile_b8(
+    const size_t i0,
+    const size_t i1,
+    const size_t j0,
+    const size_t j1,
+    const char * restrict src,
+    const size_t src_stride,
+    char * restrict dst,
+    const size_t dst_stride
+){
+  tile_scalar(8, i0, i1, j0, j1, src, src_stride, dst, dst_stride);
+}
+
+#endif
+
+// transpose a tile of 16-byte elements,
+//   each of which fills a whole SSE register and thus is moved one by one
+static void tile_b16(
+    const size_t i0,
+    const size_t i1,
+    const size_t j0,
+    const size_t j1,
+    const char * restrict src,
+    const size_t src_stride,
+    char * restrict dst,
+    const size_t dst_stride
+){
+  tile_scalar(16, i0, i1, j0, j1, src, src_stride, dst, dst_stride);
+}
+
+/**
+ * @brief cache-blocked out-of-place transpose
+ * @param[in]  size_of_element : size of each element
+ * @param[in]  ni              : number of columns of src (rows of dst)
+ * @param[in]  nj              : number of rows of src (columns of dst)
+ * @param[in]  src             : (nj x ni) matrix, i is contiguous
+ * @param[in]  src_stride      : distance between two adjacent rows of src
+ * @param[out] dst             : (ni x nj) matrix, j is contiguous
+ * @param[in]  dst_stride      : distance between two adjacent rows of dst
+ */
+void sdecomp_internal_transpose_kernel(
+    const size_t size_of_element,
+    const size_t ni,
+    const size_t nj,
+    const void * restrict src,
+    const size_t src_stride,
+    void * restrict dst,
+    const size_t dst_stride
+){
+  const size_t tile = SDECOMP_INTERNAL_TILE;
+  const char * restrict src_ = src;
+  char * restrict dst_ = dst;
+  for(size_t jj = 0; jj < nj; jj += tile){
+    const size_t jmax = min(jj + tile, nj);
+    for(size_t ii = 0; ii < ni; ii += tile){
+      const size_t imax = min(ii + tile, ni);
+      if(4 == size_of_element){
+        tile_b4(ii, imax, jj, jmax, src_, src_stride, dst_, dst_stride);
+      }else if(8 == size_of_element){
+        tile_b8(ii, imax, jj, jmax, src_, src_stride, dst_, dst_stride);
+      }else if(16 == size_of_element){
+        tile_b16(ii, imax, jj, jmax, src_, src_stride, dst_, dst_stride);
+      }else{
+        tile_scalar(size_of_element, ii, imax, jj, jmax, src_, src_stride, dst_, dst_stride);
+      }
+    }
+  }
+}
+
+/**
+ * @brief pack a chunk to a contiguous buffer
+ * @param[in]  size_of_element : size of each element
+ * @param[in]  chunk           : shape of the chunk in the send buffer
+ * @param[in]  sendbuf         : pointer to the send buffer (whole pencil)
+ * @param[out] packed          : pointer to the packed chunk
+ */
+void sdecomp_internal_transpose_pack(
+    const size_t size_of_element,
+    const sdecomp_internal_transpose_chunk_t * chunk,
+    const void * restrict sendbuf,
+    void * restrict packed
+){
+  const size_t nitems = chunk->ni * chunk->nj;
+  const char * restrict src = sendbuf;
+  char * restrict dst = packed;
+  for(size_t b = 0; b < chunk->nbatch; b++){
+    sdecomp_internal_transpose_kernel(
+        size_of_element,
+        chunk->ni,
+        chunk->nj,
+        src + size_of_element * (chunk->offset + b * chunk->stride_batch),
+        chunk->stride,
+        dst + size_of_element * b * nitems,
+        chunk->nj
+    );
+  }
+}
+
+/**
+ * @brief unpack a chunk from a contiguous buffer
+ * @param[in]  size_of_element : size of each element
+ * @param[in]  chunk           : shape of the chunk in the recv buffer
+ * @param[in]  packed          : pointer to the packed chunk
+ * @param[out] recvbuf         : pointer to the recv buffer (whole pencil)
+ */
+void sdecomp_internal_transpose_unpack(
+    const size_t size_of_element,
+    const sdecomp_internal_transpose_chunk_t * chunk,
+    const void * restrict packed,
+    void * restrict recvbuf
+){
+  const char * restrict src = packed;
+  char * restrict dst = recvbuf;
+  for(size_t b = 0; b < chunk->nbatch; b++){
+    for(size_t i = 0; i < chunk->ni; i++){
+      memcpy(
+          dst + size_of_element * (chunk->offset + b * chunk->stride_batch + i * chunk->stride),
+          src + size_of_element * (b * chunk->ni + i) * chunk->nj,
+          size_of_element * chunk->nj
+      );
+    }
+  }
+}
+
+// narrow a double to the wire format
+// NOTE: bfloat16 is the upper half of float, rounded to the nearest even
+static inline void narrow(
+    const sdecomp_transpose_wire_t wire,
+    const char * restrict src,
+    char * restrict dst
+){
+  double value = 0.;
+  memcpy(&value, src, sizeof(double));
+  const float narrowed = (float)value;
+  if(SDECOMP_TRANSPOSE_WIRE_FP32 == wire){
+    memcpy(dst, &narrowed, sizeof(float));
+    return;
+  }
+  uint32_t bits = 0;
+  memcpy(&bits, &narrowed, sizeof(float));
+  uint16_t upper = 0;
+  if(narrowed != narrowed){
+    // quiet NaN
+    upper = (uint16_t)(bits >> 16 | 0x0040u);
+  }else{
+    upper = (uint16_t)((bits + 0x7fffu + (bits >> 16 & 1u)) >> 16);
+  }
+  memcpy(dst, &upper, sizeof(uint16_t));
+}
+
+// widen an element in the wire format to a double
+static inline void widen(
+    const sdecomp_transpose_wire_t wire,
+    const char * restrict src,
+    char * restrict dst
+){
+  float narrowed = 0.f;
+  if(SDECOMP_TRANSPOSE_WIRE_FP32 == wire){
+    memcpy(&narrowed, src, sizeof(float));
+  }else{
+    uint16_t upper = 0;
+    memcpy(&upper, src, sizeof(uint16_t));
+    const uint32_t bits = (uint32_t)upper << 16;
+    memcpy(&narrowed, &bits, sizeof(float));
+  }
+  const double value = (double)narrowed;
+  memcpy(dst, &value, sizeof(double));
+}
+
+static size_t get_size_of_value(
+    const sdecomp_transpose_wire_t wire
+){
+  return SDECOMP_TRANSPOSE_WIRE_FP32 == wire ? sizeof(float) : sizeof(uint16_t);
+}
+
+/**
+ * @brief pack a chunk to a contiguous buffer, narrowing the elements
+ * @param[in]  wire            : element type on the wire
+ * @param[in]  size_of_element : size of each element (before narrowed)
+ * @param[in]  chunk           : shape of the chunk in the send buffer
+ * @param[in]  sendbuf         : pointer to the send buffer (whole pencil)
+ * @param[out] packed          : pointer to the packed chunk
+ */
+void sdecomp_internal_transpose_pack_wire(
+    const sdecomp_transpose_wire_t wire,
+    const size_t size_of_element,
+    const sdecomp_internal_transpose_chunk_t * chunk,
+    const void * restrict sendbuf,
+    void * restrict packed
+){
+  if(SDECOMP_TRANSPOSE_WIRE_NATIVE == wire){
+    sdecomp_internal_transpose_pack(size_of_element, chunk, sendbuf, packed);
+    return;
+  }
+  // double or double complex
+  const size_t nvalues = size_of_element / sizeof(double);
+  const size_t size_of_value = get_size_of_value(wire);
+  const size_t tile = SDECOMP_INTERNAL_TILE;
+  const char * restrict src = sendbuf;
+  char * restrict dst = packed;
+  for(size_t b = 0; b < chunk->nbatch; b++){
+    const char * restrict src_ = src + size_of_element * (chunk->offset + b * chunk->stride_batch);
+    char * restrict dst_ = dst + size_of_value * nvalues * b * chunk->ni * chunk->nj;
+    for(size_t jj = 0; jj < chunk->nj; jj += tile){
+      const size_t jmax = min(jj + tile, chunk->nj);
+      for(size_t ii = 0; ii < chunk->ni; ii += tile){
+        const size_t imax = min(ii + tile, chunk->ni);
+        for(size_t i = ii; i < imax; i++){
+          for(size_t j = jj; j < jmax; j++){
+            for(size_t v = 0; v < nvalues; v++){
+              narrow(
+                  wire,
+                  src_ + size_of_element * (j * chunk->stride + i) + sizeof(double) * v,
+                  dst_ + size_of_value * (nvalues * (i * chunk->nj + j) + v)
+              );
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+/**
+ * @brief unpack a chunk from a contiguous buffer, widening the elements
+ * @param[in]  wire            : element type on the wire
+ * @param[in]  size_of_element : size of each element (after widened)
+ * @param[in]  chunk           : shape of the chunk in the recv buffer
+ * @param[in]  packed          : pointer to the packed chunk
+ * @param[out] recvbuf         : pointer to the recv buffer (whole pencil)
+ */
+void sdecomp_internal_transpose_unpack_wire(
+    const sdecomp_transpose_wire_t wire,
+    const size_t size_of_element,
+    const sdecomp_internal_transpose_chunk_t * chunk,
+    const void * restrict packed,
+    void * restrict recvbuf
+){
+  if(SDECOMP_TRANSPOSE_WIRE_NATIVE == wire){
+    sdecomp_internal_transpose_unpack(size_of_element, chunk, packed, recvbuf);
+    return;
+  }
+  // double or double complex, contiguous in both buffers
+  const size_t nvalues = size_of_element / sizeof(double);
+  const size_t size_of_value = get_size_of_value(wire);
+  const size_t nitems = nvalues * chunk->nj;
+  const char * restrict src = packed;
+  char * restrict dst = recvbuf;
+  for(size_t b = 0; b < chunk->nbatch; b++){
+    for(size_t i = 0; i < chunk->ni; i++){
+      const char * restrict src_ = src + size_of_value * (b * chunk->ni + i) * nitems;
+      char * restrict dst_ = dst + size_of_element * (chunk->offset + b * chunk->stride_batch + i * chunk->stride);
+      for(size_t n = 0; n < nitems; n++){
+        widen(wire, src_ + size_of_value * n, dst_ + sizeof(double) * n);
+      }
+    }
+  }
+}
+
+// round the elements of a chunk in the recv buffer to the wire format,
+//   as if they were narrowed and widened by the packed buffers
+static void round_wire(
+    const sdecomp_transpose_wire_t wire,
+    const size_t size_of_element,
+    const sdecomp_internal_transpose_chunk_t * chunk,
+    void * restrict recvbuf
+){
+  // double or double complex
+  const size_t nitems = size_of_element / sizeof(double) * chunk->nj;
+  char * restrict dst = recvbuf;
+  for(size_t b = 0; b < chunk->nbatch; b++){
+    for(size_t i = 0; i < chunk->ni; i++){
+      char * restrict dst_ = dst + size_of_element * (chunk->offset + b * chunk->stride_batch + i * chunk->stride);
+      for(size_t n = 0; n < nitems; n++){
+        char narrowed[sizeof(float)] = {0};
+        narrow(wire, dst_ + sizeof(double) * n, narrowed);
+        widen(wire, narrowed, dst_ + sizeof(double) * n);
+      }
+    }
+  }
+}
+
+/**
+ * @brief copy the chunk which I send to myself
+ * @param[in]  plan    : plan
+ * @param[in]  sendbuf : pointer to the send buffer
+ * @param[out] recvbuf : pointer to the recv buffer
+ */
+void sdecomp_internal_transpose_copy_self(
+    const sdecomp_transpose_plan_t * plan,
+    const void * restrict sendbuf,
+    void * restrict recvbuf
+){
+  // NOTE: the send and recv chunks share nbatch, ni and nj,
+  //   and thus each block is transposed directly without packing
+  const size_t size_of_element = plan->size_of_element;
+  const sdecomp_internal_transpose_chunk_t * schunk = plan->schunks + plan->myrank_2d;
+  const sdecomp_internal_transpose_chunk_t * rchunk = plan->rchunks + plan->myrank_2d;
+  for(size_t b = 0; b < schunk->nbatch; b++){
+    sdecomp_internal_transpose_kernel(
+        size_of_element,
+        schunk->ni,
+        schunk->nj,
+        (const char *)sendbuf + size_of_element * (schunk->offset + b * schunk->stride_batch),
+        schunk->stride,
+        (char *)recvbuf + size_of_element * (rchunk->offset + b * rchunk->stride_batch),
+        rchunk->stride
+    );
+  }
+  // NOTE: rounded as the other chunks, so that the results do not depend on
+  //   whether the elements stay in my process
+  if(SDECOMP_TRANSPOSE_WIRE_NATIVE != plan->wire){
+    round_wire(plan->wire, size_of_element, rchunk, recvbuf);
+  }
+}
+
+/**
+ * @brief zero-fill the regions of the recv buffer which no one sends,
+ *          i.e. padding of the pencil after rotated
+ * @param[in]  plan    : plan
+ * @param[out] recvbuf : pointer to the recv buffer
+ */
+void sdecomp_internal_transpose_fill_pads(
+    const sdecomp_transpose_plan_t * plan,
+    void * recvbuf
+){
+  const size_t size_of_element = plan->size_of_element;
+  for(size_t n = 0; n < sizeof(plan->pads) / sizeof(plan->pads[0]); n++){
+    const sdecomp_internal_transpose_chunk_t * pad = plan->pads + n;
+    if(0 == pad->nj) continue;
+    for(size_t b = 0; b < pad->nbatch; b++){
+      for(size_t i = 0; i < pad->ni; i++){
+        char * dst = (char *)recvbuf + size_of_element * (pad->offset + b * pad->stride_batch + i * pad->stride);
+        memset(dst, 0, size_of_element * pad->nj);
+      }
+    }
+  }
+}
+
+#undef SDECOMP_INTERNAL_TILE
+#if defined(SDECOMP_INTERNAL_BLOCK_B4)
+#undef SDECOMP_INTERNAL_BLOCK_B4
+#endif
+#if defined(SDECOMP_INTERNAL_BLOCK_B8)
+#undef SDECOMP_INTERNAL_BLOCK_B8
+#endif
@@ -30,12 +30,42 @@
 #define SDECOMP_INTERNAL_TRANSPOSE
 #include "internal.h"
 
+// engines
+const sdecomp_transpose_engine_t SDECOMP_TRANSPOSE_ENGINE_ALLTOALLW    = 0;
+const sdecomp_transpose_engine_t SDECOMP_TRANSPOSE_ENGINE_ALLTOALLV    = 1;
+const sdecomp_transpose_engine_t SDECOMP_TRANSPOSE_ENGINE_PAIRWISE     = 2;
+const sdecomp_transpose_engine_t SDECOMP_TRANSPOSE_ENGINE_BRUCK        = 3;
+const sdecomp_transpose_engine_t SDECOMP_TRANSPOSE_ENGINE_SHM          = 4;
+const sdecomp_transpose_engine_t SDECOMP_TRANSPOSE_ENGINE_HIERARCHICAL = 5;
+const sdecomp_transpose_engine_t SDECOMP_TRANSPOSE_ENGINE_RMA          = 6;
+const sdecomp_transpose_engine_t SDECOMP_TRANSPOSE_ENGINE_NEIGHBOR     = 7;
+
+// element types on the wire
+const sdecomp_transpose_wire_t SDECOMP_TRANSPOSE_WIRE_NATIVE = 0;
+const sdecomp_transpose_wire_t SDECOMP_TRANSPOSE_WIRE_FP32   = 1;
+const sdecomp_transpose_wire_t SDECOMP_TRANSPOSE_WIRE_BF16   = 2;
+
+// default options of transpose plans
+const sdecomp_transpose_options_t SDECOMP_TRANSPOSE_DEFAULT_OPTIONS = {
+  .engine     = 0, // SDECOMP_TRANSPOSE_ENGINE_ALLTOALLW
+  .persistent = false,
+  .sendbuf    = NULL,
+  .recvbuf    = NULL,
+  .nslabs     = 1,
+  .autotune   = false,
+  .wire       = 0, // SDECOMP_TRANSPOSE_WIRE_NATIVE
+  .compress   = false,
+};
+
 int sdecomp_internal_transpose_allocate(
     const char error_label[],
     const int nprocs_2d,
+    const int myrank_2d,
     sdecomp_transpose_plan_t ** plan
 ){
   *plan = sdecomp_internal_calloc(error_label, 1, sizeof(sdecomp_transpose_plan_t));
+  sdecomp_internal_transpose_chunk_t * schunks = sdecomp_internal_calloc(error_label, (size_t)nprocs_2d, sizeof(sdecomp_internal_transpose_chunk_t));
+  sdecomp_internal_transpose_chunk_t * rchunks = sdecomp_internal_calloc(error_label, (size_t)nprocs_2d, sizeof(sdecomp_internal_transpose_chunk_t));
   int          * scounts = sdecomp_internal_calloc(error_label, (size_t)nprocs_2d, sizeof(         int));
   int          * rcounts = sdecomp_internal_calloc(error_label, (size_t)nprocs_2d, sizeof(         int));
   int          * sdispls = sdecomp_internal_calloc(error_label, (size_t)nprocs_2d, sizeof(         int));
@@ -49,15 +79,54 @@ int sdecomp_internal_transpose_allocate(
   if(NULL == rdispls) return 1;
   if(NULL ==  stypes) return 1;
   if(NULL ==  rtypes) return 1;
+  if(NULL == schunks) return 1;
+  if(NULL == rchunks) return 1;
+  (*plan)->nprocs_2d = nprocs_2d;
+  (*plan)->myrank_2d = myrank_2d;
   (*plan)->scounts = scounts;
   (*plan)->rcounts = rcounts;
   (*plan)->sdispls = sdispls;
   (*plan)->rdispls = rdispls;
   (*plan)->stypes  = stypes;
   (*plan)->rtypes  = rtypes;
+  (*plan)->schunks = schunks;
+  (*plan)->rchunks = rchunks;
+  (*plan)->elemtype = MPI_DATATYPE_NULL;
+  (*plan)->persistent_request = MPI_REQUEST_NULL;
+  (*plan)->nslabs = 1;
+  (*plan)->comm_node = MPI_COMM_NULL;
+  (*plan)->node_win = MPI_WIN_NULL;
+  for(size_t n = 0; n < sizeof((*plan)->rma_wins) / sizeof((*plan)->rma_wins[0]); n++){
+    (*plan)->rma_wins[n] = MPI_WIN_NULL;
+  }
+  (*plan)->rma_staging_win = MPI_WIN_NULL;
+  (*plan)->rma_origin_group = MPI_GROUP_NULL;
+  (*plan)->rma_target_group = MPI_GROUP_NULL;
+  (*plan)->comm_graph = MPI_COMM_NULL;
   return 0;
 }
 
+/**
+ * @brief get the range of batches of a slab
+ * @param[in]  plan   : transpose plan
+ * @param[in]  slab   : index of the slab
+ * @param[out] offset : index of the first batch
+ * @param[out] nbatch : number of batches
+ */
+void sdecomp_internal_transpose_get_slab(
+    const sdecomp_transpose_plan_t * plan,
+    const size_t slab,
+    size_t * offset,
+    size_t * nbatch
+){
+  const char error_label[] = {"sdecomp.transpose.get_slab"};
+  // NOTE: the slabs are distributed in the same manner as the uniform pencils,
+  //   nslabs is no larger than the number of batches and thus no error is expected
+  const size_t total = plan->schunks[0].nbatch;
+  sdecomp_internal_kernel_get_offset(error_label, NULL, total, (int)plan->nslabs, (int)slab, offset);
+  sdecomp_internal_kernel_get_mysize(error_label, NULL, total, (int)plan->nslabs, (int)slab, nbatch);
+}
+
 int sdecomp_internal_transpose_deallocate(
     sdecomp_transpose_plan_t * plan
 ){
@@ -67,10 +136,153 @@ int sdecomp_internal_transpose_deallocate(
   sdecomp_internal_free(plan->rdispls);
   sdecomp_internal_free(plan->stypes);
   sdecomp_internal_free(plan->rtypes);
+  sdecomp_internal_free(plan->schunks);
+  sdecomp_internal_free(plan->rchunks);
   sdecomp_internal_free(plan);
   return 0;
 }
 
+/**
+ * @brief shift a data type by the given number of bytes
+ * @param[in]     nbytes : shift in bytes
+ * @param[in,out] type   : (in)  data type to be shifted, which is freed
+ *                         (out) shifted and committed data type
+ * @return               : (success) 0
+ *                         (failure) non-zero value
+ */
+// NOTE: displacements of the collectives are int, which overflow
+//   once a pencil exceeds 2 GiB, while those of the data types are MPI_Aint
+//   thus the offsets of the chunks are embedded in the data types,
+//   and the displacements passed to the collectives are zero
+int sdecomp_internal_transpose_shift_type(
+    const size_t nbytes,
+    MPI_Datatype * type
+){
+  const int blocklength = 1;
+  const MPI_Aint displacement = (MPI_Aint)nbytes;
+  MPI_Datatype shifted = MPI_DATATYPE_NULL;
+  MPI_Type_create_struct(1, &blocklength, &displacement, type, &shifted);
+  MPI_Type_commit(&shifted);
+  MPI_Type_free(type);
+  *type = shifted;
+  return 0;
+}
+
+/**
+ * @brief restrict a range to the leading part of a dimension
+ * @param[in]     extent : size of the leading part
+ * @param[in]     offset : beginning of the range
+ * @param[in,out] size   : (in)  size of the range
+ *                         (out) size of the range within the leading part
+ * @return               : (success) 0
+ *                         (failure) non-zero value
+ */
+// NOTE: global sizes of the pencils before and after a rotation may differ
+//   (see sdecomp.transpose.construct_resized),
+//   in which case only the part common to both pencils is exchanged
+int sdecomp_internal_transpose_clip(
+    const size_t extent,
+    const size_t offset,
+    size_t * size
+){
+  if(extent <= offset){
+    *size = 0;
+  }else if(extent - offset < *size){
+    *size = extent - offset;
+  }
+  return 0;
+}
+
+static const sdecomp_internal_transpose_engine_t * select_engine(
+    const sdecomp_transpose_engine_t engine
+){
+  if(SDECOMP_TRANSPOSE_ENGINE_ALLTOALLV == engine){
+    return &sdecomp_internal_transpose_engine_alltoallv;
+  }else if(SDECOMP_TRANSPOSE_ENGINE_PAIRWISE == engine){
+    return &sdecomp_internal_transpose_engine_pairwise;
+  }else if(SDECOMP_TRANSPOSE_ENGINE_BRUCK == engine){
+    return &sdecomp_internal_transpose_engine_bruck;
+  }else if(SDECOMP_TRANSPOSE_ENGINE_SHM == engine){
+    return &sdecomp_internal_transpose_engine_shm;
+  }else if(SDECOMP_TRANSPOSE_ENGINE_HIERARCHICAL == engine){
+    return &sdecomp_internal_transpose_engine_hierarchical;
+  }else if(SDECOMP_TRANSPOSE_ENGINE_RMA == engine){
+    return &sdecomp_internal_transpose_engine_rma;
+  }else if(SDECOMP_TRANSPOSE_ENGINE_NEIGHBOR == engine){
+    return &sdecomp_internal_transpose_engine_neighbor;
+  }else{
+    return &sdecomp_internal_transpose_engine_alltoallw;
+  }
+}
+
+static int construct(
+    const char error_label[],
+    const sdecomp_info_t * info,
+    const sdecomp_pencil_t pencil_bef,
+    const sdecomp_pencil_t pencil_aft,
+    const size_t * glsizes_bef,
+    const size_t * glsizes_aft,
+    const size_t size_of_element,
+    const sdecomp_transpose_options_t * options,
+    sdecomp_transpose_plan_t ** plan
+){
+  if(0 != sdecomp_internal_sanitise_null(error_label,        "plan",        plan)) return 1;
+  *plan = NULL;
+  if(0 != sdecomp_internal_sanitise_null(error_label,        "info",        info)) return 1;
+  if(0 != sdecomp_internal_sanitise_null(error_label, "glsizes_bef", glsizes_bef)) return 1;
+  if(0 != sdecomp_internal_sanitise_null(error_label, "glsizes_aft", glsizes_aft)) return 1;
+  if(0 != sdecomp_internal_sanitise_null(error_label,     "options",     options)) return 1;
+  const size_t ndims = info->ndims;
+  bool is_resized = false;
+  for(size_t dim = 0; dim < ndims; dim++){
+    if(0 != sdecomp_internal_sanitise_glsize(error_label, glsizes_bef[dim])) return 1;
+    if(0 != sdecomp_internal_sanitise_glsize(error_label, glsizes_aft[dim])) return 1;
+    if(glsizes_bef[dim] != glsizes_aft[dim]) is_resized = true;
+  }
+  if(0 != sdecomp_internal_sanitise_glsizes_pair(error_label, ndims, pencil_bef, pencil_aft, glsizes_bef, glsizes_aft)) return 1;
+  if(0 != sdecomp_internal_sanitise_size_of_element(error_label, size_of_element)) return 1;
+  if(0 != sdecomp_internal_sanitise_engine(error_label, options->engine)) return 1;
+  if(0 != sdecomp_internal_sanitise_nslabs(error_label, options->nslabs, options->persistent)) return 1;
+  // engine and nslabs are replaced by the tuned ones
+  sdecomp_transpose_options_t tuned = *options;
+  if(options->autotune){
+    if(0 != sdecomp_internal_transpose_autotune(error_label, info, pencil_bef, pencil_aft, glsizes_bef, glsizes_aft, size_of_element, options, &tuned)) return 1;
+    options = &tuned;
+  }
+  if(0 != sdecomp_internal_sanitise_engine_features(error_label, options->engine, options->nslabs, options->persistent)) return 1;
+  if(0 != sdecomp_internal_sanitise_wire(error_label, options->wire, options->engine, size_of_element)) return 1;
+  if(0 != sdecomp_internal_sanitise_compress(error_label, options->compress, options->engine, options->nslabs, options->persistent)) return 1;
+  if(2 == ndims){
+    if(0 != sdecomp_internal_transpose_init_2d(error_label, info, pencil_bef, pencil_aft, glsizes_bef, glsizes_aft, size_of_element, plan)) return 1;
+  }else{
+    if(0 != sdecomp_internal_transpose_init_3d(error_label, info, pencil_bef, pencil_aft, glsizes_bef, glsizes_aft, size_of_element, plan)) return 1;
+  }
+  (*plan)->size_of_element = size_of_element;
+  (*plan)->is_resized = is_resized;
+  // chunks exchanged through the packed buffers are narrowed to the wire format
+  (*plan)->wire = options->wire;
+  if(SDECOMP_TRANSPOSE_WIRE_FP32 == options->wire){
+    (*plan)->packed_size_of_element = size_of_element / sizeof(double) * sizeof(float);
+  }else if(SDECOMP_TRANSPOSE_WIRE_BF16 == options->wire){
+    (*plan)->packed_size_of_element = size_of_element / sizeof(double) * sizeof(uint16_t);
+  }else{
+    (*plan)->packed_size_of_element = size_of_element;
+  }
+  (*plan)->compress = options->compress;
+  // the chunk which I send to myself does not go through the MPI library
+  //   but is directly copied by the engines,
+  //   see sdecomp_internal_transpose_copy_self
+  (*plan)->scounts[(*plan)->myrank_2d] = 0;
+  (*plan)->rcounts[(*plan)->myrank_2d] = 0;
+  // the number of batches of all chunks is the extent of the unchanged dimension
+  //   (1 for 2D), which limits the number of slabs
+  const size_t nbatch = (*plan)->schunks[0].nbatch;
+  (*plan)->nslabs = options->nslabs < nbatch ? options->nslabs : nbatch;
+  (*plan)->engine = select_engine(options->engine);
+  if(0 != (*plan)->engine->init(error_label, options, *plan)) return 1;
+  return 0;
+}
+
 /**
  * @brief initialise transpose plan
  * @param[in]  info            : struct contains information of process distribution
@@ -91,24 +303,116 @@ int sdecomp_internal_transpose_construct(
     const size_t size_of_element,
     sdecomp_transpose_plan_t ** plan
 ){
-  *plan = NULL;
   const char error_label[] = {"sdecomp.transpose.construct"};
-  if(0 != sdecomp_internal_sanitise_null(error_label,    "info",    info)) return 1;
-  if(0 != sdecomp_internal_sanitise_null(error_label, "glsizes", glsizes)) return 1;
-  if(0 != sdecomp_internal_sanitise_null(error_label,    "plan",    plan)) return 1;
-  const size_t ndims = info->ndims;
+  const sdecomp_transpose_options_t * options = &SDECOMP_TRANSPOSE_DEFAULT_OPTIONS;
+  return construct(error_label, info, pencil_bef, pencil_aft, glsizes, glsizes, size_of_element, options, plan);
+}
+
+/**
+ * @brief initialise transpose plan with options
+ * @param[in]  info            : struct contains information of process distribution
+ * @param[in]  pencil_bef      : type of pencil before rotated
+ * @param[in]  pencil_aft      : type of pencil after  rotated
+ * @param[in]  glsizes         : global array size in each dimension
+ * @param[in]  size_of_element : size of each element, e.g. sizeof(double)
+ * @param[in]  options         : options, see sdecomp_transpose_options_t
+ * @param[out] plan            : (success) a pointer to the created plan (struct)
+ *                               (failure) undefined
+ * @return                     : (success) 0
+ *                               (failure) non-zero value
+ */
+int sdecomp_internal_transpose_construct_with_options(
+    const sdecomp_info_t * info,
+    const sdecomp_pencil_t pencil_bef,
+    const sdecomp_pencil_t pencil_aft,
+    const size_t * glsizes,
+    const size_t size_of_element,
+    const sdecomp_transpose_options_t * options,
+    sdecomp_transpose_plan_t ** plan
+){
+  const char error_label[] = {"sdecomp.transpose.construct_with_options"};
+  return construct(error_label, info, pencil_bef, pencil_aft, glsizes, glsizes, size_of_element, options, plan);
+}
+
+// regroup the elements in the contiguous direction of a pencil into larger ones,
+//   e.g. pairs of real numbers into complex numbers
+static int regroup_glsizes(
+    const char error_label[],
+    const size_t ndims,
+    const sdecomp_pencil_t pencil,
+    const size_t * glsizes,
+    const size_t size_of_element,
+    const size_t size_of_group,
+    size_t * regrouped
+){
   for(size_t dim = 0; dim < ndims; dim++){
-    if(0 != sdecomp_internal_sanitise_glsize(error_label, glsizes[dim])) return 1;
+    regrouped[dim] = glsizes[dim];
   }
-  if(0 != sdecomp_internal_sanitise_size_of_element(error_label, size_of_element)) return 1;
-  if(2 == ndims){
-    if(0 != sdecomp_internal_transpose_init_2d(error_label, info, pencil_bef, pencil_aft, glsizes, size_of_element, plan)) return 1;
-  }else{
-    if(0 != sdecomp_internal_transpose_init_3d(error_label, info, pencil_bef, pencil_aft, glsizes, size_of_element, plan)) return 1;
+  if(size_of_element == size_of_group) return 0;
+  // x1, x2 -> 0, y1, y2 -> 1, z1, z2 -> 2
+  const size_t dim = (size_t)pencil % 3;
+  const size_t nbytes = size_of_element * glsizes[dim];
+  if(0 != size_of_group % size_of_element || 0 != nbytes % size_of_group){
+    SDECOMP_ERROR(
+        "%zu elements of %zu bytes cannot be regrouped into elements of %zu bytes\n",
+        error_label, glsizes[dim], size_of_element, size_of_group
+    );
+    return 1;
   }
+  regrouped[dim] = nbytes / size_of_group;
   return 0;
 }
 
+/**
+ * @brief initialise transpose plan whose pencils have different global sizes and element sizes
+ * @param[in]  info                : struct contains information of process distribution
+ * @param[in]  pencil_bef          : type of pencil before rotated
+ * @param[in]  pencil_aft          : type of pencil after  rotated
+ * @param[in]  glsizes_bef         : global array size in each dimension, before rotated
+ * @param[in]  glsizes_aft         : global array size in each dimension, after  rotated
+ * @param[in]  size_of_element_bef : size of each element before rotated, e.g. sizeof(double)
+ * @param[in]  size_of_element_aft : size of each element after  rotated, e.g. sizeof(double complex)
+ * @param[in]  options             : options, see sdecomp_transpose_options_t
+ * @param[out] plan                : (success) a pointer to the created plan (struct)
+ *                                   (failure) undefined
+ * @return                         : (success) 0
+ *                                   (failure) non-zero value
+ */
+// NOTE: only the leading part common to both pencils is exchanged,
+//   i.e. the pencil after rotated is truncated or zero-padded in the rotated directions
+// NOTE: the pencil having smaller elements is regarded as the one having larger elements,
+//   which are formed by the adjacent elements in its contiguous direction
+//   (e.g. complex numbers stored in a real array after an in-place r2c transform)
+int sdecomp_internal_transpose_construct_resized(
+    const sdecomp_info_t * info,
+    const sdecomp_pencil_t pencil_bef,
+    const sdecomp_pencil_t pencil_aft,
+    const size_t * glsizes_bef,
+    const size_t * glsizes_aft,
+    const size_t size_of_element_bef,
+    const size_t size_of_element_aft,
+    const sdecomp_transpose_options_t * options,
+    sdecomp_transpose_plan_t ** plan
+){
+  const char error_label[] = {"sdecomp.transpose.construct_resized"};
+  if(0 != sdecomp_internal_sanitise_null(error_label,        "plan",        plan)) return 1;
+  *plan = NULL;
+  if(0 != sdecomp_internal_sanitise_null(error_label,        "info",        info)) return 1;
+  if(0 != sdecomp_internal_sanitise_null(error_label, "glsizes_bef", glsizes_bef)) return 1;
+  if(0 != sdecomp_internal_sanitise_null(error_label, "glsizes_aft", glsizes_aft)) return 1;
+  const size_t ndims = info->ndims;
+  if(0 != sdecomp_internal_sanitise_pencil(error_label, ndims, pencil_bef)) return 1;
+  if(0 != sdecomp_internal_sanitise_pencil(error_label, ndims, pencil_aft)) return 1;
+  if(0 != sdecomp_internal_sanitise_size_of_element(error_label, size_of_element_bef)) return 1;
+  if(0 != sdecomp_internal_sanitise_size_of_element(error_label, size_of_element_aft)) return 1;
+  const size_t size_of_element = size_of_element_bef < size_of_element_aft ? size_of_element_aft : size_of_element_bef;
+  size_t regrouped_bef[3] = {0};
+  size_t regrouped_aft[3] = {0};
+  if(0 != regroup_glsizes(error_label, ndims, pencil_bef, glsizes_bef, size_of_element_bef, size_of_element, regrouped_bef)) return 1;
+  if(0 != regroup_glsizes(error_label, ndims, pencil_aft, glsizes_aft, size_of_element_aft, size_of_element, regrouped_aft)) return 1;
+  return construct(error_label, info, pencil_bef, pencil_aft, regrouped_bef, regrouped_aft, size_of_element, options, plan);
+}
+
 /**
  * @brief execute transpose
  * @param[in]  plan    : transpose plan initialised by constructor
@@ -126,18 +430,140 @@ int sdecomp_internal_transpose_execute(
   if(0 != sdecomp_internal_sanitise_null(error_label,    "plan",    plan)) return 1;
   if(0 != sdecomp_internal_sanitise_null(error_label, "sendbuf", sendbuf)) return 1;
   if(0 != sdecomp_internal_sanitise_null(error_label, "recvbuf", recvbuf)) return 1;
-  const int * restrict scounts = plan->scounts;
-  const int * restrict rcounts = plan->rcounts;
-  const int * restrict sdispls = plan->sdispls;
-  const int * restrict rdispls = plan->rdispls;
-  const MPI_Datatype * restrict stypes = plan->stypes;
-  const MPI_Datatype * restrict rtypes = plan->rtypes;
-  MPI_Comm comm_2d = plan->comm_2d;
-  MPI_Alltoallw(
-      sendbuf, scounts, sdispls, stypes,
-      recvbuf, rcounts, rdispls, rtypes,
-      comm_2d
-  );
+  sdecomp_internal_transpose_fill_pads(plan, recvbuf);
+  return plan->engine->execute(plan, sendbuf, recvbuf);
+}
+
+/**
+ * @brief execute transpose in place
+ * @param[in]     plan : transpose plan initialised by constructor
+ * @param[in,out] buf  : (in)  pointer to the input  pencil
+ *                       (out) pointer to the output pencil
+ * @return             : (success) 0
+ *                       (failure) non-zero value
+ */
+int sdecomp_internal_transpose_execute_inplace(
+    sdecomp_transpose_plan_t * plan,
+    void * buf
+){
+  const char error_label[] = {"sdecomp.transpose.execute_inplace"};
+  if(0 != sdecomp_internal_sanitise_null(error_label, "plan", plan)) return 1;
+  if(0 != sdecomp_internal_sanitise_null(error_label,  "buf",  buf)) return 1;
+  // the chunks should tile both pencils, which are swapped in the buffer
+  if(plan->is_resized){
+    SDECOMP_ERROR(
+        "in-place rotation is not available for plans whose global sizes differ\n",
+        error_label
+    );
+    return 1;
+  }
+  return sdecomp_internal_transpose_inplace(error_label, plan, buf);
+}
+
+/**
+ * @brief execute transposes of several fields in one collective
+ * @param[in]  plan     : transpose plan initialised by constructor
+ * @param[in]  nfields  : number of fields
+ * @param[in]  sendbufs : pointers to the input  buffers (nfields)
+ * @param[out] recvbufs : pointers to the output buffers (nfields)
+ * @return              : (success) 0
+ *                        (failure) non-zero value
+ */
+int sdecomp_internal_transpose_execute_batch(
+    sdecomp_transpose_plan_t * restrict plan,
+    const size_t nfields,
+    const void * const * sendbufs,
+    void * const * recvbufs
+){
+  const char error_label[] = {"sdecomp.transpose.execute_batch"};
+  if(0 != sdecomp_internal_sanitise_null(error_label,     "plan",     plan)) return 1;
+  if(0 != sdecomp_internal_sanitise_null(error_label, "sendbufs", sendbufs)) return 1;
+  if(0 != sdecomp_internal_sanitise_null(error_label, "recvbufs", recvbufs)) return 1;
+  for(size_t n = 0; n < nfields; n++){
+    if(0 != sdecomp_internal_sanitise_null(error_label, "sendbufs[n]", sendbufs[n])) return 1;
+    if(0 != sdecomp_internal_sanitise_null(error_label, "recvbufs[n]", recvbufs[n])) return 1;
+  }
+  if(0 == nfields) return 0;
+  for(size_t n = 0; n < nfields; n++){
+    sdecomp_internal_transpose_fill_pads(plan, recvbufs[n]);
+  }
+  return plan->engine->execute_batch(error_label, plan, nfields, sendbufs, recvbufs);
+}
+
+/**
+ * @brief initiate non-blocking transpose
+ * @param[in]  plan    : transpose plan initialised by constructor
+ * @param[in]  sendbuf : pointer to the input  buffer
+ * @param[out] recvbuf : pointer to the output buffer
+ *                         (not to be accessed until completed)
+ * @param[out] request : (success) a pointer to the on-going transpose
+ *                       (failure) NULL pointer
+ * @return             : (success) 0
+ *                       (failure) non-zero value
+ */
+int sdecomp_internal_transpose_start(
+    sdecomp_transpose_plan_t * plan,
+    const void * restrict sendbuf,
+    void * restrict recvbuf,
+    sdecomp_transpose_request_t ** request
+){
+  const char error_label[] = {"sdecomp.transpose.start"};
+  if(0 != sdecomp_internal_sanitise_null(error_label, "request", request)) return 1;
+  *request = NULL;
+  if(0 != sdecomp_internal_sanitise_null(error_label,    "plan",    plan)) return 1;
+  if(0 != sdecomp_internal_sanitise_null(error_label, "sendbuf", sendbuf)) return 1;
+  if(0 != sdecomp_internal_sanitise_null(error_label, "recvbuf", recvbuf)) return 1;
+  // each on-going transpose has its own request,
+  //   so that one plan can be shared by several rotations at the same time
+  *request = sdecomp_internal_calloc(error_label, 1, sizeof(sdecomp_transpose_request_t));
+  if(NULL == *request) return 1;
+  (*request)->plan = plan;
+  (*request)->recvbuf = recvbuf;
+  (*request)->window = MPI_WIN_NULL;
+  (*request)->is_completed = false;
+  // NOTE: no one touches the padding during the rotation
+  sdecomp_internal_transpose_fill_pads(plan, recvbuf);
+  return plan->engine->start(error_label, plan, sendbuf, recvbuf, *request);
+}
+
+/**
+ * @brief check whether non-blocking transpose is completed
+ * @param[in,out] request : on-going transpose initiated by sdecomp.transpose.start
+ * @param[out]    flag    : (success) true if completed, false otherwise
+ *                          (failure) undefined
+ * @return                : (success) 0
+ *                          (failure) non-zero value
+ */
+int sdecomp_internal_transpose_test(
+    sdecomp_transpose_request_t * request,
+    bool * flag
+){
+  const char error_label[] = {"sdecomp.transpose.test"};
+  if(0 != sdecomp_internal_sanitise_null(error_label, "request", request)) return 1;
+  if(0 != sdecomp_internal_sanitise_null(error_label,    "flag",    flag)) return 1;
+  if(request->is_completed){
+    *flag = true;
+    return 0;
+  }
+  return request->plan->engine->test(request, flag);
+}
+
+/**
+ * @brief complete non-blocking transpose and clean-up request
+ * @param[in,out] request : on-going transpose initiated by sdecomp.transpose.start,
+ *                            which is no longer valid after this call
+ * @return                : (success) 0
+ *                          (failure) non-zero value
+ */
+int sdecomp_internal_transpose_wait(
+    sdecomp_transpose_request_t * request
+){
+  const char error_label[] = {"sdecomp.transpose.wait"};
+  if(0 != sdecomp_internal_sanitise_null(error_label, "request", request)) return 1;
+  if(!request->is_completed){
+    if(0 != request->plan->engine->wait(request)) return 1;
+  }
+  sdecomp_internal_free(request);
   return 0;
 }
 
@@ -152,9 +578,11 @@ int sdecomp_internal_transpose_destruct(
 ){
   const char error_label[] = {"sdecomp.transpose.destruct"};
   if(0 != sdecomp_internal_sanitise_null(error_label, "plan", plan)) return 1;
+  // free engine-specific resources,
+  //   which may refer to the data types and the communicator below
+  plan->engine->finalise(plan);
   // type-free data types used by all-to-allw
-  int nprocs_2d = 0;
-  MPI_Comm_size(plan->comm_2d, &nprocs_2d);
+  const int nprocs_2d = plan->nprocs_2d;
   for(int n = 0; n < nprocs_2d; n++){
     MPI_Type_free(&plan->stypes[n]);
     MPI_Type_free(&plan->rtypes[n]);
@@ -0,0 +1,285 @@
+/*
+ * Copyright 2022 Naoki Hori
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// https://github.com/NaokiHori/SimpleDecomp
+
+// engine using a distributed graph topology and MPI_Neighbor_alltoallw,
+//   in which the processes exchanging chunks with each other are declared
+//   so that the MPI library can optimise the pattern and rank placement
+// NOTE: the graph is weighted by the sizes of the chunks,
+//   and reordering of the ranks is allowed
+
+#include <stdbool.h>
+#include <limits.h>
+#include <mpi.h>
+#include "sdecomp.h"
+#define SDECOMP_INTERNAL
+#include "../internal.h"
+#define SDECOMP_INTERNAL_TRANSPOSE
+#include "internal.h"
+
+static size_t get_count(
+    const sdecomp_internal_transpose_chunk_t * chunk
+){
+  return chunk->nbatch * chunk->ni * chunk->nj;
+}
+
+// chunk sizes as edge weights, which are saturated
+static int get_weight(
+    const sdecomp_internal_transpose_chunk_t * chunk
+){
+  const size_t count = get_count(chunk);
+  return (size_t)INT_MAX < count ? INT_MAX : (int)count;
+}
+
+static int init(
+    const char error_label[],
+    const sdecomp_transpose_options_t * options,
+    sdecomp_transpose_plan_t * plan
+){
+  (void)options;
+  plan->is_persistent = false;
+  plan->sendbuf = NULL;
+  plan->recvbuf = NULL;
+  plan->persistent_request = MPI_REQUEST_NULL;
+  const int nprocs = plan->nprocs_2d;
+  const int myrank = plan->myrank_2d;
+  // sources / destinations, from / to which non-empty chunks are received / sent
+  //   my own chunk is copied directly, see sdecomp_internal_transpose_copy_self
+  // NOTE: counts are unity, since the offsets are described by the data types,
+  //   and thus the chunks themselves are checked
+  int nsources = 0;
+  int ndestinations = 0;
+  for(int n = 0; n < nprocs; n++){
+    if(myrank == n) continue;
+    if(0 != get_count(plan->rchunks + n)) nsources += 1;
+    if(0 != get_count(plan->schunks + n)) ndestinations += 1;
+  }
+  plan->nsources = nsources;
+  plan->ndestinations = ndestinations;
+  // NOTE: nothing is allocated in a direction without neighbours (e.g. alone),
+  //   in which case NULL and MPI_WEIGHTS_EMPTY are given to the MPI library
+  int * sweights = NULL;
+  int * rweights = NULL;
+  if(0 < nsources){
+    plan->sources     = sdecomp_internal_calloc(error_label, (size_t)nsources, sizeof(         int));
+    plan->nbr_rcounts = sdecomp_internal_calloc(error_label, (size_t)nsources, sizeof(         int));
+    plan->nbr_rdispls = sdecomp_internal_calloc(error_label, (size_t)nsources, sizeof(    MPI_Aint));
+    plan->nbr_rtypes  = sdecomp_internal_calloc(error_label, (size_t)nsources, sizeof(MPI_Datatype));
+    rweights = sdecomp_internal_calloc(error_label, (size_t)nsources, sizeof(int));
+    if(NULL == plan->sources    ) return 1;
+    if(NULL == plan->nbr_rcounts) return 1;
+    if(NULL == plan->nbr_rdispls) return 1;
+    if(NULL == plan->nbr_rtypes ) return 1;
+    if(NULL ==          rweights) return 1;
+  }
+  if(0 < ndestinations){
+    plan->destinations = sdecomp_internal_calloc(error_label, (size_t)ndestinations, sizeof(         int));
+    plan->nbr_scounts  = sdecomp_internal_calloc(error_label, (size_t)ndestinations, sizeof(         int));
+    plan->nbr_sdispls  = sdecomp_internal_calloc(error_label, (size_t)ndestinations, sizeof(    MPI_Aint));
+    plan->nbr_stypes   = sdecomp_internal_calloc(error_label, (size_t)ndestinations, sizeof(MPI_Datatype));
+    sweights = sdecomp_internal_calloc(error_label, (size_t)ndestinations, sizeof(int));
+    if(NULL == plan->destinations) return 1;
+    if(NULL == plan->nbr_scounts ) return 1;
+    if(NULL == plan->nbr_sdispls ) return 1;
+    if(NULL == plan->nbr_stypes  ) return 1;
+    if(NULL ==           sweights) return 1;
+  }
+  for(int n = 0, m = 0; n < nprocs; n++){
+    if(myrank == n) continue;
+    if(0 == get_count(plan->rchunks + n)) continue;
+    plan->sources    [m] = n;
+    plan->nbr_rcounts[m] = plan->rcounts[n];
+    plan->nbr_rdispls[m] = (MPI_Aint)plan->rdispls[n];
+    plan->nbr_rtypes [m] = plan->rtypes[n];
+    rweights[m] = get_weight(plan->rchunks + n);
+    m += 1;
+  }
+  for(int n = 0, m = 0; n < nprocs; n++){
+    if(myrank == n) continue;
+    if(0 == get_count(plan->schunks + n)) continue;
+    plan->destinations[m] = n;
+    plan->nbr_scounts [m] = plan->scounts[n];
+    plan->nbr_sdispls [m] = (MPI_Aint)plan->sdispls[n];
+    plan->nbr_stypes  [m] = plan->stypes[n];
+    sweights[m] = get_weight(plan->schunks + n);
+    m += 1;
+  }
+  // NOTE: the neighbours are given as the ranks in comm_2d,
+  //   and the order of them is kept by the neighbourhood collectives
+  //   even if the ranks are reordered
+  MPI_Dist_graph_create_adjacent(
+      plan->comm_2d,
+      nsources, plan->sources, 0 == nsources ? MPI_WEIGHTS_EMPTY : rweights,
+      ndestinations, plan->destinations, 0 == ndestinations ? MPI_WEIGHTS_EMPTY : sweights,
+      MPI_INFO_NULL,
+      1,
+      &plan->comm_graph
+  );
+  sdecomp_internal_free(sweights);
+  sdecomp_internal_free(rweights);
+  return 0;
+}
+
+static int execute(
+    sdecomp_transpose_plan_t * plan,
+    const void * sendbuf,
+    void * recvbuf
+){
+  // my own chunk is processed while the others are on the fly
+  MPI_Request request = MPI_REQUEST_NULL;
+  MPI_Ineighbor_alltoallw(
+      sendbuf, plan->nbr_scounts, plan->nbr_sdispls, plan->nbr_stypes,
+      recvbuf, plan->nbr_rcounts, plan->nbr_rdispls, plan->nbr_rtypes,
+      plan->comm_graph,
+      &request
+  );
+  sdecomp_internal_transpose_copy_self(plan, sendbuf, recvbuf);
+  MPI_Wait(&request, MPI_STATUS_IGNORE);
+  return 0;
+}
+
+static int execute_batch(
+    const char error_label[],
+    sdecomp_transpose_plan_t * plan,
+    const size_t nfields,
+    const void * const * sendbufs,
+    void * const * recvbufs
+){
+  const int nprocs = plan->nprocs_2d;
+  const int nsources = plan->nsources;
+  const int ndestinations = plan->ndestinations;
+  MPI_Datatype * stypes = sdecomp_internal_calloc(error_label, (size_t)nprocs, sizeof(MPI_Datatype));
+  MPI_Datatype * rtypes = sdecomp_internal_calloc(error_label, (size_t)nprocs, sizeof(MPI_Datatype));
+  if(NULL ==     stypes) return 1;
+  if(NULL ==     rtypes) return 1;
+  // NOTE: nothing is allocated in a direction without neighbours, see init
+  MPI_Datatype * nbr_stypes = NULL;
+  MPI_Datatype * nbr_rtypes = NULL;
+  MPI_Aint * sdispls = NULL;
+  MPI_Aint * rdispls = NULL;
+  if(0 < nsources){
+    nbr_rtypes = sdecomp_internal_calloc(error_label, (size_t)nsources, sizeof(MPI_Datatype));
+    rdispls = sdecomp_internal_calloc(error_label, (size_t)nsources, sizeof(MPI_Aint));
+    if(NULL == nbr_rtypes) return 1;
+    if(NULL ==    rdispls) return 1;
+  }
+  if(0 < ndestinations){
+    nbr_stypes = sdecomp_internal_calloc(error_label, (size_t)ndestinations, sizeof(MPI_Datatype));
+    sdispls = sdecomp_internal_calloc(error_label, (size_t)ndestinations, sizeof(MPI_Aint));
+    if(NULL == nbr_stypes) return 1;
+    if(NULL ==    sdispls) return 1;
+  }
+  if(0 != sdecomp_internal_transpose_create_batch_types(error_label, plan, nfields, sendbufs, recvbufs, stypes, rtypes)) return 1;
+  for(int m = 0; m < nsources; m++){
+    nbr_rtypes[m] = rtypes[plan->sources[m]];
+  }
+  for(int m = 0; m < ndestinations; m++){
+    nbr_stypes[m] = stypes[plan->destinations[m]];
+  }
+  MPI_Request request = MPI_REQUEST_NULL;
+  MPI_Ineighbor_alltoallw(
+      MPI_BOTTOM, plan->nbr_scounts, sdispls, nbr_stypes,
+      MPI_BOTTOM, plan->nbr_rcounts, rdispls, nbr_rtypes,
+      plan->comm_graph,
+      &request
+  );
+  for(size_t f = 0; f < nfields; f++){
+    sdecomp_internal_transpose_copy_self(plan, sendbufs[f], recvbufs[f]);
+  }
+  MPI_Wait(&request, MPI_STATUS_IGNORE);
+  for(int n = 0; n < nprocs; n++){
+    MPI_Type_free(stypes + n);
+    MPI_Type_free(rtypes + n);
+  }
+  sdecomp_internal_free(stypes);
+  sdecomp_internal_free(rtypes);
+  sdecomp_internal_free(nbr_stypes);
+  sdecomp_internal_free(nbr_rtypes);
+  sdecomp_internal_free(sdispls);
+  sdecomp_internal_free(rdispls);
+  return 0;
+}
+
+static int start(
+    const char error_label[],
+    sdecomp_transpose_plan_t * plan,
+    const void * sendbuf,
+    void * recvbuf,
+    sdecomp_transpose_request_t * request
+){
+  (void)error_label;
+  request->handle = &request->request;
+  MPI_Ineighbor_alltoallw(
+      sendbuf, plan->nbr_scounts, plan->nbr_sdispls, plan->nbr_stypes,
+      recvbuf, plan->nbr_rcounts, plan->nbr_rdispls, plan->nbr_rtypes,
+      plan->comm_graph,
+      request->handle
+  );
+  sdecomp_internal_transpose_copy_self(plan, sendbuf, recvbuf);
+  return 0;
+}
+
+static int test(
+    sdecomp_transpose_request_t * request,
+    bool * flag
+){
+  int flag_ = 0;
+  MPI_Test(request->handle, &flag_, MPI_STATUS_IGNORE);
+  request->is_completed = 0 != flag_;
+  *flag = request->is_completed;
+  return 0;
+}
+
+static int wait(
+    sdecomp_transpose_request_t * request
+){
+  MPI_Wait(request->handle, MPI_STATUS_IGNORE);
+  request->is_completed = true;
+  return 0;
+}
+
+static int finalise(
+    sdecomp_transpose_plan_t * plan
+){
+  if(MPI_COMM_NULL != plan->comm_graph){
+    MPI_Comm_free(&plan->comm_graph);
+  }
+  sdecomp_internal_free(plan->sources);
+  sdecomp_internal_free(plan->destinations);
+  sdecomp_internal_free(plan->nbr_scounts);
+  sdecomp_internal_free(plan->nbr_rcounts);
+  sdecomp_internal_free(plan->nbr_sdispls);
+  sdecomp_internal_free(plan->nbr_rdispls);
+  sdecomp_internal_free(plan->nbr_stypes);
+  sdecomp_internal_free(plan->nbr_rtypes);
+  return 0;
+}
+
+const sdecomp_internal_transpose_engine_t sdecomp_internal_transpose_engine_neighbor = {
+  .init          = init,
+  .execute       = execute,
+  .execute_batch = execute_batch,
+  .start         = start,
+  .test          = test,
+  .wait          = wait,
+  .finalise      = finalise,
+};
@@ -0,0 +1,284 @@
+/*
+ * Copyright 2022 Naoki Hori
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// https://github.com/NaokiHori/SimpleDecomp
+
+// helper functions shared by the engines packing chunks explicitly
+//   into contiguous buffers (see alltoallv.c, pairwise.c and bruck.c)
+
+#include <stdbool.h>
+#include <limits.h>
+#include <mpi.h>
+#include "sdecomp.h"
+#define SDECOMP_INTERNAL
+#include "../internal.h"
+#define SDECOMP_INTERNAL_TRANSPOSE
+#include "internal.h"
+
+// chunks which are not exchanged through the packed buffers:
+//   the one to myself, which is copied directly, and
+//   the ones to the processes sharing memory with me (see shm.c)
+static bool is_excluded(
+    const sdecomp_transpose_plan_t * plan,
+    const int n
+){
+  if(plan->myrank_2d == n) return true;
+  if(NULL != plan->node_ranks && MPI_UNDEFINED != plan->node_ranks[n]) return true;
+  return false;
+}
+
+// NOTE: the excluded chunks (see above) have zero counts
+// NOTE: when several fields are exchanged at once,
+//   the chunks of all fields to the same process are contiguous
+int sdecomp_internal_transpose_packed_counts(
+    const char error_label[],
+    const sdecomp_transpose_plan_t * plan,
+    const size_t nfields,
+    const sdecomp_internal_transpose_chunk_t * chunks,
+    int * counts,
+    int * displs,
+    size_t * total
+){
+  // in the unit of elements
+  *total = 0;
+  for(int n = 0; n < plan->nprocs_2d; n++){
+    const sdecomp_internal_transpose_chunk_t * chunk = chunks + n;
+    const size_t count = is_excluded(plan, n) ? 0 : nfields * chunk->nbatch * chunk->ni * chunk->nj;
+    // NOTE: the total is also checked, which is given to the collectives
+    //       as a single count by some engines (e.g. hierarchical)
+    if((size_t)INT_MAX - *total < count){
+      SDECOMP_ERROR(
+          "packed buffer is too large to be described by int\n",
+          error_label
+      );
+      return 1;
+    }
+    counts[n] = (int)count;
+    displs[n] = (int)(*total);
+    *total += count;
+  }
+  return 0;
+}
+
+// counts, displacements and packed buffers owned by the plan
+int sdecomp_internal_transpose_packed_init(
+    const char error_label[],
+    sdecomp_transpose_plan_t * plan
+){
+  const size_t size_of_element = plan->packed_size_of_element;
+  const int nprocs = plan->nprocs_2d;
+  plan->is_workspace_busy = false;
+  plan->packed_scounts = sdecomp_internal_calloc(error_label, (size_t)nprocs, sizeof(int));
+  plan->packed_rcounts = sdecomp_internal_calloc(error_label, (size_t)nprocs, sizeof(int));
+  plan->packed_sdispls = sdecomp_internal_calloc(error_label, (size_t)nprocs, sizeof(int));
+  plan->packed_rdispls = sdecomp_internal_calloc(error_label, (size_t)nprocs, sizeof(int));
+  if(NULL == plan->packed_scounts) return 1;
+  if(NULL == plan->packed_rcounts) return 1;
+  if(NULL == plan->packed_sdispls) return 1;
+  if(NULL == plan->packed_rdispls) return 1;
+  if(0 != sdecomp_internal_transpose_packed_counts(error_label, plan, 1, plan->schunks, plan->packed_scounts, plan->packed_sdispls, &plan->packed_ssize)) return 1;
+  if(0 != sdecomp_internal_transpose_packed_counts(error_label, plan, 1, plan->rchunks, plan->packed_rcounts, plan->packed_rdispls, &plan->packed_rsize)) return 1;
+  // pipelined plans own the buffers of two slabs instead (see alltoallv.c)
+  if(1 == plan->nslabs){
+    plan->packed_sendbuf = sdecomp_internal_calloc(error_label, plan->packed_ssize, size_of_element);
+    plan->packed_recvbuf = sdecomp_internal_calloc(error_label, plan->packed_rsize, size_of_element);
+    if(NULL == plan->packed_sendbuf) return 1;
+    if(NULL == plan->packed_recvbuf) return 1;
+  }
+  // contiguous data type of one (possibly narrowed) element
+  MPI_Type_contiguous((int)size_of_element, MPI_BYTE, &plan->elemtype);
+  MPI_Type_commit(&plan->elemtype);
+  return 0;
+}
+
+int sdecomp_internal_transpose_packed_finalise(
+    sdecomp_transpose_plan_t * plan
+){
+  if(MPI_DATATYPE_NULL != plan->elemtype){
+    MPI_Type_free(&plan->elemtype);
+  }
+  sdecomp_internal_free(plan->packed_scounts);
+  sdecomp_internal_free(plan->packed_rcounts);
+  sdecomp_internal_free(plan->packed_sdispls);
+  sdecomp_internal_free(plan->packed_rdispls);
+  sdecomp_internal_free(plan->packed_sendbuf);
+  sdecomp_internal_free(plan->packed_recvbuf);
+  return 0;
+}
+
+// the packed buffers owned by the plan are used if they are free,
+//   otherwise (i.e. several rotations are on-going, or the plan is pipelined
+//   and only owns the buffers of two slabs) new ones are allocated
+int sdecomp_internal_transpose_packed_acquire(
+    const char error_label[],
+    sdecomp_transpose_plan_t * plan,
+    sdecomp_transpose_request_t * request
+){
+  if(1 == plan->nslabs && !plan->is_workspace_busy){
+    plan->is_workspace_busy = true;
+    request->packed_sendbuf = plan->packed_sendbuf;
+    request->packed_recvbuf = plan->packed_recvbuf;
+    request->is_workspace_borrowed = true;
+    return 0;
+  }
+  request->packed_sendbuf = sdecomp_internal_calloc(error_label, plan->packed_ssize, plan->packed_size_of_element);
+  request->packed_recvbuf = sdecomp_internal_calloc(error_label, plan->packed_rsize, plan->packed_size_of_element);
+  request->is_workspace_borrowed = false;
+  if(NULL == request->packed_sendbuf) return 1;
+  if(NULL == request->packed_recvbuf) return 1;
+  return 0;
+}
+
+int sdecomp_internal_transpose_packed_release(
+    sdecomp_transpose_plan_t * plan,
+    sdecomp_transpose_request_t * request
+){
+  if(request->is_workspace_borrowed){
+    plan->is_workspace_busy = false;
+  }else{
+    sdecomp_internal_free(request->packed_sendbuf);
+    sdecomp_internal_free(request->packed_recvbuf);
+  }
+  request->packed_sendbuf = NULL;
+  request->packed_recvbuf = NULL;
+  return 0;
+}
+
+// chunks are partially processed (from b0 to b0 + nb - 1) for pipelined rotations
+int sdecomp_internal_transpose_packed_pack(
+    const sdecomp_transpose_plan_t * plan,
+    const size_t b0,
+    const size_t nb,
+    const size_t nfields,
+    const void * const * sendbufs,
+    const int * displs,
+    void * packed
+){
+  const size_t size_of_element = plan->packed_size_of_element;
+  for(int n = 0; n < plan->nprocs_2d; n++){
+    if(is_excluded(plan, n)) continue;
+    sdecomp_internal_transpose_chunk_t chunk = plan->schunks[n];
+    chunk.offset += b0 * chunk.stride_batch;
+    chunk.nbatch = nb;
+    const size_t count = chunk.nbatch * chunk.ni * chunk.nj;
+    for(size_t f = 0; f < nfields; f++){
+      sdecomp_internal_transpose_pack_wire(
+          plan->wire,
+          plan->size_of_element,
+          &chunk,
+          sendbufs[f],
+          (char *)packed + size_of_element * ((size_t)displs[n] + f * count)
+      );
+    }
+  }
+  return 0;
+}
+
+int sdecomp_internal_transpose_packed_unpack(
+    const sdecomp_transpose_plan_t * plan,
+    const size_t b0,
+    const size_t nb,
+    const size_t nfields,
+    const void * packed,
+    const int * displs,
+    void * const * recvbufs
+){
+  const size_t size_of_element = plan->packed_size_of_element;
+  for(int n = 0; n < plan->nprocs_2d; n++){
+    if(is_excluded(plan, n)) continue;
+    sdecomp_internal_transpose_chunk_t chunk = plan->rchunks[n];
+    chunk.offset += b0 * chunk.stride_batch;
+    chunk.nbatch = nb;
+    const size_t count = chunk.nbatch * chunk.ni * chunk.nj;
+    for(size_t f = 0; f < nfields; f++){
+      sdecomp_internal_transpose_unpack_wire(
+          plan->wire,
+          plan->size_of_element,
+          &chunk,
+          (const char *)packed + size_of_element * ((size_t)displs[n] + f * count),
+          recvbufs[f]
+      );
+    }
+  }
+  return 0;
+}
+
+// blocking rotation of one or more fields using the given exchange of the packed buffers
+//   packed buffers accommodating several fields are prepared for each call
+int sdecomp_internal_transpose_packed_execute(
+    const char error_label[],
+    sdecomp_transpose_plan_t * plan,
+    const size_t nfields,
+    const void * const * sendbufs,
+    void * const * recvbufs,
+    const sdecomp_internal_transpose_exchange_t exchange
+){
+  if(1 == nfields){
+    sdecomp_transpose_request_t request = {0};
+    if(0 != sdecomp_internal_transpose_packed_acquire(error_label, plan, &request)) return 1;
+    sdecomp_internal_transpose_packed_pack(plan, 0, plan->schunks[0].nbatch, 1, sendbufs, plan->packed_sdispls, request.packed_sendbuf);
+    sdecomp_internal_transpose_copy_self(plan, sendbufs[0], recvbufs[0]);
+    if(0 != exchange(
+          error_label, plan, 1,
+          request.packed_sendbuf, plan->packed_scounts, plan->packed_sdispls,
+          request.packed_recvbuf, plan->packed_rcounts, plan->packed_rdispls
+    )) return 1;
+    sdecomp_internal_transpose_packed_unpack(plan, 0, plan->rchunks[0].nbatch, 1, request.packed_recvbuf, plan->packed_rdispls, recvbufs);
+    sdecomp_internal_transpose_packed_release(plan, &request);
+    return 0;
+  }
+  const size_t size_of_element = plan->packed_size_of_element;
+  const int nprocs = plan->nprocs_2d;
+  int * scounts = sdecomp_internal_calloc(error_label, (size_t)nprocs, sizeof(int));
+  int * rcounts = sdecomp_internal_calloc(error_label, (size_t)nprocs, sizeof(int));
+  int * sdispls = sdecomp_internal_calloc(error_label, (size_t)nprocs, sizeof(int));
+  int * rdispls = sdecomp_internal_calloc(error_label, (size_t)nprocs, sizeof(int));
+  if(NULL == scounts) return 1;
+  if(NULL == rcounts) return 1;
+  if(NULL == sdispls) return 1;
+  if(NULL == rdispls) return 1;
+  size_t ssize = 0;
+  size_t rsize = 0;
+  if(0 != sdecomp_internal_transpose_packed_counts(error_label, plan, nfields, plan->schunks, scounts, sdispls, &ssize)) return 1;
+  if(0 != sdecomp_internal_transpose_packed_counts(error_label, plan, nfields, plan->rchunks, rcounts, rdispls, &rsize)) return 1;
+  void * packed_sendbuf = sdecomp_internal_calloc(error_label, ssize, size_of_element);
+  void * packed_recvbuf = sdecomp_internal_calloc(error_label, rsize, size_of_element);
+  if(NULL == packed_sendbuf) return 1;
+  if(NULL == packed_recvbuf) return 1;
+  sdecomp_internal_transpose_packed_pack(plan, 0, plan->schunks[0].nbatch, nfields, sendbufs, sdispls, packed_sendbuf);
+  for(size_t f = 0; f < nfields; f++){
+    sdecomp_internal_transpose_copy_self(plan, sendbufs[f], recvbufs[f]);
+  }
+  if(0 != exchange(
+        error_label, plan, nfields,
+        packed_sendbuf, scounts, sdispls,
+        packed_recvbuf, rcounts, rdispls
+  )) return 1;
+  sdecomp_internal_transpose_packed_unpack(plan, 0, plan->rchunks[0].nbatch, nfields, packed_recvbuf, rdispls, recvbufs);
+  sdecomp_internal_free(scounts);
+  sdecomp_internal_free(rcounts);
+  sdecomp_internal_free(sdispls);
+  sdecomp_internal_free(rdispls);
+  sdecomp_internal_free(packed_sendbuf);
+  sdecomp_internal_free(packed_recvbuf);
+  return 0;
+}
+
@@ -0,0 +1,215 @@
+/*
+ * Copyright 2022 Naoki Hori
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// https://github.com/NaokiHori/SimpleDecomp
+
+// engine packing chunks explicitly into contiguous buffers,
+//   which are exchanged pairwise by MPI_Sendrecv and unpacked afterwards
+// NOTE: suitable for large messages, since only one message is on the fly
+//   per process at a time, whose schedule does not depend on the MPI library
+// NOTE: non-blocking rotations post the messages of one step at a time,
+//   and the following steps are posted by sdecomp.transpose.test / wait
+
+#include <stdbool.h>
+#include <mpi.h>
+#include "sdecomp.h"
+#define SDECOMP_INTERNAL
+#include "../internal.h"
+#define SDECOMP_INTERNAL_TRANSPOSE
+#include "internal.h"
+
+// in each of (nprocs - 1) steps, every process sends one chunk and receives one chunk
+//   the partner is given by XOR if the number of processes is a power of two,
+//   i.e. two processes exchange their chunks with each other,
+//   otherwise by ring shift
+static void get_partners(
+    const sdecomp_transpose_plan_t * plan,
+    const int step,
+    int * dst,
+    int * src
+){
+  const int nprocs = plan->nprocs_2d;
+  const int myrank = plan->myrank_2d;
+  const bool is_power_of_two = 0 == (nprocs & (nprocs - 1));
+  *dst = is_power_of_two ? myrank ^ step : (myrank + step) % nprocs;
+  *src = is_power_of_two ? myrank ^ step : (myrank - step + nprocs) % nprocs;
+}
+
+static int exchange(
+    const char error_label[],
+    const sdecomp_transpose_plan_t * plan,
+    const size_t nfields,
+    const void * sendbuf,
+    const int * scounts,
+    const int * sdispls,
+    void * recvbuf,
+    const int * rcounts,
+    const int * rdispls
+){
+  (void)error_label;
+  (void)nfields;
+  // NOTE: in the packed buffers, whose elements may be narrowed
+  const size_t size_of_element = plan->packed_size_of_element;
+  const int nprocs = plan->nprocs_2d;
+  for(int step = 1; step < nprocs; step++){
+    int dst = 0;
+    int src = 0;
+    get_partners(plan, step, &dst, &src);
+    MPI_Sendrecv(
+        (const char *)sendbuf + size_of_element * (size_t)sdispls[dst], scounts[dst], plan->elemtype, dst, 0,
+        (char *)recvbuf + size_of_element * (size_t)rdispls[src], rcounts[src], plan->elemtype, src, 0,
+        plan->comm_2d,
+        MPI_STATUS_IGNORE
+    );
+  }
+  return 0;
+}
+
+static int init(
+    const char error_label[],
+    const sdecomp_transpose_options_t * options,
+    sdecomp_transpose_plan_t * plan
+){
+  (void)options;
+  plan->is_persistent = false;
+  plan->persistent_request = MPI_REQUEST_NULL;
+  if(0 != sdecomp_internal_transpose_packed_init(error_label, plan)) return 1;
+  return 0;
+}
+
+static int execute(
+    sdecomp_transpose_plan_t * plan,
+    const void * sendbuf,
+    void * recvbuf
+){
+  const char error_label[] = {"sdecomp.transpose.execute"};
+  return sdecomp_internal_transpose_packed_execute(error_label, plan, 1, &sendbuf, &recvbuf, exchange);
+}
+
+static int execute_batch(
+    const char error_label[],
+    sdecomp_transpose_plan_t * plan,
+    const size_t nfields,
+    const void * const * sendbufs,
+    void * const * recvbufs
+){
+  return sdecomp_internal_transpose_packed_execute(error_label, plan, nfields, sendbufs, recvbufs, exchange);
+}
+
+// messages of the current step, whose completion is checked by progress
+static void post_step(
+    sdecomp_transpose_request_t * request
+){
+  const sdecomp_transpose_plan_t * plan = request->plan;
+  const size_t size_of_element = plan->packed_size_of_element;
+  int dst = 0;
+  int src = 0;
+  get_partners(plan, request->step, &dst, &src);
+  MPI_Irecv(
+      (char *)request->packed_recvbuf + size_of_element * (size_t)plan->packed_rdispls[src], plan->packed_rcounts[src], plan->elemtype, src, 0,
+      plan->comm_2d,
+      request->step_requests + 0
+  );
+  MPI_Isend(
+      (const char *)request->packed_sendbuf + size_of_element * (size_t)plan->packed_sdispls[dst], plan->packed_scounts[dst], plan->elemtype, dst, 0,
+      plan->comm_2d,
+      request->step_requests + 1
+  );
+}
+
+static int start(
+    const char error_label[],
+    sdecomp_transpose_plan_t * plan,
+    const void * sendbuf,
+    void * recvbuf,
+    sdecomp_transpose_request_t * request
+){
+  if(0 != sdecomp_internal_transpose_packed_acquire(error_label, plan, request)) return 1;
+  sdecomp_internal_transpose_packed_pack(plan, 0, plan->schunks[0].nbatch, 1, &sendbuf, plan->packed_sdispls, request->packed_sendbuf);
+  request->step = 1;
+  request->step_requests[0] = MPI_REQUEST_NULL;
+  request->step_requests[1] = MPI_REQUEST_NULL;
+  if(request->step < plan->nprocs_2d){
+    post_step(request);
+  }
+  // my own chunk is processed while the others are on the fly
+  sdecomp_internal_transpose_copy_self(plan, sendbuf, recvbuf);
+  return 0;
+}
+
+// the following steps are posted as long as the current one is completed,
+//   which is waited for if "blocking" is true
+static int progress(
+    sdecomp_transpose_request_t * request,
+    const bool blocking
+){
+  sdecomp_transpose_plan_t * plan = request->plan;
+  while(request->step < plan->nprocs_2d){
+    int flag = 0;
+    if(blocking){
+      MPI_Waitall(2, request->step_requests, MPI_STATUSES_IGNORE);
+      flag = 1;
+    }else{
+      MPI_Testall(2, request->step_requests, &flag, MPI_STATUSES_IGNORE);
+    }
+    if(0 == flag) return 0;
+    request->step += 1;
+    if(request->step < plan->nprocs_2d){
+      post_step(request);
+    }
+  }
+  sdecomp_internal_transpose_packed_unpack(plan, 0, plan->rchunks[0].nbatch, 1, request->packed_recvbuf, plan->packed_rdispls, &request->recvbuf);
+  sdecomp_internal_transpose_packed_release(plan, request);
+  request->is_completed = true;
+  return 0;
+}
+
+static int test(
+    sdecomp_transpose_request_t * request,
+    bool * flag
+){
+  if(0 != progress(request, false)) return 1;
+  *flag = request->is_completed;
+  return 0;
+}
+
+static int wait(
+    sdecomp_transpose_request_t * request
+){
+  return progress(request, true);
+}
+
+static int finalise(
+    sdecomp_transpose_plan_t * plan
+){
+  sdecomp_internal_transpose_packed_finalise(plan);
+  return 0;
+}
+
+const sdecomp_internal_transpose_engine_t sdecomp_internal_transpose_engine_pairwise = {
+  .init          = init,
+  .execute       = execute,
+  .execute_batch = execute_batch,
+  .start         = start,
+  .test          = test,
+  .wait          = wait,
+  .finalise      = finalise,
+};
@@ -0,0 +1,127 @@
+/*
+ * Copyright 2022 Naoki Hori
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// https://github.com/NaokiHori/SimpleDecomp
+
+// persistent collectives, which are standardised in MPI 4.0
+// for older libraries, extensions are used if available,
+//   otherwise "is_created" is set to false and
+//   the plans fall back to the non-persistent path
+
+#include <stdbool.h>
+#include <mpi.h>
+#if MPI_VERSION < 4 && defined(OPEN_MPI)
+#include <mpi-ext.h>
+#endif
+#include "sdecomp.h"
+#define SDECOMP_INTERNAL
+#include "../internal.h"
+#define SDECOMP_INTERNAL_TRANSPOSE
+#include "internal.h"
+
+#if MPI_VERSION >= 4
+#define SDECOMP_INTERNAL_ALLTOALLW_INIT MPI_Alltoallw_init
+#define SDECOMP_INTERNAL_ALLTOALLV_INIT MPI_Alltoallv_init
+#elif defined(OMPI_HAVE_MPI_EXT_PCOLLREQ) && OMPI_HAVE_MPI_EXT_PCOLLREQ
+#define SDECOMP_INTERNAL_ALLTOALLW_INIT MPIX_Alltoallw_init
+#define SDECOMP_INTERNAL_ALLTOALLV_INIT MPIX_Alltoallv_init
+#endif
+
+int sdecomp_internal_transpose_alltoallw_init(
+    const void * sendbuf,
+    const int * scounts,
+    const int * sdispls,
+    const MPI_Datatype * stypes,
+    void * recvbuf,
+    const int * rcounts,
+    const int * rdispls,
+    const MPI_Datatype * rtypes,
+    const MPI_Comm comm,
+    MPI_Request * request,
+    bool * is_created
+){
+  *request = MPI_REQUEST_NULL;
+  *is_created = false;
+#if defined(SDECOMP_INTERNAL_ALLTOALLW_INIT)
+  SDECOMP_INTERNAL_ALLTOALLW_INIT(
+      sendbuf, scounts, sdispls, stypes,
+      recvbuf, rcounts, rdispls, rtypes,
+      comm,
+      MPI_INFO_NULL,
+      request
+  );
+  *is_created = true;
+#else
+  (void)sendbuf;
+  (void)scounts;
+  (void)sdispls;
+  (void)stypes;
+  (void)recvbuf;
+  (void)rcounts;
+  (void)rdispls;
+  (void)rtypes;
+  (void)comm;
+#endif
+  return 0;
+}
+
+int sdecomp_internal_transpose_alltoallv_init(
+    const void * sendbuf,
+    const int * scounts,
+    const int * sdispls,
+    void * recvbuf,
+    const int * rcounts,
+    const int * rdispls,
+    const MPI_Datatype datatype,
+    const MPI_Comm comm,
+    MPI_Request * request,
+    bool * is_created
+){
+  *request = MPI_REQUEST_NULL;
+  *is_created = false;
+#if defined(SDECOMP_INTERNAL_ALLTOALLV_INIT)
+  SDECOMP_INTERNAL_ALLTOALLV_INIT(
+      sendbuf, scounts, sdispls, datatype,
+      recvbuf, rcounts, rdispls, datatype,
+      comm,
+      MPI_INFO_NULL,
+      request
+  );
+  *is_created = true;
+#else
+  (void)sendbuf;
+  (void)scounts;
+  (void)sdispls;
+  (void)recvbuf;
+  (void)rcounts;
+  (void)rdispls;
+  (void)datatype;
+  (void)comm;
+#endif
+  return 0;
+}
+
+#if defined(SDECOMP_INTERNAL_ALLTOALLW_INIT)
+#undef SDECOMP_INTERNAL_ALLTOALLW_INIT
+#endif
+#if defined(SDECOMP_INTERNAL_ALLTOALLV_INIT)
+#undef SDECOMP_INTERNAL_ALLTOALLV_INIT
+#endif
@@ -0,0 +1,413 @@
+/*
+ * Copyright 2022 Naoki Hori
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// https://github.com/NaokiHori/SimpleDecomp
+
+// engine putting chunks directly into the receive buffers of the others
+//   by one-sided communication (MPI_Put), whose epochs are synchronised
+//   only among the processes exchanging chunks (MPI_Win_post / start / complete / wait)
+// NOTE: a window is created over a receive buffer when it is seen first
+//   (when the plan is constructed if bound by the options) and is reused
+//   while all processes give the same receive buffer,
+//   where a few windows are kept so that batched fields can be rotated
+// NOTE: while a non-blocking rotation is on-going,
+//   chunks are put into a staging buffer owned by the plan instead,
+//   which is copied to the given one after the epoch is closed
+// NOTE: the receiver does not have to match messages,
+//   and puts proceed while the user computes between start and wait
+
+#include <stdbool.h>
+#include <string.h>
+#include <mpi.h>
+#include "sdecomp.h"
+#define SDECOMP_INTERNAL
+#include "../internal.h"
+#define SDECOMP_INTERNAL_TRANSPOSE
+#include "internal.h"
+
+static int create_window(
+    const sdecomp_transpose_plan_t * plan,
+    void * base,
+    MPI_Win * window
+){
+  MPI_Info info = MPI_INFO_NULL;
+  MPI_Info_create(&info);
+  // only post-start-complete-wait epochs are used to synchronise
+  MPI_Info_set(info, "no_locks", "true");
+  MPI_Win_create(
+      base,
+      (MPI_Aint)(plan->size_of_element * plan->rma_rsize),
+      1,
+      info,
+      plan->comm_2d,
+      window
+  );
+  MPI_Info_free(&info);
+  return 0;
+}
+
+// window into which the chunks are put, which is decided collectively,
+//   since windows are created and epochs are synchronised over comm_2d
+static int select_window(
+    const char error_label[],
+    sdecomp_transpose_plan_t * plan,
+    void * recvbuf,
+    MPI_Win * window
+){
+  const size_t nwins = sizeof(plan->rma_wins) / sizeof(plan->rma_wins[0]);
+  // window over this receive buffer, which is reused if all processes have it
+  int index = -1;
+  for(size_t n = 0; n < nwins; n++){
+    if(MPI_WIN_NULL != plan->rma_wins[n] && plan->rma_bases[n] == recvbuf){
+      index = (int)n;
+    }
+  }
+  int states[3] = {plan->is_workspace_busy, index, -index};
+  MPI_Allreduce(MPI_IN_PLACE, states, 3, MPI_INT, MPI_MAX, plan->comm_2d);
+  const bool is_busy = 0 != states[0];
+  const bool is_found = 0 <= states[1] && states[1] == -states[2];
+  if(!is_busy && is_found){
+    *window = plan->rma_wins[index];
+    return 0;
+  }
+  if(!is_busy){
+    // the oldest window is replaced by the one over this receive buffer
+    MPI_Win * win = plan->rma_wins + plan->rma_next;
+    if(MPI_WIN_NULL != *win){
+      MPI_Win_free(win);
+    }
+    if(0 != create_window(plan, recvbuf, win)) return 1;
+    plan->rma_bases[plan->rma_next] = recvbuf;
+    plan->rma_next = (plan->rma_next + 1) % nwins;
+    *window = *win;
+    return 0;
+  }
+  if(MPI_WIN_NULL == plan->rma_staging_win){
+    // NOTE: a failure of any process is shared with all processes,
+    //   since the window is created collectively
+    plan->rma_staging_buf = sdecomp_internal_calloc(error_label, plan->rma_rsize, plan->size_of_element);
+    int is_failed = NULL == plan->rma_staging_buf;
+    MPI_Allreduce(MPI_IN_PLACE, &is_failed, 1, MPI_INT, MPI_LOR, plan->comm_2d);
+    if(is_failed) return 1;
+    if(0 != create_window(plan, plan->rma_staging_buf, &plan->rma_staging_win)) return 1;
+  }
+  *window = plan->rma_staging_win;
+  return 0;
+}
+
+// chunk is empty, in which case nothing is put
+static bool is_empty(
+    const sdecomp_internal_transpose_chunk_t * chunk
+){
+  return 0 == chunk->nbatch * chunk->ni * chunk->nj;
+}
+
+// data types describing my chunks in my send buffer and in the receive buffers of the others
+// NOTE: the data types of the plan (see 3d.c) are not used,
+//   since the ordering of the elements differs between the sender and the receiver
+//   and only the type signatures are matched by the collectives
+static int init_types(
+    const char error_label[],
+    sdecomp_transpose_plan_t * plan
+){
+  const int nprocs = plan->nprocs_2d;
+  sdecomp_internal_transpose_chunk_t * chunks = sdecomp_internal_calloc(error_label, (size_t)nprocs, sizeof(sdecomp_internal_transpose_chunk_t));
+  plan->rma_stypes = sdecomp_internal_calloc(error_label, (size_t)nprocs, sizeof(MPI_Datatype));
+  plan->rma_rtypes = sdecomp_internal_calloc(error_label, (size_t)nprocs, sizeof(MPI_Datatype));
+  if(NULL ==           chunks) return 1;
+  if(NULL == plan->rma_stypes) return 1;
+  if(NULL == plan->rma_rtypes) return 1;
+  // the n-th process receives my chunk as its rchunks[myrank]
+  MPI_Alltoall(
+      plan->rchunks, sizeof(sdecomp_internal_transpose_chunk_t), MPI_BYTE,
+      chunks, sizeof(sdecomp_internal_transpose_chunk_t), MPI_BYTE,
+      plan->comm_2d
+  );
+  for(int n = 0; n < nprocs; n++){
+    const sdecomp_internal_transpose_chunk_t * schunk = plan->schunks + n;
+    sdecomp_internal_transpose_create_send_type(plan->size_of_element, schunk, 0, schunk->nbatch, plan->rma_stypes + n);
+    const sdecomp_internal_transpose_chunk_t * chunk = chunks + n;
+    sdecomp_internal_transpose_create_recv_type(plan->size_of_element, chunk, 0, chunk->nbatch, plan->rma_rtypes + n);
+  }
+  sdecomp_internal_free(chunks);
+  // my whole receive buffer is exposed,
+  //   which is not tiled by the chunks if the global sizes differ
+  plan->rma_rsize = plan->nitems_aft;
+  return 0;
+}
+
+// processes putting chunks to me (origins) and receiving chunks from me (targets)
+static int init_groups(
+    const char error_label[],
+    sdecomp_transpose_plan_t * plan
+){
+  const int nprocs = plan->nprocs_2d;
+  int * origins = sdecomp_internal_calloc(error_label, (size_t)nprocs, sizeof(int));
+  int * targets = sdecomp_internal_calloc(error_label, (size_t)nprocs, sizeof(int));
+  if(NULL == origins) return 1;
+  if(NULL == targets) return 1;
+  const int myrank = plan->myrank_2d;
+  int norigins = 0;
+  int ntargets = 0;
+  // NOTE: counts are unity, since the offsets are described by the data types,
+  //   and thus the chunks themselves are checked
+  // NOTE: my own chunk is copied directly, see sdecomp_internal_transpose_copy_self
+  for(int n = 0; n < nprocs; n++){
+    if(myrank == n) continue;
+    if(!is_empty(plan->rchunks + n)) origins[norigins++] = n;
+    if(!is_empty(plan->schunks + n)) targets[ntargets++] = n;
+  }
+  MPI_Group group_2d = MPI_GROUP_NULL;
+  MPI_Comm_group(plan->comm_2d, &group_2d);
+  MPI_Group_incl(group_2d, norigins, origins, &plan->rma_origin_group);
+  MPI_Group_incl(group_2d, ntargets, targets, &plan->rma_target_group);
+  MPI_Group_free(&group_2d);
+  sdecomp_internal_free(origins);
+  sdecomp_internal_free(targets);
+  return 0;
+}
+
+static int init(
+    const char error_label[],
+    const sdecomp_transpose_options_t * options,
+    sdecomp_transpose_plan_t * plan
+){
+  plan->is_persistent = false;
+  plan->sendbuf = NULL;
+  plan->recvbuf = NULL;
+  plan->persistent_request = MPI_REQUEST_NULL;
+  plan->is_workspace_busy = false;
+  if(0 != init_types(error_label, plan)) return 1;
+  // nothing to put when I am alone, in which case windows are not created
+  if(1 == plan->nprocs_2d) return 0;
+  if(0 != init_groups(error_label, plan)) return 1;
+  if(!options->persistent) return 0;
+  if(0 != sdecomp_internal_sanitise_null(error_label, "options->sendbuf", options->sendbuf)) return 1;
+  if(0 != sdecomp_internal_sanitise_null(error_label, "options->recvbuf", options->recvbuf)) return 1;
+  if(0 != create_window(plan, options->recvbuf, plan->rma_wins + 0)) return 1;
+  plan->rma_bases[0] = options->recvbuf;
+  plan->rma_next = 1;
+  plan->is_persistent = true;
+  plan->sendbuf = options->sendbuf;
+  plan->recvbuf = options->recvbuf;
+  return 0;
+}
+
+// open an epoch, put my chunks to the others, and process my own chunk
+static int open_epoch(
+    const char error_label[],
+    sdecomp_transpose_plan_t * plan,
+    const void * sendbuf,
+    void * recvbuf,
+    sdecomp_transpose_request_t * request
+){
+  const int nprocs = plan->nprocs_2d;
+  const int myrank = plan->myrank_2d;
+  // nothing to put when I am alone
+  request->window = MPI_WIN_NULL;
+  if(1 == nprocs){
+    sdecomp_internal_transpose_copy_self(plan, sendbuf, recvbuf);
+    return 0;
+  }
+  if(0 != select_window(error_label, plan, recvbuf, &request->window)) return 1;
+  void * window_buf = plan->rma_staging_win == request->window ? plan->rma_staging_buf : recvbuf;
+  // my window is exposed to the origins, and I access the windows of the targets
+  MPI_Win_post(plan->rma_origin_group, 0, request->window);
+  MPI_Win_start(plan->rma_target_group, 0, request->window);
+  request->is_access_completed = false;
+  // targets are shifted so that all processes do not put to the same one at once
+  for(int step = 1; step < nprocs; step++){
+    const int n = (myrank + step) % nprocs;
+    if(is_empty(plan->schunks + n)) continue;
+    MPI_Put(
+        sendbuf, plan->scounts[n], plan->rma_stypes[n],
+        n, 0, plan->scounts[n], plan->rma_rtypes[n],
+        request->window
+    );
+  }
+  // NOTE: no one puts into the region of my own chunk
+  sdecomp_internal_transpose_copy_self(plan, sendbuf, window_buf);
+  return 0;
+}
+
+// my access epoch is completed, so that the targets can close their exposure epochs
+// NOTE: this returns after the targets open their exposure epochs, i.e. start the rotation
+static void complete_access(
+    sdecomp_transpose_request_t * request
+){
+  if(request->is_access_completed) return;
+  MPI_Win_complete(request->window);
+  request->is_access_completed = true;
+}
+
+// the puts to me have been completed if "flag" is true,
+//   which is waited for if "blocking" is true
+static int close_epoch(
+    sdecomp_transpose_request_t * request,
+    const bool blocking,
+    bool * flag
+){
+  sdecomp_transpose_plan_t * plan = request->plan;
+  *flag = true;
+  if(MPI_WIN_NULL == request->window) return 0;
+  complete_access(request);
+  if(blocking){
+    MPI_Win_wait(request->window);
+  }else{
+    int flag_ = 0;
+    MPI_Win_test(request->window, &flag_);
+    if(0 == flag_){
+      *flag = false;
+      return 0;
+    }
+  }
+  if(plan->rma_staging_win == request->window){
+    memcpy(request->recvbuf, plan->rma_staging_buf, plan->size_of_element * plan->rma_rsize);
+  }
+  request->window = MPI_WIN_NULL;
+  return 0;
+}
+
+static int execute(
+    sdecomp_transpose_plan_t * plan,
+    const void * sendbuf,
+    void * recvbuf
+){
+  const char error_label[] = {"sdecomp.transpose.execute"};
+  sdecomp_transpose_request_t request = {0};
+  request.plan = plan;
+  request.recvbuf = recvbuf;
+  bool flag = false;
+  if(0 != open_epoch(error_label, plan, sendbuf, recvbuf, &request)) return 1;
+  if(0 != close_epoch(&request, true, &flag)) return 1;
+  return 0;
+}
+
+// NOTE: a window accommodates one field,
+//   and thus fields are rotated one after another
+static int execute_batch(
+    const char error_label[],
+    sdecomp_transpose_plan_t * plan,
+    const size_t nfields,
+    const void * const * sendbufs,
+    void * const * recvbufs
+){
+  (void)error_label;
+  for(size_t f = 0; f < nfields; f++){
+    if(0 != execute(plan, sendbufs[f], recvbufs[f])) return 1;
+  }
+  return 0;
+}
+
+// NOTE: only one epoch can be opened on a window at a time,
+//   and thus another rotation cannot be started until the on-going one is completed
+static int start(
+    const char error_label[],
+    sdecomp_transpose_plan_t * plan,
+    const void * sendbuf,
+    void * recvbuf,
+    sdecomp_transpose_request_t * request
+){
+  if(plan->is_workspace_busy){
+    SDECOMP_ERROR(
+        "another rotation using this plan is on-going, which should be completed first\n",
+        error_label
+    );
+    return 1;
+  }
+  if(0 != open_epoch(error_label, plan, sendbuf, recvbuf, request)) return 1;
+  plan->is_workspace_busy = true;
+  request->is_workspace_borrowed = true;
+  return 0;
+}
+
+static int finish(
+    sdecomp_transpose_request_t * request
+){
+  request->plan->is_workspace_busy = false;
+  request->is_workspace_borrowed = false;
+  request->is_completed = true;
+  return 0;
+}
+
+// NOTE: the puts to me are checked locally by MPI_Win_test,
+//   after my puts to the others are completed
+static int test(
+    sdecomp_transpose_request_t * request,
+    bool * flag
+){
+  if(0 != close_epoch(request, false, flag)) return 1;
+  if(*flag){
+    finish(request);
+  }
+  return 0;
+}
+
+static int wait(
+    sdecomp_transpose_request_t * request
+){
+  bool flag = false;
+  if(0 != close_epoch(request, true, &flag)) return 1;
+  finish(request);
+  return 0;
+}
+
+static int finalise(
+    sdecomp_transpose_plan_t * plan
+){
+  for(size_t n = 0; n < sizeof(plan->rma_wins) / sizeof(plan->rma_wins[0]); n++){
+    if(MPI_WIN_NULL != plan->rma_wins[n]){
+      MPI_Win_free(plan->rma_wins + n);
+    }
+  }
+  if(MPI_WIN_NULL != plan->rma_staging_win){
+    MPI_Win_free(&plan->rma_staging_win);
+  }
+  if(MPI_GROUP_NULL != plan->rma_origin_group && MPI_GROUP_EMPTY != plan->rma_origin_group){
+    MPI_Group_free(&plan->rma_origin_group);
+  }
+  if(MPI_GROUP_NULL != plan->rma_target_group && MPI_GROUP_EMPTY != plan->rma_target_group){
+    MPI_Group_free(&plan->rma_target_group);
+  }
+  for(int n = 0; n < plan->nprocs_2d; n++){
+    if(NULL != plan->rma_stypes && MPI_DATATYPE_NULL != plan->rma_stypes[n]){
+      MPI_Type_free(plan->rma_stypes + n);
+    }
+    if(NULL != plan->rma_rtypes && MPI_DATATYPE_NULL != plan->rma_rtypes[n]){
+      MPI_Type_free(plan->rma_rtypes + n);
+    }
+  }
+  sdecomp_internal_free(plan->rma_stypes);
+  sdecomp_internal_free(plan->rma_rtypes);
+  sdecomp_internal_free(plan->rma_staging_buf);
+  plan->is_persistent = false;
+  return 0;
+}
+
+const sdecomp_internal_transpose_engine_t sdecomp_internal_transpose_engine_rma = {
+  .init          = init,
+  .execute       = execute,
+  .execute_batch = execute_batch,
+  .start         = start,
+  .test          = test,
+  .wait          = wait,
+  .finalise      = finalise,
+};
@@ -0,0 +1,281 @@
+/*
+ * Copyright 2022 Naoki Hori
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// https://github.com/NaokiHori/SimpleDecomp
+
+// engine reading the chunks of the processes sharing memory with me directly
+//   from a shared-memory window, while the other chunks are packed and
+//   exchanged by MPI_Alltoallv as the ALLTOALLV engine does
+// NOTE: each process packs the chunks to the others sharing memory with it
+//   to its own segment of the window, from which the others unpack them
+//   into their receive buffers, i.e. on-node chunks are not passed through the MPI transport
+
+#include <stdbool.h>
+#include <mpi.h>
+#include "sdecomp.h"
+#define SDECOMP_INTERNAL
+#include "../internal.h"
+#define SDECOMP_INTERNAL_TRANSPOSE
+#include "internal.h"
+
+// exchange of the chunks to the processes not sharing memory with me
+//   skipped when all processes in comm_2d share memory
+static int exchange(
+    const char error_label[],
+    const sdecomp_transpose_plan_t * plan,
+    const size_t nfields,
+    const void * sendbuf,
+    const int * scounts,
+    const int * sdispls,
+    void * recvbuf,
+    const int * rcounts,
+    const int * rdispls
+){
+  (void)error_label;
+  (void)nfields;
+  if(!plan->has_remote) return 0;
+  MPI_Alltoallv(
+      sendbuf, scounts, sdispls, plan->elemtype,
+      recvbuf, rcounts, rdispls, plan->elemtype,
+      plan->comm_2d
+  );
+  return 0;
+}
+
+// exchange the chunks with the processes sharing memory with me
+static int read_node(
+    const sdecomp_transpose_plan_t * plan,
+    const size_t nfields,
+    const void * const * sendbufs,
+    void * const * recvbufs
+){
+  int node_nprocs = 0;
+  MPI_Comm_size(plan->comm_node, &node_nprocs);
+  // only the chunk to myself, which has already been copied
+  if(1 == node_nprocs) return 0;
+  // NOTE: the segments contain the elements in the wire format,
+  //   so that on-node chunks are rounded as the others
+  const size_t size_of_element = plan->size_of_element;
+  const size_t packed_size_of_element = plan->packed_size_of_element;
+  for(size_t f = 0; f < nfields; f++){
+    for(int n = 0; n < plan->nprocs_2d; n++){
+      if(plan->myrank_2d == n) continue;
+      if(MPI_UNDEFINED == plan->node_ranks[n]) continue;
+      sdecomp_internal_transpose_pack_wire(
+          plan->wire,
+          size_of_element,
+          plan->schunks + n,
+          sendbufs[f],
+          (char *)plan->node_sendbuf + packed_size_of_element * plan->node_sdispls[n]
+      );
+    }
+    // my segment is visible to the others after the barrier
+    MPI_Win_sync(plan->node_win);
+    MPI_Barrier(plan->comm_node);
+    MPI_Win_sync(plan->node_win);
+    for(int n = 0; n < plan->nprocs_2d; n++){
+      if(plan->myrank_2d == n) continue;
+      if(MPI_UNDEFINED == plan->node_ranks[n]) continue;
+      sdecomp_internal_transpose_unpack_wire(
+          plan->wire,
+          size_of_element,
+          plan->rchunks + n,
+          (const char *)plan->node_sendbufs[n] + packed_size_of_element * plan->node_rdispls[n],
+          recvbufs[f]
+      );
+    }
+    // my segment is overwritten by the next field or rotation
+    //   after the others finish reading it
+    MPI_Barrier(plan->comm_node);
+  }
+  return 0;
+}
+
+static int rotate(
+    const char error_label[],
+    sdecomp_transpose_plan_t * plan,
+    const size_t nfields,
+    const void * const * sendbufs,
+    void * const * recvbufs
+){
+  if(0 != sdecomp_internal_transpose_packed_execute(error_label, plan, nfields, sendbufs, recvbufs, exchange)) return 1;
+  if(0 != read_node(plan, nfields, sendbufs, recvbufs)) return 1;
+  return 0;
+}
+
+static int init(
+    const char error_label[],
+    const sdecomp_transpose_options_t * options,
+    sdecomp_transpose_plan_t * plan
+){
+  (void)options;
+  const size_t packed_size_of_element = plan->packed_size_of_element;
+  const int nprocs = plan->nprocs_2d;
+  plan->is_persistent = false;
+  plan->persistent_request = MPI_REQUEST_NULL;
+  // processes sharing memory with me
+  MPI_Comm_split_type(plan->comm_2d, MPI_COMM_TYPE_SHARED, plan->myrank_2d, MPI_INFO_NULL, &plan->comm_node);
+  int node_nprocs = 0;
+  MPI_Comm_size(plan->comm_node, &node_nprocs);
+  plan->node_ranks = sdecomp_internal_calloc(error_label, (size_t)nprocs, sizeof(int));
+  int * ranks = sdecomp_internal_calloc(error_label, (size_t)nprocs, sizeof(int));
+  if(NULL == plan->node_ranks) return 1;
+  if(NULL == ranks) return 1;
+  for(int n = 0; n < nprocs; n++){
+    ranks[n] = n;
+  }
+  MPI_Group group_2d = MPI_GROUP_NULL;
+  MPI_Group group_node = MPI_GROUP_NULL;
+  MPI_Comm_group(plan->comm_2d, &group_2d);
+  MPI_Comm_group(plan->comm_node, &group_node);
+  MPI_Group_translate_ranks(group_2d, nprocs, ranks, group_node, plan->node_ranks);
+  MPI_Group_free(&group_2d);
+  MPI_Group_free(&group_node);
+  sdecomp_internal_free(ranks);
+  // all processes should agree whether MPI_Alltoallv is called
+  int has_remote = node_nprocs < nprocs;
+  MPI_Allreduce(MPI_IN_PLACE, &has_remote, 1, MPI_INT, MPI_LOR, plan->comm_2d);
+  plan->has_remote = has_remote;
+  // packed buffers only for the processes not sharing memory with me
+  if(0 != sdecomp_internal_transpose_packed_init(error_label, plan)) return 1;
+  // my segment only accommodates my chunks to the processes sharing memory with me,
+  //   whose displacements are told to the receivers
+  plan->node_sdispls = sdecomp_internal_calloc(error_label, (size_t)nprocs, sizeof(size_t));
+  plan->node_rdispls = sdecomp_internal_calloc(error_label, (size_t)nprocs, sizeof(size_t));
+  if(NULL == plan->node_sdispls) return 1;
+  if(NULL == plan->node_rdispls) return 1;
+  plan->node_ssize = 0;
+  for(int n = 0; n < nprocs; n++){
+    if(plan->myrank_2d == n) continue;
+    if(MPI_UNDEFINED == plan->node_ranks[n]) continue;
+    const sdecomp_internal_transpose_chunk_t * schunk = plan->schunks + n;
+    plan->node_sdispls[n] = plan->node_ssize;
+    plan->node_ssize += schunk->nbatch * schunk->ni * schunk->nj;
+  }
+  MPI_Alltoall(
+      plan->node_sdispls, sizeof(size_t), MPI_BYTE,
+      plan->node_rdispls, sizeof(size_t), MPI_BYTE,
+      plan->comm_2d
+  );
+  // segments can be placed close to each process (e.g. NUMA-aware)
+  //   since they are accessed through the queried addresses
+  MPI_Info info = MPI_INFO_NULL;
+  MPI_Info_create(&info);
+  MPI_Info_set(info, "alloc_shared_noncontig", "true");
+  MPI_Win_allocate_shared(
+      (MPI_Aint)(packed_size_of_element * plan->node_ssize),
+      1,
+      info,
+      plan->comm_node,
+      &plan->node_sendbuf,
+      &plan->node_win
+  );
+  MPI_Info_free(&info);
+  // passive-target epoch, which lasts until the plan is destructed
+  MPI_Win_lock_all(MPI_MODE_NOCHECK, plan->node_win);
+  plan->node_sendbufs = sdecomp_internal_calloc(error_label, (size_t)nprocs, sizeof(void *));
+  if(NULL == plan->node_sendbufs) return 1;
+  for(int n = 0; n < nprocs; n++){
+    if(MPI_UNDEFINED == plan->node_ranks[n]) continue;
+    MPI_Aint size = 0;
+    int disp_unit = 0;
+    void * segment = NULL;
+    MPI_Win_shared_query(plan->node_win, plan->node_ranks[n], &size, &disp_unit, &segment);
+    plan->node_sendbufs[n] = segment;
+  }
+  return 0;
+}
+
+static int execute(
+    sdecomp_transpose_plan_t * plan,
+    const void * sendbuf,
+    void * recvbuf
+){
+  const char error_label[] = {"sdecomp.transpose.execute"};
+  return rotate(error_label, plan, 1, &sendbuf, &recvbuf);
+}
+
+static int execute_batch(
+    const char error_label[],
+    sdecomp_transpose_plan_t * plan,
+    const size_t nfields,
+    const void * const * sendbufs,
+    void * const * recvbufs
+){
+  return rotate(error_label, plan, nfields, sendbufs, recvbufs);
+}
+
+// NOTE: the shared segments are read by the other processes after a barrier,
+//   so that the rotation does not overlap with the caller
+static int start(
+    const char error_label[],
+    sdecomp_transpose_plan_t * plan,
+    const void * sendbuf,
+    void * recvbuf,
+    sdecomp_transpose_request_t * request
+){
+  if(0 != rotate(error_label, plan, 1, &sendbuf, &recvbuf)) return 1;
+  request->is_completed = true;
+  return 0;
+}
+
+static int test(
+    sdecomp_transpose_request_t * request,
+    bool * flag
+){
+  *flag = request->is_completed;
+  return 0;
+}
+
+static int wait(
+    sdecomp_transpose_request_t * request
+){
+  (void)request;
+  return 0;
+}
+
+static int finalise(
+    sdecomp_transpose_plan_t * plan
+){
+  sdecomp_internal_transpose_packed_finalise(plan);
+  if(MPI_WIN_NULL != plan->node_win){
+    MPI_Win_unlock_all(plan->node_win);
+    MPI_Win_free(&plan->node_win);
+  }
+  if(MPI_COMM_NULL != plan->comm_node){
+    MPI_Comm_free(&plan->comm_node);
+  }
+  sdecomp_internal_free(plan->node_ranks);
+  sdecomp_internal_free(plan->node_sendbufs);
+  sdecomp_internal_free(plan->node_sdispls);
+  sdecomp_internal_free(plan->node_rdispls);
+  return 0;
+}
+
+const sdecomp_internal_transpose_engine_t sdecomp_internal_transpose_engine_shm = {
+  .init          = init,
+  .execute       = execute,
+  .execute_batch = execute_batch,
+  .start         = start,
+  .test          = test,
+  .wait          = wait,
+  .finalise      = finalise,
+};
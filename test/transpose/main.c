@@ -8,6 +8,37 @@
 #include <mpi.h>
 #include "sdecomp.h"
 
+// ways to run transposes
+typedef enum {
+  RUNNER_BLOCKING    = 0,
+  RUNNER_NONBLOCKING = 1,
+  RUNNER_PERSISTENT  = 2,
+  RUNNER_BATCH       = 3,
+  RUNNER_PIPELINED   = 4,
+  RUNNER_AUTOTUNE    = 5,
+  RUNNER_INPLACE     = 6,
+  RUNNER_WIRE        = 7,
+  RUNNER_COMPRESS    = 8,
+  RUNNER_TRUNCATE    = 9,
+  RUNNER_PAD         = 10,
+  RUNNER_R2C         = 11,
+} runner_t;
+
+static const char * runner_names[] = {
+  "blocking",
+  "nonblocking",
+  "persistent",
+  "batch",
+  "pipelined",
+  "autotune",
+  "inplace",
+  "wire",
+  "compress",
+  "truncate",
+  "pad",
+  "r2c",
+};
+
 static int get_mysizes(
     const sdecomp_info_t * info,
     const sdecomp_pencil_t pencil,
@@ -40,6 +71,29 @@ static int get_offsets(
   return 0;
 }
 
+// the bulk getter should give the same result as the per-direction getters
+static int check_layout(
+    const sdecomp_info_t * info,
+    const sdecomp_pencil_t pencil,
+    const size_t * glsizes,
+    const size_t * mysizes,
+    const size_t * offsets
+){
+  size_t ndims = 0;
+  sdecomp.get_ndims(info, &ndims);
+  size_t mysizes_[3] = {0};
+  size_t offsets_[3] = {0};
+  if(0 != sdecomp.get_pencil_layout(info, pencil, glsizes, mysizes_, offsets_)){
+    return 1;
+  }
+  for(size_t n = 0; n < ndims; n++){
+    if(mysizes[n] != mysizes_[n] || offsets[n] != offsets_[n]){
+      return 1;
+    }
+  }
+  return 0;
+}
+
 static int get_nitems(
     const size_t ndims,
     const size_t * mysizes,
@@ -185,7 +239,14 @@ static int check_aft_pencil(
     if(0 != get_indices(ndims, pencil_aft, aft_mysizes, index, indices)){
       return 1;
     }
-    const uint_fast8_t value = answer(ndims, glsizes, aft_offsets, indices);
+    // padding, which is outside the pencil before rotated, should be zero
+    bool is_padding = false;
+    for(size_t n = 0; n < ndims; n++){
+      if(glsizes[n] <= indices[n] + aft_offsets[n]){
+        is_padding = true;
+      }
+    }
+    const uint_fast8_t value = is_padding ? 0 : answer(ndims, glsizes, aft_offsets, indices);
     free(indices);
     for(size_t n = 0; n < size_of_element; n++){
       values[n] = value;
@@ -203,12 +264,44 @@ static int check_aft_pencil(
   return 0;
 }
 
+// reduced-precision wire format handles doubles,
+//   whose values (no larger than 255) are exactly represented also by bfloat16
+//   thus each double is replaced by the value of its first byte, and vice versa
+static int bytes_to_doubles(
+    const size_t nitems,
+    const size_t size_of_element,
+    uint_fast8_t * buf
+){
+  const size_t nvalues = nitems * size_of_element / sizeof(double);
+  for(size_t n = 0; n < nvalues; n++){
+    const double value = (double)buf[n * sizeof(double)];
+    memcpy(buf + n * sizeof(double), &value, sizeof(double));
+  }
+  return 0;
+}
+
+static int doubles_to_bytes(
+    const size_t nitems,
+    const size_t size_of_element,
+    uint_fast8_t * buf
+){
+  const size_t nvalues = nitems * size_of_element / sizeof(double);
+  for(size_t n = 0; n < nvalues; n++){
+    double value = 0.;
+    memcpy(&value, buf + n * sizeof(double), sizeof(double));
+    memset(buf + n * sizeof(double), (uint_fast8_t)value, sizeof(double));
+  }
+  return 0;
+}
+
 static int write_result(
     const sdecomp_info_t * info,
     const size_t * glsizes,
     const sdecomp_pencil_t pencil_bef,
     const sdecomp_pencil_t pencil_aft,
     const size_t size_of_element,
+    const sdecomp_transpose_engine_t engine,
+    const runner_t runner,
     const bool success
 ){
   size_t ndims = 0;
@@ -224,21 +317,68 @@ static int write_result(
     }
     printf("%4d procs, ", nprocs);
     printf("size of element: %2zu, ", size_of_element);
-    printf("from %u to %u - ", pencil_bef, pencil_aft);
+    printf("from %u to %u, ", pencil_bef, pencil_aft);
+    printf("engine: %u, ", engine);
+    printf("%11s - ", runner_names[runner]);
     printf("%s\n", success ? "PASSED" : "FAILED");
   }
   return 0;
 }
 
+// compare the contents of two files byte by byte
+static int compare_files(
+    const char filename0[],
+    const char filename1[],
+    bool * success
+){
+  FILE * fp0 = fopen(filename0, "r");
+  FILE * fp1 = fopen(filename1, "r");
+  *success = NULL != fp0 && NULL != fp1;
+  while(*success){
+    const int c0 = fgetc(fp0);
+    const int c1 = fgetc(fp1);
+    if(c0 != c1){
+      *success = false;
+    }
+    if(EOF == c0 || EOF == c1){
+      break;
+    }
+  }
+  if(NULL != fp0){
+    fclose(fp0);
+  }
+  if(NULL != fp1){
+    fclose(fp1);
+  }
+  return 0;
+}
+
 static int kernel(
     const sdecomp_info_t * info,
     const size_t * glsizes,
     const sdecomp_pencil_t pencil_bef,
     const sdecomp_pencil_t pencil_aft,
-    const size_t size_of_element
+    const size_t size_of_element,
+    const sdecomp_transpose_engine_t engine,
+    const runner_t runner
 ){
   size_t ndims = 0;
   sdecomp.get_ndims(info, &ndims);
+  // global sizes after rotated,
+  //   which are truncated in the contiguous direction of the pencil before rotated
+  //   or padded in the contiguous directions of both pencils
+  size_t * glsizes_aft = calloc(ndims, sizeof(size_t));
+  memcpy(glsizes_aft, glsizes, ndims * sizeof(size_t));
+  if(RUNNER_TRUNCATE == runner){
+    const size_t dim = pencil_bef % 3;
+    glsizes_aft[dim] -= glsizes[dim] / 8;
+  }
+  if(RUNNER_PAD == runner){
+    const size_t dim_bef = pencil_bef % 3;
+    const size_t dim_aft = pencil_aft % 3;
+    glsizes_aft[dim_bef] += glsizes[dim_bef] / 4;
+    glsizes_aft[dim_aft] += glsizes[dim_aft] / 2;
+  }
   // prepare
   size_t * bef_mysizes = calloc(ndims, sizeof(size_t));
   size_t * bef_offsets = calloc(ndims, sizeof(size_t));
@@ -250,10 +390,16 @@ static int kernel(
   if(0 != get_offsets(info, pencil_bef, glsizes, bef_offsets)){
     return 1;
   }
-  if(0 != get_mysizes(info, pencil_aft, glsizes, aft_mysizes)){
+  if(0 != get_mysizes(info, pencil_aft, glsizes_aft, aft_mysizes)){
     return 1;
   }
-  if(0 != get_offsets(info, pencil_aft, glsizes, aft_offsets)){
+  if(0 != get_offsets(info, pencil_aft, glsizes_aft, aft_offsets)){
+    return 1;
+  }
+  if(0 != check_layout(info, pencil_bef, glsizes, bef_mysizes, bef_offsets)){
+    return 1;
+  }
+  if(0 != check_layout(info, pencil_aft, glsizes_aft, aft_mysizes, aft_offsets)){
     return 1;
   }
   size_t bef_nitems = 0;
@@ -268,63 +414,176 @@ static int kernel(
   uint_fast8_t * aft = calloc(aft_nitems, size_of_element);
   // set send buffer
   init_bef_pencil(ndims, glsizes, pencil_bef, bef_nitems, bef_mysizes, bef_offsets, size_of_element, bef);
+  // padding should be overwritten
+  if(RUNNER_PAD == runner){
+    memset(aft, 0xff, aft_nitems * size_of_element);
+  }
   // transpose
+  sdecomp_transpose_options_t options = SDECOMP_TRANSPOSE_DEFAULT_OPTIONS;
+  options.engine = engine;
+  if(RUNNER_PERSISTENT == runner){
+    options.persistent = true;
+    options.sendbuf = bef;
+    options.recvbuf = aft;
+  }
+  if(RUNNER_PIPELINED == runner){
+    options.nslabs = 3;
+  }
+  if(RUNNER_AUTOTUNE == runner){
+    options.autotune = true;
+  }
+  if(RUNNER_COMPRESS == runner){
+    options.compress = true;
+  }
+  if(RUNNER_WIRE == runner){
+    options.wire = sizeof(double) == size_of_element ? SDECOMP_TRANSPOSE_WIRE_FP32 : SDECOMP_TRANSPOSE_WIRE_BF16;
+    bytes_to_doubles(bef_nitems, size_of_element, bef);
+  }
+  // x pencils store complex numbers as pairs of real numbers,
+  //   as if they were transformed in place from / to real numbers
+  //   NOTE: the buffers are identical to those of the other runners
+  size_t * glsizes_bef = calloc(ndims, sizeof(size_t));
+  memcpy(glsizes_bef, glsizes, ndims * sizeof(size_t));
+  size_t size_of_element_bef = size_of_element;
+  size_t size_of_element_aft = size_of_element;
+  if(RUNNER_R2C == runner){
+    if(0 == pencil_bef % 3){
+      glsizes_bef[0] *= 2;
+      size_of_element_bef /= 2;
+    }
+    if(0 == pencil_aft % 3){
+      glsizes_aft[0] *= 2;
+      size_of_element_aft /= 2;
+    }
+  }
   sdecomp_transpose_plan_t * plan = NULL;
-  if(0 != sdecomp.transpose.construct(
-      info,
-      pencil_bef,
-      pencil_aft,
-      glsizes,
-      size_of_element,
-      &plan
-  )){
-    return 1;
+  if(RUNNER_TRUNCATE == runner || RUNNER_PAD == runner || RUNNER_R2C == runner){
+    if(0 != sdecomp.transpose.construct_resized(
+        info,
+        pencil_bef,
+        pencil_aft,
+        glsizes_bef,
+        glsizes_aft,
+        size_of_element_bef,
+        size_of_element_aft,
+        &options,
+        &plan
+    )){
+      return 1;
+    }
+  }else{
+    if(0 != sdecomp.transpose.construct_with_options(
+        info,
+        pencil_bef,
+        pencil_aft,
+        glsizes,
+        size_of_element,
+        &options,
+        &plan
+    )){
+      return 1;
+    }
   }
-  if(0 != sdecomp.transpose.execute(plan, bef, aft)){
-    return 1;
+  // batched runner moves the same field twice
+  uint_fast8_t * bef_copy = NULL;
+  uint_fast8_t * aft_copy = NULL;
+  if(RUNNER_BLOCKING == runner || RUNNER_PERSISTENT == runner || RUNNER_PIPELINED == runner || RUNNER_AUTOTUNE == runner || RUNNER_WIRE == runner || RUNNER_COMPRESS == runner || RUNNER_TRUNCATE == runner || RUNNER_PAD == runner || RUNNER_R2C == runner){
+    if(0 != sdecomp.transpose.execute(plan, bef, aft)){
+      return 1;
+    }
+  }else if(RUNNER_INPLACE == runner){
+    // one buffer large enough to store both pencils
+    const size_t nitems = bef_nitems < aft_nitems ? aft_nitems : bef_nitems;
+    uint_fast8_t * buf = calloc(nitems, size_of_element);
+    memcpy(buf, bef, bef_nitems * size_of_element);
+    if(0 != sdecomp.transpose.execute_inplace(plan, buf)){
+      return 1;
+    }
+    memcpy(aft, buf, aft_nitems * size_of_element);
+    free(buf);
+  }else if(RUNNER_BATCH == runner){
+    bef_copy = calloc(bef_nitems, size_of_element);
+    aft_copy = calloc(aft_nitems, size_of_element);
+    memcpy(bef_copy, bef, bef_nitems * size_of_element);
+    const void * sendbufs[] = {bef, bef_copy};
+    void * recvbufs[] = {aft, aft_copy};
+    if(0 != sdecomp.transpose.execute_batch(plan, 2, sendbufs, recvbufs)){
+      return 1;
+    }
+  }else{
+    sdecomp_transpose_request_t * request = NULL;
+    if(0 != sdecomp.transpose.start(plan, bef, aft, &request)){
+      return 1;
+    }
+    // blocking rotation while the non-blocking one is on-going
+    aft_copy = calloc(aft_nitems, size_of_element);
+    if(0 != sdecomp.transpose.execute(plan, bef, aft_copy)){
+      return 1;
+    }
+    // poll until completed
+    for(bool flag = false; !flag; ){
+      if(0 != sdecomp.transpose.test(request, &flag)){
+        return 1;
+      }
+    }
+    if(0 != sdecomp.transpose.wait(request)){
+      return 1;
+    }
   }
   if(0 != sdecomp.transpose.destruct(plan)){
     return 1;
   }
+  if(RUNNER_WIRE == runner){
+    doubles_to_bytes(aft_nitems, size_of_element, aft);
+  }
   // check receive buffer
   bool success = true;
   check_aft_pencil(ndims, glsizes, pencil_aft, aft_nitems, aft_mysizes, aft_offsets, size_of_element, aft, &success);
+  if(RUNNER_BATCH == runner || RUNNER_NONBLOCKING == runner){
+    check_aft_pencil(ndims, glsizes, pencil_aft, aft_nitems, aft_mysizes, aft_offsets, size_of_element, aft_copy, &success);
+  }
   // clean up
+  free(glsizes_bef);
+  free(glsizes_aft);
   free(bef_mysizes);
   free(bef_offsets);
   free(aft_mysizes);
   free(aft_offsets);
   free(bef);
   free(aft);
-  write_result(info, glsizes, pencil_bef, pencil_aft, size_of_element, success);
+  free(bef_copy);
+  free(aft_copy);
+  write_result(info, glsizes, pencil_bef, pencil_aft, size_of_element, engine, runner, success);
   return success ? 0 : 1;
 }
 
 static int test(
     const sdecomp_info_t * info,
     const size_t * glsizes,
-    const size_t size_of_element
+    const size_t size_of_element,
+    const sdecomp_transpose_engine_t engine,
+    const runner_t runner
 ){
   int retval = 0;
   size_t ndims = 0;
   sdecomp.get_ndims(info, &ndims);
   // test all possible transpose cases
   if(2 == ndims){
-    retval += kernel(info, glsizes, SDECOMP_X1PENCIL, SDECOMP_Y1PENCIL, size_of_element);
-    retval += kernel(info, glsizes, SDECOMP_Y1PENCIL, SDECOMP_X1PENCIL, size_of_element);
+    retval += kernel(info, glsizes, SDECOMP_X1PENCIL, SDECOMP_Y1PENCIL, size_of_element, engine, runner);
+    retval += kernel(info, glsizes, SDECOMP_Y1PENCIL, SDECOMP_X1PENCIL, size_of_element, engine, runner);
   }else{
-    retval += kernel(info, glsizes, SDECOMP_X1PENCIL, SDECOMP_Y1PENCIL, size_of_element);
-    retval += kernel(info, glsizes, SDECOMP_Y1PENCIL, SDECOMP_Z1PENCIL, size_of_element);
-    retval += kernel(info, glsizes, SDECOMP_Z1PENCIL, SDECOMP_X2PENCIL, size_of_element);
-    retval += kernel(info, glsizes, SDECOMP_X2PENCIL, SDECOMP_Y2PENCIL, size_of_element);
-    retval += kernel(info, glsizes, SDECOMP_Y2PENCIL, SDECOMP_Z2PENCIL, size_of_element);
-    retval += kernel(info, glsizes, SDECOMP_Z2PENCIL, SDECOMP_X1PENCIL, size_of_element);
-    retval += kernel(info, glsizes, SDECOMP_X1PENCIL, SDECOMP_Z2PENCIL, size_of_element);
-    retval += kernel(info, glsizes, SDECOMP_Y1PENCIL, SDECOMP_X1PENCIL, size_of_element);
-    retval += kernel(info, glsizes, SDECOMP_Z1PENCIL, SDECOMP_Y1PENCIL, size_of_element);
-    retval += kernel(info, glsizes, SDECOMP_X2PENCIL, SDECOMP_Z1PENCIL, size_of_element);
-    retval += kernel(info, glsizes, SDECOMP_Y2PENCIL, SDECOMP_X2PENCIL, size_of_element);
-    retval += kernel(info, glsizes, SDECOMP_Z2PENCIL, SDECOMP_Y2PENCIL, size_of_element);
+    retval += kernel(info, glsizes, SDECOMP_X1PENCIL, SDECOMP_Y1PENCIL, size_of_element, engine, runner);
+    retval += kernel(info, glsizes, SDECOMP_Y1PENCIL, SDECOMP_Z1PENCIL, size_of_element, engine, runner);
+    retval += kernel(info, glsizes, SDECOMP_Z1PENCIL, SDECOMP_X2PENCIL, size_of_element, engine, runner);
+    retval += kernel(info, glsizes, SDECOMP_X2PENCIL, SDECOMP_Y2PENCIL, size_of_element, engine, runner);
+    retval += kernel(info, glsizes, SDECOMP_Y2PENCIL, SDECOMP_Z2PENCIL, size_of_element, engine, runner);
+    retval += kernel(info, glsizes, SDECOMP_Z2PENCIL, SDECOMP_X1PENCIL, size_of_element, engine, runner);
+    retval += kernel(info, glsizes, SDECOMP_X1PENCIL, SDECOMP_Z2PENCIL, size_of_element, engine, runner);
+    retval += kernel(info, glsizes, SDECOMP_Y1PENCIL, SDECOMP_X1PENCIL, size_of_element, engine, runner);
+    retval += kernel(info, glsizes, SDECOMP_Z1PENCIL, SDECOMP_Y1PENCIL, size_of_element, engine, runner);
+    retval += kernel(info, glsizes, SDECOMP_X2PENCIL, SDECOMP_Z1PENCIL, size_of_element, engine, runner);
+    retval += kernel(info, glsizes, SDECOMP_Y2PENCIL, SDECOMP_X2PENCIL, size_of_element, engine, runner);
+    retval += kernel(info, glsizes, SDECOMP_Z2PENCIL, SDECOMP_Y2PENCIL, size_of_element, engine, runner);
   }
   return retval;
 }
@@ -389,11 +648,142 @@ int main(
   }
   // test rotations, for various element sizes, all forward and backward
   const size_t nitems = sizeof(size_of_elements) / sizeof(size_of_elements[0]);
-  for(size_t n = 0; n < nitems; n++){
-    const size_t size_of_element = size_of_elements[n];
-    retval += test(info, glsizes, size_of_element);
+  const runner_t runners[] = {RUNNER_BLOCKING, RUNNER_NONBLOCKING, RUNNER_PERSISTENT, RUNNER_BATCH, RUNNER_PIPELINED, RUNNER_AUTOTUNE, RUNNER_INPLACE, RUNNER_WIRE, RUNNER_COMPRESS, RUNNER_TRUNCATE, RUNNER_PAD, RUNNER_R2C};
+  const size_t nrunners = sizeof(runners) / sizeof(runners[0]);
+  const sdecomp_transpose_engine_t engines[] = {
+    SDECOMP_TRANSPOSE_ENGINE_ALLTOALLW,
+    SDECOMP_TRANSPOSE_ENGINE_ALLTOALLV,
+    SDECOMP_TRANSPOSE_ENGINE_PAIRWISE,
+    SDECOMP_TRANSPOSE_ENGINE_BRUCK,
+    SDECOMP_TRANSPOSE_ENGINE_SHM,
+    SDECOMP_TRANSPOSE_ENGINE_HIERARCHICAL,
+    SDECOMP_TRANSPOSE_ENGINE_RMA,
+    SDECOMP_TRANSPOSE_ENGINE_NEIGHBOR,
+  };
+  const size_t nengines = sizeof(engines) / sizeof(engines[0]);
+  for(size_t l = 0; l < nengines; l++){
+    for(size_t m = 0; m < nrunners; m++){
+      // autotuning and in-place rotations do not depend on the engine given
+      if((RUNNER_AUTOTUNE == runners[m] || RUNNER_INPLACE == runners[m]) && 0 != l){
+        continue;
+      }
+      for(size_t n = 0; n < nitems; n++){
+        const size_t size_of_element = size_of_elements[n];
+        // real and complex numbers, whose sizes differ by a factor of 2
+        if(RUNNER_R2C == runners[m] && 1 == size_of_element){
+          continue;
+        }
+        // persistent and pipelined rotations are implemented only for some engines
+        if(RUNNER_PERSISTENT == runners[m]){
+          if(
+                 SDECOMP_TRANSPOSE_ENGINE_ALLTOALLW != engines[l]
+              && SDECOMP_TRANSPOSE_ENGINE_ALLTOALLV != engines[l]
+              && SDECOMP_TRANSPOSE_ENGINE_RMA       != engines[l]
+          ){
+            continue;
+          }
+        }
+        if(RUNNER_PIPELINED == runners[m]){
+          if(
+                 SDECOMP_TRANSPOSE_ENGINE_ALLTOALLW != engines[l]
+              && SDECOMP_TRANSPOSE_ENGINE_ALLTOALLV != engines[l]
+          ){
+            continue;
+          }
+        }
+        // compression is implemented only for one engine
+        if(RUNNER_COMPRESS == runners[m] && SDECOMP_TRANSPOSE_ENGINE_ALLTOALLV != engines[l]){
+          continue;
+        }
+        // reduced-precision wire format is for double and double complex,
+        //   exchanged by the engines packing chunks explicitly
+        if(RUNNER_WIRE == runners[m]){
+          if(sizeof(double) != size_of_element && 2 * sizeof(double) != size_of_element){
+            continue;
+          }
+          if(
+                 SDECOMP_TRANSPOSE_ENGINE_ALLTOALLW == engines[l]
+              || SDECOMP_TRANSPOSE_ENGINE_RMA       == engines[l]
+              || SDECOMP_TRANSPOSE_ENGINE_NEIGHBOR  == engines[l]
+          ){
+            continue;
+          }
+        }
+        retval += test(info, glsizes, size_of_element, engines[l], runners[m]);
+      }
+    }
+  }
+  // processes laid out following the node topology,
+  //   the process grid chosen by measurements,
+  //   and the non-uniform decomposition
+  const double weights[2] = {1., 1.2};
+  for(size_t k = 0; k < 3; k++){
+    size_t * dims = calloc(ndims, sizeof(size_t));
+    bool * periods = calloc(ndims, sizeof(bool));
+    sdecomp_options_t options = SDECOMP_DEFAULT_OPTIONS;
+    if(0 == k){
+      options.node_aware = true;
+    }else if(1 == k){
+      options.autotune = true;
+      options.glsizes = glsizes;
+    }else{
+      for(size_t dim = 0; dim < ndims; dim++){
+        options.weights[dim] = weights;
+        options.nweights[dim] = 2;
+      }
+    }
+    sdecomp_info_t * info_with_options = NULL;
+    if(0 != sdecomp.construct_with_options(MPI_COMM_WORLD, ndims, dims, periods, &options, &info_with_options)){
+      return 1;
+    }
+    free(dims);
+    free(periods);
+    for(size_t l = 0; l < nengines; l++){
+      for(size_t n = 0; n < nitems; n++){
+        retval += test(info_with_options, glsizes, size_of_elements[n], engines[l], RUNNER_BLOCKING);
+      }
+    }
+    if(0 != sdecomp.destruct(info_with_options)){
+      return 1;
+    }
   }
   free(glsizes);
+  // save the results of autotuning and load them to another decomposition,
+  //   which should write the same results
+  {
+    const char filename0[] = {"wisdom0.dat"};
+    const char filename1[] = {"wisdom1.dat"};
+    if(0 != sdecomp.transpose.export_wisdom(info, filename0)){
+      return 1;
+    }
+    size_t * dims = calloc(ndims, sizeof(size_t));
+    bool * periods = calloc(ndims, sizeof(bool));
+    sdecomp_info_t * info_loaded = NULL;
+    if(0 != sdecomp.construct(MPI_COMM_WORLD, ndims, dims, periods, &info_loaded)){
+      return 1;
+    }
+    free(dims);
+    free(periods);
+    if(0 != sdecomp.transpose.import_wisdom(info_loaded, filename0)){
+      return 1;
+    }
+    if(0 != sdecomp.transpose.export_wisdom(info_loaded, filename1)){
+      return 1;
+    }
+    if(0 != sdecomp.destruct(info_loaded)){
+      return 1;
+    }
+    int myrank = 0;
+    MPI_Comm_rank(MPI_COMM_WORLD, &myrank);
+    if(0 == myrank){
+      bool success = false;
+      compare_files(filename0, filename1, &success);
+      printf("wisdom - %s\n", success ? "PASSED" : "FAILED");
+      retval += success ? 0 : 1;
+      remove(filename0);
+      remove(filename1);
+    }
+  }
   // clean-up domain decomposition
   if(0 != sdecomp.destruct(info)){
     return 1;